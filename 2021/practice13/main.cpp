@@ -27,6 +27,7 @@
 #include "frustum.hpp"
 #include "mesh_utils.hpp"
 #include "intersect.hpp"
+#include "simplifier.hpp"
 
 std::string to_string(std::string_view str)
 {
@@ -170,7 +171,16 @@ int main() try
 		std::ifstream in(PRACTICE_SOURCE_DIRECTORY "/bunny0.obj");
 		std::tie(vertices, indices) = load_obj(in, 4.f);
 	}
-	fill_normals(vertices, indices);
+	fill_normals(vertices, indices, build_adjacency(vertices.size(), indices));
+
+	// all levels index the same vertices, so they live in one index buffer
+	std::vector<lod_level> lods;
+	{
+		simplify_mesh source{&vertices[0].position.x, vertices.size(), sizeof(vertex), indices};
+		auto chain = build_lod_chain({&source, 1}, {6, 0.5f});
+		indices = std::move(chain.indices);
+		lods = chain.meshes[0];
+	}
 
 	GLuint vao, vbo, ebo;
 	glGenVertexArrays(1, &vao);
@@ -283,8 +293,10 @@ int main() try
 		glUniformMatrix4fv(projection_location, 1, GL_FALSE, reinterpret_cast<float *>(&projection));
 		glUniform3fv(light_dir_location, 1, reinterpret_cast<float *>(&light_dir));
 
+		int lod = std::min<int>(lods.size() - 1, glm::length(camera_position) / 2.f);
+
 		glBindVertexArray(vao);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, nullptr);
+		glDrawElements(GL_TRIANGLES, lods[lod].count, GL_UNSIGNED_INT, reinterpret_cast<void *>(lods[lod].first * sizeof(std::uint32_t)));
 
 		SDL_GL_SwapWindow(window);
 	}
@@ -3,8 +3,211 @@
 #include <glm/common.hpp>
 #include <glm/geometric.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <sstream>
 #include <stdexcept>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MESH_UTILS_SSE2
+#endif
+
+namespace
+{
+
+	// Calls function(begin, end) for blocks of [0, count), on the calling thread and up to threads - 1 more.
+	// Blocks are multiples of 4, so SIMD loops only have a tail at the very end.
+	template <typename Function>
+	void parallel_for(std::size_t count, unsigned int threads, Function const & function)
+	{
+		std::size_t const block = 4096;
+		std::size_t const blocks = (count + block - 1) / block;
+
+		if (threads == 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+		threads = std::min<std::size_t>(threads, blocks);
+
+		std::atomic<std::size_t> next{0};
+		auto work = [&]
+		{
+			for (std::size_t i; (i = next++) < blocks;)
+				function(i * block, std::min(count, (i + 1) * block));
+		};
+
+		std::vector<std::thread> workers;
+		for (unsigned int t = 1; t < threads; ++t)
+			workers.emplace_back(work);
+		work();
+		for (auto & worker : workers)
+			worker.join();
+	}
+
+	glm::vec3 normalize_or_zero(glm::vec3 const & v)
+	{
+		float length = glm::length(v);
+		return length > 0.f ? v / length : glm::vec3(0.f);
+	}
+
+	// What every triangle contributes to the vertex normals: normal of the face times the weight of the corner
+	struct face_data
+	{
+		std::vector<glm::vec4> normals; // w is padding for 16-byte loads
+		std::vector<float> weights;     // per corner, empty for area weighting where every corner counts once
+	};
+
+	// Triangles this thin relative to their longest edge are degenerate: their normal is rounding noise,
+	// and angle weighting would give it a full angle (think of the slivers at the poles of a UV sphere)
+	float const degenerate_ratio = 1e-5f;
+
+	void face_scalar(glm::vec3 const (&p)[3], normal_weighting weighting, glm::vec4 & normal, float * weights)
+	{
+		glm::vec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+		if (weighting == normal_weighting::area)
+		{
+			// the cross product is already twice the area
+			normal = glm::vec4(n, 0.f);
+			return;
+		}
+
+		float longest = 0.f;
+		for (int k = 0; k < 3; ++k)
+		{
+			glm::vec3 a = p[(k + 1) % 3] - p[k];
+			glm::vec3 b = p[(k + 2) % 3] - p[k];
+			float d = glm::length(a) * glm::length(b);
+			weights[k] = d > 0.f ? std::acos(glm::clamp(glm::dot(a, b) / d, -1.f, 1.f)) : 0.f;
+			longest = std::max(longest, glm::dot(a, a));
+		}
+
+		float length = glm::length(n);
+		normal = glm::vec4(length > degenerate_ratio * longest ? n / length : glm::vec3(0.f), 0.f);
+	}
+
+#ifdef MESH_UTILS_SSE2
+	struct vec3x4
+	{
+		__m128 x, y, z;
+	};
+
+	vec3x4 operator - (vec3x4 const & a, vec3x4 const & b)
+	{
+		return {_mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z)};
+	}
+
+	__m128 dot(vec3x4 const & a, vec3x4 const & b)
+	{
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+	}
+
+	vec3x4 cross(vec3x4 const & a, vec3x4 const & b)
+	{
+		return {
+			_mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+			_mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+			_mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x)),
+		};
+	}
+
+	// Abramowitz & Stegun 4.4.46: acos(x) = sqrt(1 - x) * p(x) on [0, 1] with |error| < 2e-8,
+	// and acos(-x) = pi - acos(x)
+	__m128 acos_ps(__m128 x)
+	{
+		static float const coefficients[] = {-0.0012624911f, 0.0066700901f, -0.0170881256f, 0.0308918810f,
+			-0.0501743046f, 0.0889789874f, -0.2145988016f, 1.5707963050f};
+
+		__m128 a = _mm_andnot_ps(_mm_set1_ps(-0.f), x);
+		__m128 p = _mm_set1_ps(coefficients[0]);
+		for (int i = 1; i < 8; ++i)
+			p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(coefficients[i]));
+		__m128 r = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.f), a)), p);
+
+		__m128 negative = _mm_cmplt_ps(x, _mm_setzero_ps());
+		return _mm_or_ps(_mm_and_ps(negative, _mm_sub_ps(_mm_set1_ps(3.14159265f), r)), _mm_andnot_ps(negative, r));
+	}
+#endif
+
+	face_data compute_faces(std::vector<vertex> const & vertices, std::vector<std::uint32_t> const & indices,
+		normal_weighting weighting, unsigned int threads)
+	{
+		std::size_t const triangles = indices.size() / 3;
+
+		face_data result;
+		result.normals.resize(triangles);
+		if (weighting == normal_weighting::angle)
+			result.weights.resize(triangles * 3);
+
+		parallel_for(triangles, threads, [&](std::size_t begin, std::size_t end)
+		{
+			std::size_t t = begin;
+#ifdef MESH_UTILS_SSE2
+			// four triangles at a time, one per lane
+			for (; t + 4 <= end; t += 4)
+			{
+				vec3x4 p[3];
+				for (int k = 0; k < 3; ++k)
+				{
+					glm::vec3 const & p0 = vertices[indices[3 * t + k + 0]].position;
+					glm::vec3 const & p1 = vertices[indices[3 * t + k + 3]].position;
+					glm::vec3 const & p2 = vertices[indices[3 * t + k + 6]].position;
+					glm::vec3 const & p3 = vertices[indices[3 * t + k + 9]].position;
+					p[k] = {_mm_setr_ps(p0.x, p1.x, p2.x, p3.x), _mm_setr_ps(p0.y, p1.y, p2.y, p3.y), _mm_setr_ps(p0.z, p1.z, p2.z, p3.z)};
+				}
+
+				vec3x4 n = cross(p[1] - p[0], p[2] - p[0]);
+
+				if (weighting == normal_weighting::angle)
+				{
+					__m128 w[3];
+					__m128 longest = _mm_setzero_ps();
+					for (int k = 0; k < 3; ++k)
+					{
+						vec3x4 a = p[(k + 1) % 3] - p[k];
+						vec3x4 b = p[(k + 2) % 3] - p[k];
+						__m128 d = _mm_sqrt_ps(_mm_mul_ps(dot(a, a), dot(b, b)));
+						__m128 c = _mm_min_ps(_mm_max_ps(_mm_div_ps(dot(a, b), d), _mm_set1_ps(-1.f)), _mm_set1_ps(1.f));
+						w[k] = _mm_and_ps(_mm_cmpgt_ps(d, _mm_setzero_ps()), acos_ps(c));
+						longest = _mm_max_ps(longest, dot(a, a));
+					}
+
+					__m128 length = _mm_sqrt_ps(dot(n, n));
+					__m128 valid = _mm_cmpgt_ps(length, _mm_mul_ps(_mm_set1_ps(degenerate_ratio), longest));
+					__m128 scale = _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.f), length));
+					n = {_mm_mul_ps(n.x, scale), _mm_mul_ps(n.y, scale), _mm_mul_ps(n.z, scale)};
+
+					float weights[3][4];
+					for (int k = 0; k < 3; ++k)
+						_mm_storeu_ps(weights[k], w[k]);
+					for (int i = 0; i < 4; ++i)
+						for (int k = 0; k < 3; ++k)
+							result.weights[3 * (t + i) + k] = weights[k][i];
+				}
+
+				float x[4], y[4], z[4];
+				_mm_storeu_ps(x, n.x);
+				_mm_storeu_ps(y, n.y);
+				_mm_storeu_ps(z, n.z);
+				for (int i = 0; i < 4; ++i)
+					result.normals[t + i] = glm::vec4(x[i], y[i], z[i], 0.f);
+			}
+#endif
+			for (; t < end; ++t)
+			{
+				glm::vec3 const p[3] = {
+					vertices[indices[3 * t + 0]].position,
+					vertices[indices[3 * t + 1]].position,
+					vertices[indices[3 * t + 2]].position,
+				};
+				face_scalar(p, weighting, result.normals[t], result.weights.data() + 3 * t);
+			}
+		});
+
+		return result;
+	}
+
+}
 
 std::pair<std::vector<vertex>, std::vector<std::uint32_t>> load_obj(std::istream & input, float scale)
 {
@@ -91,3 +294,115 @@ void fill_normals(std::vector<vertex> & vertices, std::vector<std::uint32_t> con
 	for (auto & v : vertices)
 		v.normal = glm::normalize(v.normal);
 }
+
+vertex_adjacency build_adjacency(std::size_t vertex_count, std::vector<std::uint32_t> const & indices)
+{
+	vertex_adjacency result;
+	result.offsets.assign(vertex_count + 1, 0);
+	for (auto i : indices)
+		++result.offsets[i + 1];
+	for (std::size_t v = 0; v < vertex_count; ++v)
+		result.offsets[v + 1] += result.offsets[v];
+
+	// counting sort, every vertex lists its corners in index buffer order
+	result.corners.resize(indices.size());
+	std::vector<std::uint32_t> fill(result.offsets.begin(), result.offsets.end() - 1);
+	for (std::size_t i = 0; i < indices.size(); ++i)
+		result.corners[fill[indices[i]]++] = i;
+
+	return result;
+}
+
+void fill_normals(std::vector<vertex> & vertices, std::vector<std::uint32_t> const & indices,
+	vertex_adjacency const & adjacency, normal_weighting weighting, unsigned int threads)
+{
+	auto const faces = compute_faces(vertices, indices, weighting, threads);
+	bool const weighted = !faces.weights.empty();
+
+	parallel_for(vertices.size(), threads, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t v = begin; v < end; ++v)
+		{
+#ifdef MESH_UTILS_SSE2
+			__m128 sum = _mm_setzero_ps();
+			for (std::uint32_t i = adjacency.offsets[v]; i < adjacency.offsets[v + 1]; ++i)
+			{
+				std::uint32_t const corner = adjacency.corners[i];
+				__m128 n = _mm_loadu_ps(&faces.normals[corner / 3].x);
+				sum = _mm_add_ps(sum, weighted ? _mm_mul_ps(n, _mm_set1_ps(faces.weights[corner])) : n);
+			}
+			float n[4];
+			_mm_storeu_ps(n, sum);
+			glm::vec3 normal(n[0], n[1], n[2]);
+#else
+			glm::vec3 normal(0.f);
+			for (std::uint32_t i = adjacency.offsets[v]; i < adjacency.offsets[v + 1]; ++i)
+			{
+				std::uint32_t const corner = adjacency.corners[i];
+				normal += glm::vec3(faces.normals[corner / 3]) * (weighted ? faces.weights[corner] : 1.f);
+			}
+#endif
+			vertices[v].normal = glm::normalize(normal);
+		}
+	});
+}
+
+std::vector<glm::vec4> compute_tangents(std::vector<vertex> const & vertices, std::vector<glm::vec2> const & texcoords,
+	std::vector<std::uint32_t> const & indices, vertex_adjacency const & adjacency, unsigned int threads)
+{
+	if (texcoords.size() != vertices.size())
+		throw std::runtime_error("Tangents need a texture coordinate for every vertex");
+
+	auto const faces = compute_faces(vertices, indices, normal_weighting::angle, threads);
+
+	// texture space directions of every triangle, normalized so that only the corner angles weight them
+	std::size_t const triangles = indices.size() / 3;
+	std::vector<glm::vec3> tangents(triangles), bitangents(triangles);
+	parallel_for(triangles, threads, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t t = begin; t < end; ++t)
+		{
+			std::uint32_t const i0 = indices[3 * t + 0], i1 = indices[3 * t + 1], i2 = indices[3 * t + 2];
+
+			glm::vec3 e1 = vertices[i1].position - vertices[i0].position;
+			glm::vec3 e2 = vertices[i2].position - vertices[i0].position;
+			glm::vec2 d1 = texcoords[i1] - texcoords[i0];
+			glm::vec2 d2 = texcoords[i2] - texcoords[i0];
+
+			float r = d1.x * d2.y - d2.x * d1.y;
+			if (r == 0.f)
+			{
+				tangents[t] = bitangents[t] = glm::vec3(0.f);
+				continue;
+			}
+
+			tangents[t] = normalize_or_zero((e1 * d2.y - e2 * d1.y) / r);
+			bitangents[t] = normalize_or_zero((e2 * d1.x - e1 * d2.x) / r);
+		}
+	});
+
+	std::vector<glm::vec4> result(vertices.size());
+	parallel_for(vertices.size(), threads, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t v = begin; v < end; ++v)
+		{
+			glm::vec3 tangent(0.f), bitangent(0.f);
+			for (std::uint32_t i = adjacency.offsets[v]; i < adjacency.offsets[v + 1]; ++i)
+			{
+				std::uint32_t const corner = adjacency.corners[i];
+				tangent += tangents[corner / 3] * faces.weights[corner];
+				bitangent += bitangents[corner / 3] * faces.weights[corner];
+			}
+
+			glm::vec3 const & normal = vertices[v].normal;
+			tangent = normalize_or_zero(tangent - normal * glm::dot(normal, tangent));
+			// no usable texture mapping around the vertex, any direction in the tangent plane will do
+			if (tangent == glm::vec3(0.f))
+				tangent = normalize_or_zero(glm::cross(normal, std::abs(normal.x) < 0.9f ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(0.f, 1.f, 0.f)));
+
+			result[v] = glm::vec4(tangent, glm::dot(glm::cross(normal, tangent), bitangent) < 0.f ? -1.f : 1.f);
+		}
+	});
+
+	return result;
+}
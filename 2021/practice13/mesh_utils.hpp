@@ -1,6 +1,8 @@
 #pragma once
 
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 
 #include <utility>
 #include <vector>
@@ -17,3 +19,30 @@ std::pair<std::vector<vertex>, std::vector<std::uint32_t>> load_obj(std::istream
 std::pair<glm::vec3, glm::vec3> bbox(std::vector<vertex> const & vertices);
 
 void fill_normals(std::vector<vertex> & vertices, std::vector<std::uint32_t> const & indices);
+
+// Vertex-to-triangle adjacency in CSR form: the corners (positions in the index buffer) referencing vertex v
+// are corners[offsets[v]] ... corners[offsets[v + 1] - 1], and corner / 3 is their triangle
+struct vertex_adjacency
+{
+	std::vector<std::uint32_t> offsets;
+	std::vector<std::uint32_t> corners;
+};
+
+vertex_adjacency build_adjacency(std::size_t vertex_count, std::vector<std::uint32_t> const & indices);
+
+enum class normal_weighting
+{
+	area,  // same normals as fill_normals above
+	angle, // by the triangle angle at the vertex, doesn't depend on how the surface was triangulated
+};
+
+// Gather version of fill_normals: face normals are computed 4 triangles at a time with SSE, then every vertex
+// sums the faces around it, so both passes split between `threads` workers (0 means hardware_concurrency())
+// without write conflicts
+void fill_normals(std::vector<vertex> & vertices, std::vector<std::uint32_t> const & indices,
+	vertex_adjacency const & adjacency, normal_weighting weighting = normal_weighting::angle, unsigned int threads = 0);
+
+// Per-vertex tangents for normal mapping, vertex normals must be filled already. xyz is orthogonal to the normal,
+// w is the handedness: bitangent = w * cross(normal, tangent)
+std::vector<glm::vec4> compute_tangents(std::vector<vertex> const & vertices, std::vector<glm::vec2> const & texcoords,
+	std::vector<std::uint32_t> const & indices, vertex_adjacency const & adjacency, unsigned int threads = 0);
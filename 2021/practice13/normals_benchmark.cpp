@@ -0,0 +1,127 @@
+// Vertex normal generation benchmark.
+//
+// Usage: normals_benchmark [model.obj] [sphere resolution] [max threads]
+// Runs the scatter fill_normals and the gather one with 1, 2, 4, ... worker threads on the model
+// (bunny0.obj by default) and on a UV sphere of resolution x resolution quads (1024 by default), which
+// also has texture coordinates for the tangents.
+
+#include "mesh_utils.hpp"
+
+#include <glm/geometric.hpp>
+#include <glm/trigonometric.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+template <typename Function>
+double measure_ms(Function && function)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	function();
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+float max_angle_degrees(std::vector<vertex> const & a, std::vector<vertex> const & b)
+{
+	float result = 0.f;
+	for (std::size_t i = 0; i < a.size(); ++i)
+		result = std::max(result, std::acos(glm::clamp(glm::dot(a[i].normal, b[i].normal), -1.f, 1.f)));
+	return glm::degrees(result);
+}
+
+void run(std::string const & name, std::vector<vertex> vertices, std::vector<std::uint32_t> const & indices,
+	std::vector<glm::vec2> const & texcoords, unsigned int max_threads)
+{
+	std::cout << name << ": " << vertices.size() << " vertices, " << indices.size() / 3 << " triangles" << std::endl;
+
+	auto scatter = vertices;
+	double scatter_ms = measure_ms([&]{ fill_normals(scatter, indices); });
+	std::cout << "  scatter: " << scatter_ms << " ms" << std::endl;
+
+	vertex_adjacency adjacency;
+	std::cout << "  adjacency: " << measure_ms([&]{ adjacency = build_adjacency(vertices.size(), indices); }) << " ms" << std::endl;
+
+	for (auto weighting : {normal_weighting::area, normal_weighting::angle})
+	{
+		for (unsigned int threads = 1;; threads = std::min(threads * 2, max_threads))
+		{
+			double ms = measure_ms([&]{ fill_normals(vertices, indices, adjacency, weighting, threads); });
+			std::cout << "  gather, " << (weighting == normal_weighting::area ? "area" : "angle") << " weighted, "
+				<< threads << " threads: " << ms << " ms, x" << scatter_ms / ms << std::endl;
+			if (threads >= max_threads)
+				break;
+		}
+		std::cout << "    max difference to scatter: " << max_angle_degrees(vertices, scatter) << " degrees" << std::endl;
+	}
+
+	if (texcoords.empty())
+		return;
+
+	for (unsigned int threads = 1;; threads = std::min(threads * 2, max_threads))
+	{
+		std::vector<glm::vec4> tangents;
+		double ms = measure_ms([&]{ tangents = compute_tangents(vertices, texcoords, indices, adjacency, threads); });
+		std::cout << "  tangents, " << threads << " threads: " << ms << " ms" << std::endl;
+
+		if (threads >= max_threads)
+		{
+			float max_dot = 0.f;
+			for (std::size_t i = 0; i < tangents.size(); ++i)
+				max_dot = std::max(max_dot, std::abs(glm::dot(glm::vec3(tangents[i]), vertices[i].normal)));
+			std::cout << "    max |dot(tangent, normal)|: " << max_dot << std::endl;
+			break;
+		}
+	}
+}
+
+int main(int argc, char * argv[]) try
+{
+	std::string path = argc > 1 ? argv[1] : PRACTICE_SOURCE_DIRECTORY "/bunny0.obj";
+	std::uint32_t resolution = argc > 2 ? std::stoi(argv[2]) : 1024;
+	unsigned int max_threads = argc > 3 ? std::stoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+
+	{
+		std::ifstream in(path);
+		if (!in)
+			throw std::runtime_error("Can't open " + path);
+		auto [vertices, indices] = load_obj(in);
+		run(path, std::move(vertices), indices, {}, max_threads);
+	}
+
+	std::vector<vertex> vertices;
+	std::vector<glm::vec2> texcoords;
+	std::vector<std::uint32_t> indices;
+	for (std::uint32_t i = 0; i <= resolution; ++i)
+	{
+		for (std::uint32_t j = 0; j <= resolution; ++j)
+		{
+			float u = float(j) / resolution, v = float(i) / resolution;
+			float phi = 2.f * glm::pi<float>() * u, theta = glm::pi<float>() * v;
+			vertex p;
+			p.position = {std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+			vertices.push_back(p);
+			texcoords.push_back({u, v});
+		}
+	}
+	for (std::uint32_t i = 0; i < resolution; ++i)
+	{
+		for (std::uint32_t j = 0; j < resolution; ++j)
+		{
+			std::uint32_t base = i * (resolution + 1) + j;
+			for (std::uint32_t index : {base, base + 1, base + resolution + 1, base + resolution + 1, base + 1, base + resolution + 2})
+				indices.push_back(index);
+		}
+	}
+	run("sphere " + std::to_string(resolution), std::move(vertices), indices, texcoords, max_threads);
+}
+catch (std::exception const & e)
+{
+	std::cerr << e.what() << std::endl;
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Triangle mesh as the simplifier sees it: positions at `stride`-byte steps, any other attributes are
+// carried along untouched because simplified meshes only ever reference existing vertices.
+struct simplify_mesh
+{
+	float const * positions;
+	std::size_t vertex_count;
+	std::size_t stride;
+	std::span<std::uint32_t const> indices;
+};
+
+// Quadric error metric edge collapse (Garland & Heckbert), collapsing vertices onto neighbouring
+// vertices. Vertices on mesh borders and attribute seams (several vertices at one position) stay
+// where they are. Stops at `target_index_count` or before the error exceeds `target_error`, which is
+// relative to the mesh extent; the reached error is stored in `result_error`.
+std::vector<std::uint32_t> simplify(simplify_mesh const & mesh, std::size_t target_index_count,
+	float target_error = 1.f, float * result_error = nullptr);
+
+struct lod_options
+{
+	unsigned int levels = 6;
+	float ratio = 0.5f;       // triangle count of level i is ratio^i of the original
+	float max_error = 1.f;    // relative to the mesh extent, levels stop shrinking there
+};
+
+struct lod_level
+{
+	std::uint32_t first;      // into lod_chain::indices
+	std::uint32_t count;
+	float error;              // bound on the distance to the original, the errors of the steps down to it summed
+};
+
+// Every level of every mesh in one index buffer. All levels of a mesh index its original vertices,
+// so they share its vertex buffer.
+struct lod_chain
+{
+	std::vector<std::uint32_t> indices;
+	std::vector<std::vector<lod_level>> meshes;
+};
+
+// Each level is simplified from the one before it, the first being the original, so later levels work on
+// ever smaller meshes. A level that misses its triangle count (max_error reached or nothing left to
+// collapse) is the last one of its mesh, so a mesh may get fewer than `levels` levels but no two the
+// same. Meshes are spread over `threads` worker threads (0 means std::thread::hardware_concurrency()).
+lod_chain build_lod_chain(std::span<simplify_mesh const> meshes, lod_options const & options = {},
+	unsigned int threads = 0);
@@ -1,9 +1,16 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <filesystem>
 
+#include "vertex_index_map.hpp"
+
 namespace obj_parser {
     struct mtl {
         std::string name;
@@ -32,7 +39,74 @@ namespace obj_parser {
     };
 
 
+    enum class parse_mode {
+        stream, // std::getline + std::istringstream per line
+        mapped, // memory-mapped file, tokenized in place with std::from_chars
+        parallel, // as mapped, but line-aligned chunks are tokenized on worker threads and merged in file order
+    };
+
+    // Receives the records of an OBJ file as they are parsed. Face corners arrive resolved to 0-based
+    // (position, texcoord, normal) indices, -1 marking a missing texcoord or normal, and only refer to
+    // elements that were already reported.
+    class obj_visitor {
+    public:
+        virtual ~obj_visitor() = default;
+
+        // element counts, for the parse modes that know them before the first record
+        virtual void reserve(std::size_t /*positions*/, std::size_t /*texcoords*/, std::size_t /*normals*/) {}
+
+        virtual void position(std::array<float, 3> const &/*position*/) {}        // v
+        virtual void texcoord(std::array<float, 2> const &/*texcoord*/) {}        // vt
+        virtual void normal(std::array<float, 3> const &/*normal*/) {}            // vn
+        virtual void face(std::span<std::array<std::uint32_t, 3> const> /*corners*/) {} // f
+        virtual void group(std::string_view /*name*/) {}                          // g
+        virtual void material(mtl const &/*material*/) {}                         // usemtl, looked up in the mtllib
+    };
+
+    // Turns visitor events into indexed triangles: deduplicates face corners into vertices, fans faces
+    // into triangles and splits them into groups by material, exactly as parse_obj does. Where the
+    // results go is up to the subclass, e.g. straight into a mapped GPU buffer.
+    class obj_assembler : public obj_visitor {
+    public:
+        void reserve(std::size_t positions, std::size_t texcoords, std::size_t normals) override;
+        void position(std::array<float, 3> const &position) override;
+        void texcoord(std::array<float, 2> const &texcoord) override;
+        void normal(std::array<float, 3> const &normal) override;
+        void face(std::span<std::array<std::uint32_t, 3> const> corners) override;
+        void group(std::string_view name) override;
+        void material(mtl const &material) override;
+
+        // flushes the last group, call once visit_obj returns
+        void finish();
+
+    protected:
+        // a new unique vertex, indices are handed out consecutively from 0
+        virtual void vertex(std::uint32_t index, obj_data::vertex const &vertex) = 0;
+        virtual void triangle(std::array<std::uint32_t, 3> const &indices) = 0;
+        virtual void group_done(obj_data::group const &group) = 0;
+
+    private:
+        std::vector<std::array<float, 3>> positions_;
+        std::vector<std::array<float, 3>> normals_;
+        std::vector<std::array<float, 2>> texcoords_;
+
+        vertex_index_map index_map_;
+        std::vector<std::uint32_t> face_;
+
+        std::uint32_t vertex_count_ = 0;
+        std::uint32_t index_count_ = 0;
+
+        std::string group_name_;
+        obj_data::group cur_group_{};
+    };
+
     // expands already existing mtl library
     void parse_mtl(std::filesystem::path const &path, mtllib& add);
-    obj_data parse_obj(std::filesystem::path const &path);
+
+    // threads is only used by parse_mode::parallel, 0 means std::thread::hardware_concurrency()
+    void visit_obj(std::filesystem::path const &path, obj_visitor &visitor, parse_mode mode = parse_mode::mapped,
+                   unsigned threads = 0);
+
+    // an obj_assembler collecting everything into obj_data
+    obj_data parse_obj(std::filesystem::path const &path, parse_mode mode = parse_mode::mapped, unsigned threads = 0);
 }
\ No newline at end of file
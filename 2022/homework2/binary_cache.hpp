@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Building blocks for the versioned binary asset caches stored next to their sources
+// (see obj_cache.hpp, gltf_cache.hpp).
+namespace binary_cache {
+    // identifies the exact source file a cache was built from
+    struct source_key {
+        std::uint64_t size = 0;
+        std::int64_t mtime = 0;
+        std::uint64_t hash = 0;
+
+        bool operator==(source_key const &) const = default;
+    };
+
+    std::uint64_t hash_bytes(void const *data, std::size_t size);
+
+    // maps the file and hashes its whole content
+    source_key make_key(std::filesystem::path const &path);
+
+    // "<source>.cache", next to the source asset
+    std::filesystem::path cache_path(std::filesystem::path const &source);
+
+    // array payloads are aligned so that mapped spans can be used directly
+    constexpr std::size_t alignment = 16;
+
+    class writer {
+    public:
+        writer(std::array<char, 8> const &magic, std::uint32_t version);
+
+        template <typename T>
+        void write(T const &value) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            auto bytes = reinterpret_cast<char const *>(&value);
+            data_.insert(data_.end(), bytes, bytes + sizeof(T));
+        }
+
+        template <typename T>
+        void write_array(std::span<T const> values) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            write<std::uint64_t>(values.size());
+            align();
+            auto bytes = reinterpret_cast<char const *>(values.data());
+            data_.insert(data_.end(), bytes, bytes + values.size_bytes());
+        }
+
+        template <typename T>
+        void write_array(std::vector<T> const &values) {
+            write_array(std::span<T const>(values));
+        }
+
+        void write_string(std::string_view value);
+
+        // writes to a temporary file and renames it over `path`, so readers never see a partial cache
+        void save(std::filesystem::path const &path) const;
+
+    private:
+        void align();
+
+        std::vector<char> data_;
+    };
+
+    class reader {
+    public:
+        // throws if the magic or version do not match
+        reader(std::string_view data, std::array<char, 8> const &magic, std::uint32_t version);
+
+        // throws if the next stored key differs from `key`
+        void expect_key(source_key const &key);
+
+        template <typename T>
+        T read() {
+            static_assert(std::is_trivially_copyable_v<T>);
+            T value;
+            std::memcpy(&value, take(sizeof(T)), sizeof(T));
+            return value;
+        }
+
+        // the returned span points into the mapped cache file
+        template <typename T>
+        std::span<T const> read_array() {
+            auto count = read<std::uint64_t>();
+            align();
+            if (count > (end_ - cur_) / sizeof(T))
+                throw std::runtime_error("Truncated cache file");
+            return {reinterpret_cast<T const *>(take(count * sizeof(T))), count};
+        }
+
+        std::string_view read_string();
+
+    private:
+        char const *take(std::size_t size);
+        void align();
+
+        char const *begin_;
+        char const *cur_;
+        char const *end_;
+    };
+}
@@ -27,7 +27,10 @@
 #include <glm/gtx/string_cast.hpp>
 
 #include "obj_parser.hpp"
-#include "stb_image.h"
+#include "obj_cache.hpp"
+#include "texture_loader.hpp"
+#include "texture_atlas.hpp"
+#include "vertex_packing.hpp"
 
 
 std::string to_string(std::string_view str) {
@@ -46,7 +49,9 @@ int main(int argc, char *argv[]) try {
     if (argc < 2) {
         throw std::invalid_argument("Expected \"*.obj\" file path");
     }
-    if (argc > 2) {
+    // --packed uploads quantized 16-byte vertices instead of obj_data::vertex
+    bool const packed_vertices = argc > 2 && std::string_view(argv[2]) == "--packed";
+    if (argc > 2 + packed_vertices) {
         std::cout << "Warning: expected 1 argument, got " << argc - 1 << " instead." << std::endl;
     }
 
@@ -149,7 +154,11 @@ int main(int argc, char *argv[]) try {
     glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 
     std::string scene_path = argv[1];
-    obj_parser::obj_data scene = obj_parser::parse_obj(scene_path);
+    auto load_start = std::chrono::high_resolution_clock::now();
+    auto scene = obj_parser::load_obj_cached(scene_path);
+    std::cout << "Loaded " << scene_path << " in "
+              << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - load_start).count()
+              << " ms (" << (scene.from_cache ? "binary cache" : "parsed") << ")" << std::endl;
 
     // Bounding box
     // 0 - minimum, 1 - maximum
@@ -182,77 +191,61 @@ int main(int argc, char *argv[]) try {
 //    std::cout << Y[0] << " " << center[1] << " " << Y[1] << std::endl;
 //    std::cout << Z[0] << " " << center[2] << " " << Z[1] << std::endl;
 
-    // Load textures
-    GLuint texture;
-//    glGenTextures(1, &texture);
-//    glActiveTexture(GL_TEXTURE0);
-//    glBindTexture(GL_TEXTURE_2D, texture);
-//    int a[4] = {0, 0, 0, 0};
-//    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, a);
-
-    std::map<std::string, std::pair<GLuint, int>> textures_albedo;
-    std::map<std::string, std::pair<GLuint, int>> textures_transparency;
-    int tex_num = 0;
-    for (auto &group: scene.groups) {
-        if (group.material.albedo.empty()) {
-//            std::cout << "no texture!" << std::endl;
-            continue;
-        }
-        if (textures_albedo.find(group.material.albedo) != textures_albedo.end())
-            continue;
-
-        glGenTextures(1, &texture);
-        int unit = tex_num + 1;
-        textures_albedo[group.material.albedo] = {texture, unit};
+    // Load textures: decoded on worker threads, each resized into its layer of one texture array and uploaded
+    // here as it comes in, so the groups draw without binding textures, and the groups with the same material
+    // as one batch
+    auto textures_start = std::chrono::high_resolution_clock::now();
+    GLuint material_textures;
+    texture_atlas::batched_groups batched;
+    {
+        auto paths = texture_loader::texture_paths(scene.groups);
+        texture_loader::decode_pool pool(paths);
+        // the headers are read while the workers decode
+        auto const atlas = texture_atlas::layout(paths);
+
+        GLint max_layers;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+        if (atlas.paths.size() > std::size_t(max_layers))
+            throw std::runtime_error("Too many textures for one texture array");
+
+        glGenTextures(1, &material_textures);
         glActiveTexture(GL_TEXTURE1);
-//        glActiveTexture(GL_TEXTURE0 + unit);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-        int x, y, n;
-        unsigned char *texture_data = stbi_load(group.material.albedo.c_str(), &x, &y, &n, 4);
-        if (texture_data == nullptr) {
-            std::cout << "Cannot load texture " << group.material.albedo.c_str() << ":" << stbi_failure_reason() << std::endl;
-            throw std::runtime_error("Cannot load texture");
-        }
-//        if (n == 4)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, x, y, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data);
-//        else if (n == 3)
-//            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, x, y, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, material_textures);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        // a scene without textures still gets a (1x1x1, undefined) texture array to sample
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, std::max(1, atlas.width), std::max(1, atlas.height),
+                     std::max<GLsizei>(1, atlas.paths.size()), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+        for (texture_loader::decoded_image image; pool.pop(image);) {
+            if (!image.pixels) {
+                std::cout << "Cannot load texture " << image.path << ":" << image.error << std::endl;
+                throw std::runtime_error("Cannot load texture");
+            }
 
-        stbi_image_free(texture_data);
-        ++tex_num;
+            auto upload_start = std::chrono::high_resolution_clock::now();
+            auto const layer = texture_atlas::fit_layer(atlas, image);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, image.index, atlas.width, atlas.height, 1, GL_RGBA,
+                            GL_UNSIGNED_BYTE, layer.data());
 
-        if (group.material.transparency.empty()) {
-//            std::cout << "no transparency!" << std::endl;
-            continue;
-        }
-        else {
-//            std::cout << group.material.transparency << std::endl;
+            std::cout << "  " << image.path << " (" << image.width << "x" << image.height << "): decode "
+                      << image.decode_ms << " ms, resize and upload to layer " << image.index << " "
+                      << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - upload_start).count()
+                      << " ms" << std::endl;
         }
-        if (textures_transparency.find(group.material.transparency) != textures_transparency.end())
-            continue;
-        glGenTextures(1, &texture);
-        unit = tex_num + 1;
-
-        textures_transparency[group.material.transparency] = {texture, unit};
-        glActiveTexture(GL_TEXTURE2);
-//        glActiveTexture(GL_TEXTURE0 + unit);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-        texture_data = stbi_load(group.material.transparency.c_str(), &x, &y, &n, 4);
-        if (texture_data == nullptr) {
-            std::cout << "Cannot load transparency " << group.material.transparency.c_str() << ":" << stbi_failure_reason() << std::endl;
-            throw std::runtime_error("Cannot load transparency");
-        }
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, x, y, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture_data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        stbi_image_free(texture_data);
-        ++tex_num;
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+        std::size_t texture_binds = 0;
+        for (auto const &group: scene.groups)
+            texture_binds += !group.material.albedo.empty() + !group.material.transparency.empty();
+        std::size_t const group_count = scene.groups.size();
+        batched = texture_atlas::batch_groups(scene.groups, scene.indices, atlas);
+
+        std::cout << "Loaded " << pool.size() << " textures in "
+                  << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - textures_start).count()
+                  << " ms, as " << atlas.paths.size() << " layers of " << atlas.width << "x" << atlas.height << std::endl;
+        std::cout << "Per frame: " << texture_binds << " texture binds and " << group_count << " draws -> 0 and "
+                  << batched.batches.size() << std::endl;
     }
 
     // Uniforms - vertex
@@ -266,9 +259,9 @@ int main(int argc, char *argv[]) try {
     auto sun_color_location = glGetUniformLocation(program, "sun_color");
     auto glossiness_location = glGetUniformLocation(program, "glossiness");
     auto roughness_location = glGetUniformLocation(program, "roughness");
-    auto albedo_location = glGetUniformLocation(program, "albedo");
-    auto transparency_location = glGetUniformLocation(program, "transparency");
-    auto solid_location = glGetUniformLocation(program, "solid");
+    auto materials_location = glGetUniformLocation(program, "materials");
+    auto albedo_layer_location = glGetUniformLocation(program, "albedo_layer");
+    auto transparency_layer_location = glGetUniformLocation(program, "transparency_layer");
 
     auto global_shadow_map_location = glGetUniformLocation(program, "shadow_map");
     auto global_shadow_transform_location = glGetUniformLocation(program, "transform");
@@ -284,21 +277,43 @@ int main(int argc, char *argv[]) try {
 
     glGenBuffers(1, &scene_vbo);
     glBindBuffer(GL_ARRAY_BUFFER, scene_vbo);
-    glBufferData(GL_ARRAY_BUFFER, scene.vertices.size() * sizeof(scene.vertices[0]), scene.vertices.data(),
-                 GL_STATIC_DRAW);
+
+    // folds the dequantization of packed positions into the model matrix
+    glm::mat4 scene_model(1.f);
+    if (packed_vertices) {
+        auto packed = vertex_packing::pack(scene.vertices);
+        glBufferData(GL_ARRAY_BUFFER, packed.data.size(), packed.data.data(), GL_STATIC_DRAW);
+        setup_vertex_attributes(packed);
+
+        scene_model = glm::translate(scene_model, glm::vec3(packed.position_offset[0], packed.position_offset[1],
+                                                            packed.position_offset[2]));
+        scene_model = glm::scale(scene_model, glm::vec3(packed.position_scale));
+
+        auto report = vertex_packing::measure(scene.vertices, packed);
+        std::cout << "Packed " << report.vertex_count << " vertices: " << report.float_bytes / 1024 << " KiB -> "
+                  << report.packed_bytes / 1024 << " KiB, " << (report.float_bytes - report.packed_bytes) / 1024
+                  << " KiB less vertex fetch per shadow and scene pass; max error: position "
+                  << report.position_error << ", normal " << report.normal_error_degrees << " deg, texcoord "
+                  << report.texcoord_error << std::endl;
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, scene.vertices.size() * sizeof(scene.vertices[0]), scene.vertices.data(),
+                     GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(obj_parser::obj_data::vertex), nullptr);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(obj_parser::obj_data::vertex), (void *) (12));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(obj_parser::obj_data::vertex), (void *) (24));
+    }
 
     glGenBuffers(1, &scene_ebo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, scene_ebo);
 
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, scene.indices.size() * sizeof(scene.indices[0]), scene.indices.data(),
+    // the same triangles as scene.indices, grouped by material
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, batched.indices.size() * sizeof(batched.indices[0]), batched.indices.data(),
                  GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(obj_parser::obj_data::vertex), nullptr);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(obj_parser::obj_data::vertex), (void *) (12));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(obj_parser::obj_data::vertex), (void *) (24));
+    batched.indices = {};
 
     std::map<SDL_Keycode, bool> button_down;
 
@@ -397,7 +412,7 @@ int main(int argc, char *argv[]) try {
         glEnable(GL_CULL_FACE);
         glCullFace(GL_BACK);
 
-        glm::mat4 model(1.f);
+        glm::mat4 model = scene_model;
 
         glm::vec3 light_direction = glm::normalize(glm::vec3(std::cos(time * 0.1f), 1.f, std::sin(time * 0.1f)));
 
@@ -485,42 +500,16 @@ int main(int argc, char *argv[]) try {
         glUniformMatrix4fv(global_shadow_transform_location, 1, GL_FALSE, reinterpret_cast<float *>(&transform));
         glUniform1f(shadow_bias_location, 0.01f);
 
-        glBindVertexArray(scene_vao);
-        tex_num = 0;
-        for (auto & group: scene.groups) {
-
-//            std::cout << "group of " << group.material.name
-//                      << " with texture material " << group.material.albedo
-//                      << " and alpha-map " << group.material.transparency << std::endl;
-            if  (group.material.albedo.empty()) {
-//                glUniform1i(albedo_location, 0);
-            }
-            else {
-                glActiveTexture(GL_TEXTURE1);
-                glBindTexture(GL_TEXTURE_2D, textures_albedo[group.material.albedo].first);
-                glUniform1i(albedo_location, 1);
-//                glUniform1i(albedo_location, textures_albedo[group.material.albedo].second);
-            }
-
-            if  (group.material.transparency.empty()) {
-                glUniform1i(solid_location, 1);
-//                glUniform1i(transparency_location, 0);
-            }
-            else {
-//                if (group.material.name == "Glass_Pane")
-//                    std::cout << "aaaaa" << std::endl;
-                glUniform1i(solid_location, 0);
-                glActiveTexture(GL_TEXTURE2);
-                glBindTexture(GL_TEXTURE_2D, textures_transparency[group.material.transparency].first);
-                glUniform1i(transparency_location, 2);
-//                glUniform1i(transparency_location, textures_transparency[group.material.transparency].second);
-            }
+        glUniform1i(materials_location, 1);
 
-//            glUniform1i(solid_location, 0);
-            glUniform3fv(glossiness_location, 1, reinterpret_cast<float *>(&group.material.glossiness));
-            glUniform1f(roughness_location, group.material.roughness);
+        glBindVertexArray(scene_vao);
+        for (auto const &batch: batched.batches) {
+            glUniform1i(albedo_layer_location, batch.albedo_layer);
+            glUniform1i(transparency_layer_location, batch.transparency_layer);
+            glUniform3fv(glossiness_location, 1, batch.glossiness.data());
+            glUniform1f(roughness_location, batch.roughness);
 
-            glDrawElements(GL_TRIANGLES, group.count, GL_UNSIGNED_INT, (uint32_t*)nullptr + group.offset);
+            glDrawElements(GL_TRIANGLES, batch.count, GL_UNSIGNED_INT, (uint32_t*)nullptr + batch.offset);
         }
 
         glUseProgram(debug_program);
@@ -15,6 +15,8 @@
 #include <vector>
 #include <map>
 
+#include "vertex_packing.hpp"
+
 std::string readFile(const std::string& file_name, bool verbose = false) {
     // Loads shader from file
     std::string content;
@@ -71,6 +73,17 @@ GLuint create_program(GLuint vertex_shader, GLuint fragment_shader) {
     return result;
 }
 
+// Attribute 0/1/2 = position/normal/texcoord, as in the float layout. Octahedral normals arrive as a
+// vec2 and need octahedral_decode in the shader.
+void setup_vertex_attributes(const vertex_packing::packed_vertices& packed) {
+    GLuint index = 0;
+    for (const auto* attribute : {&packed.position, &packed.normal, &packed.texcoord}) {
+        glEnableVertexAttribArray(index);
+        glVertexAttribPointer(index++, attribute->size, attribute->type, attribute->normalized, packed.stride,
+                              (void *) attribute->offset);
+    }
+}
+
 struct vec2 {
     float x;
     float y;
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+// Read-only memory mapping of a whole file. Empty files map to an empty view.
+class mapped_file {
+public:
+    mapped_file() = default;
+    explicit mapped_file(std::filesystem::path const &path);
+    ~mapped_file();
+
+    mapped_file(mapped_file &&other) noexcept;
+    mapped_file &operator=(mapped_file &&other) noexcept;
+
+    mapped_file(mapped_file const &) = delete;
+    mapped_file &operator=(mapped_file const &) = delete;
+
+    char const *data() const { return data_; }
+    std::size_t size() const { return size_; }
+    std::string_view view() const { return {data_, size_}; }
+
+private:
+    void close();
+
+    char const *data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef WIN32
+    void *file_ = nullptr;
+    void *mapping_ = nullptr;
+#endif
+};
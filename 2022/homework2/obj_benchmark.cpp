@@ -0,0 +1,256 @@
+// Load-time benchmark for obj_parser::parse_obj.
+//
+// Usage: obj_benchmark [scene.obj] [repeats] [max threads]
+// Without a scene path a large synthetic OBJ (a 1024x1024 quad grid with v/vt/vn) is generated
+// in the temporary directory and used instead.
+// Then times obj_parser::load_obj_cached on a cache miss (parse + write "<scene>.cache") and on a hit.
+// Also compares the vertex dedup table against the std::map it replaced on multi-million-corner
+// synthetic meshes, and a streaming obj_visitor computing the bounding box against parse_obj.
+// Finally packs the vertices into every vertex_packing layout and reports size, error and speed.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "obj_parser.hpp"
+#include "obj_cache.hpp"
+#include "binary_cache.hpp"
+#include "vertex_index_map.hpp"
+#include "vertex_packing.hpp"
+
+namespace {
+
+    std::filesystem::path generate_grid_obj(int size) {
+        auto path = std::filesystem::temp_directory_path() / ("obj_benchmark_grid_" + std::to_string(size) + ".obj");
+        if (std::filesystem::exists(path))
+            return path;
+
+        std::ofstream out(path);
+        out << "# synthetic benchmark grid " << size << "x" << size << "\n";
+        for (int i = 0; i <= size; ++i)
+            for (int j = 0; j <= size; ++j) {
+                float x = (j * 1.f) / size, z = (i * 1.f) / size;
+                out << "v " << x << " " << 0.05f * std::sin(x * 20.f) * std::cos(z * 20.f) << " " << z << "\n";
+                out << "vt " << x << " " << z << "\n";
+                out << "vn 0 1 0\n";
+            }
+        for (int i = 0; i < size; ++i)
+            for (int j = 0; j < size; ++j) {
+                int i0 = i * (size + 1) + j + 1;
+                int i1 = i0 + 1;
+                int i2 = i0 + size + 1;
+                int i3 = i2 + 1;
+                out << "f " << i0 << "/" << i0 << "/" << i0 << " "
+                    << i2 << "/" << i2 << "/" << i2 << " "
+                    << i3 << "/" << i3 << "/" << i3 << " "
+                    << i1 << "/" << i1 << "/" << i1 << "\n";
+            }
+        return path;
+    }
+
+    bool same(obj_parser::obj_data const &a, obj_parser::obj_data const &b) {
+        if (a.vertices.size() != b.vertices.size() || a.indices != b.indices || a.groups.size() != b.groups.size())
+            return false;
+        if (std::memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(a.vertices[0])) != 0)
+            return false;
+        for (std::size_t i = 0; i < a.groups.size(); ++i)
+            if (a.groups[i].offset != b.groups[i].offset || a.groups[i].count != b.groups[i].count ||
+                a.groups[i].material.name != b.groups[i].material.name)
+                return false;
+        return true;
+    }
+
+    // best-of-N wall time, in milliseconds
+    double measure(int repeats, std::function<void()> const &f) {
+        double best = std::numeric_limits<double>::infinity();
+        for (int i = 0; i < repeats; ++i) {
+            auto start = std::chrono::high_resolution_clock::now();
+            f();
+            auto end = std::chrono::high_resolution_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+
+    // needs the positions only: nothing is stored, faces are never assembled
+    struct bbox_visitor : obj_parser::obj_visitor {
+        std::array<float, 3> min{std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(),
+                                 std::numeric_limits<float>::infinity()};
+        std::array<float, 3> max{-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+                                 -std::numeric_limits<float>::infinity()};
+
+        void position(std::array<float, 3> const &position) override {
+            for (int i = 0; i < 3; ++i) {
+                min[i] = std::min(min[i], position[i]);
+                max[i] = std::max(max[i], position[i]);
+            }
+        }
+    };
+
+    // face corners of a triangulated size x size grid, like the index triples parse_obj sees:
+    // every vertex is referenced by ~6 corners; `shuffle` destroys the exporter's face order
+    std::vector<std::array<std::uint32_t, 3>> grid_corners(std::uint32_t size, bool shuffle) {
+        std::vector<std::array<std::uint32_t, 3>> triangles;
+        triangles.reserve(2 * size * size);
+        for (std::uint32_t i = 0; i < size; ++i)
+            for (std::uint32_t j = 0; j < size; ++j) {
+                std::uint32_t i0 = i * (size + 1) + j;
+                std::uint32_t i1 = i0 + 1;
+                std::uint32_t i2 = i0 + size + 1;
+                std::uint32_t i3 = i2 + 1;
+                triangles.push_back({i0, i2, i3});
+                triangles.push_back({i0, i3, i1});
+            }
+        if (shuffle)
+            std::shuffle(triangles.begin(), triangles.end(), std::mt19937(42));
+
+        std::vector<std::array<std::uint32_t, 3>> corners;
+        corners.reserve(3 * triangles.size());
+        for (auto const &t: triangles)
+            for (auto v: t)
+                corners.push_back({v, v, v});
+        return corners;
+    }
+
+    void benchmark_index_maps(std::uint32_t size, bool shuffle, int repeats) {
+        auto corners = grid_corners(size, shuffle);
+        std::vector<std::uint32_t> map_result(corners.size()), hash_result(corners.size());
+
+        double map_ms = measure(repeats, [&] {
+            std::map<std::array<std::uint32_t, 3>, std::uint32_t> index_map;
+            for (std::size_t i = 0; i < corners.size(); ++i)
+                map_result[i] = index_map.insert({corners[i], index_map.size()}).first->second;
+        });
+
+        double hash_ms = measure(repeats, [&] {
+            vertex_index_map index_map((size + 1) * (size + 1));
+            for (std::size_t i = 0; i < corners.size(); ++i)
+                hash_result[i] = index_map.try_emplace(corners[i], index_map.size()).first;
+        });
+
+        double to_ns = 1e6 / corners.size();
+        std::cout << "  " << corners.size() / 1000000.0 << "M corners" << (shuffle ? ", shuffled" : "")
+                  << ": std::map " << map_ms * to_ns << " ns/corner, vertex_index_map " << hash_ms * to_ns
+                  << " ns/corner, x" << map_ms / hash_ms
+                  << (map_result == hash_result ? "" : "  [MISMATCH]") << std::endl;
+    }
+
+}
+
+int main(int argc, char *argv[]) try {
+    std::filesystem::path path = argc > 1 ? std::filesystem::path(argv[1]) : generate_grid_obj(1024);
+    int repeats = argc > 2 ? std::stoi(argv[2]) : 3;
+
+    auto file_size = std::filesystem::file_size(path);
+    std::cout << path.string() << ": " << file_size / (1024.0 * 1024.0) << " MiB" << std::endl;
+
+    obj_parser::obj_data reference = obj_parser::parse_obj(path, obj_parser::parse_mode::stream);
+    std::cout << reference.vertices.size() << " vertices, " << reference.indices.size() / 3 << " triangles, "
+              << reference.groups.size() << " groups" << std::endl;
+
+    unsigned max_threads = argc > 3 ? std::stoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+
+    auto report = [&](std::string const &name, obj_parser::parse_mode mode, double baseline, unsigned threads = 0) {
+        obj_parser::obj_data data;
+        double ms = measure(repeats, [&] { data = obj_parser::parse_obj(path, mode, threads); });
+        std::cout << "  " << name << ": " << ms << " ms, " << file_size / (ms * 1000.0) << " MB/s";
+        if (baseline > 0.0)
+            std::cout << ", x" << baseline / ms;
+        std::cout << (same(data, reference) ? "" : "  [MISMATCH]") << std::endl;
+        return ms;
+    };
+
+    double stream_ms = report("stream", obj_parser::parse_mode::stream, 0.0);
+    double mapped_ms = report("mapped", obj_parser::parse_mode::mapped, stream_ms);
+
+    std::cout << "parallel scaling (relative to mapped):" << std::endl;
+    for (unsigned threads = 1;; threads = std::min(threads * 2, max_threads)) {
+        report("parallel x" + std::to_string(threads), obj_parser::parse_mode::parallel, mapped_ms, threads);
+        if (threads >= max_threads)
+            break;
+    }
+
+    std::cout << "binary cache:" << std::endl;
+    {
+        auto cache = binary_cache::cache_path(path);
+        double miss_ms = measure(1, [&] {
+            std::filesystem::remove(cache);
+            obj_parser::load_obj_cached(path);
+        });
+        bool hit = false, equal = false;
+        double hit_ms = measure(repeats, [&] {
+            auto cached = obj_parser::load_obj_cached(path);
+            hit = cached.from_cache;
+            equal = std::equal(cached.indices.begin(), cached.indices.end(), reference.indices.begin(), reference.indices.end()) &&
+                    cached.vertices.size_bytes() == reference.vertices.size() * sizeof(reference.vertices[0]) &&
+                    std::memcmp(cached.vertices.data(), reference.vertices.data(), cached.vertices.size_bytes()) == 0;
+        });
+        std::cout << "  miss (parse + write): " << miss_ms << " ms" << std::endl;
+        std::cout << "  hit: " << hit_ms << " ms, x" << mapped_ms / hit_ms << " vs mapped parse"
+                  << (hit ? "" : "  [NOT CACHED]") << (equal ? "" : "  [MISMATCH]") << std::endl;
+    }
+
+    std::cout << "bounding box:" << std::endl;
+    {
+        // the old way: materialize the whole scene, then walk its vertices
+        bbox_visitor full;
+        double full_ms = measure(repeats, [&] {
+            full = bbox_visitor{};
+            auto data = obj_parser::parse_obj(path);
+            for (auto const &vertex: data.vertices)
+                full.position(vertex.position);
+        });
+        bbox_visitor streamed;
+        double streamed_ms = measure(repeats, [&] {
+            streamed = bbox_visitor{};
+            obj_parser::visit_obj(path, streamed);
+        });
+        std::cout << "  parse_obj + scan: " << full_ms << " ms" << std::endl;
+        std::cout << "  streaming visitor: " << streamed_ms << " ms, x" << full_ms / streamed_ms
+                  << (full.min == streamed.min && full.max == streamed.max ? "" : "  [MISMATCH]") << std::endl;
+    }
+
+    std::cout << "vertex packing:" << std::endl;
+    for (bool quantize: {true, false})
+        for (auto normal: {vertex_packing::normal_format::int_2_10_10_10, vertex_packing::normal_format::octahedral_snorm16})
+            for (auto texcoord: {vertex_packing::texcoord_format::half, vertex_packing::texcoord_format::unorm16}) {
+                vertex_packing::packed_vertices packed;
+                double ms = measure(repeats, [&] {
+                    packed = vertex_packing::pack(reference.vertices, {normal, texcoord, quantize});
+                });
+                auto report = vertex_packing::measure(reference.vertices, packed);
+                // half a step on each axis is under one step in distance, the rest is room for float rounding
+                float const position_tolerance = quantize ? packed.position_scale / 65535.f : 1e-6f;
+                if (report.position_error > position_tolerance)
+                    throw std::runtime_error("Packed positions do not unpack to the originals: error " +
+                                             std::to_string(report.position_error));
+                std::cout << "  " << (quantize ? "unorm16" : "float") << " positions, "
+                          << (normal == vertex_packing::normal_format::int_2_10_10_10 ? "2_10_10_10" : "octahedral")
+                          << " normals, "
+                          << (packed.format.texcoord == vertex_packing::texcoord_format::half ? "half" : "unorm16")
+                          << " texcoords: " << packed.stride << " B/vertex, " << report.float_bytes / 1024 << " -> "
+                          << report.packed_bytes / 1024 << " KiB, max error " << report.position_error << " / "
+                          << report.normal_error_degrees << " deg / " << report.texcoord_error << ", "
+                          << report.vertex_count / (ms * 1000.0) << " M vertices/s" << std::endl;
+            }
+
+    std::cout << "vertex dedup:" << std::endl;
+    for (std::uint32_t size: {512, 1024}) {
+        benchmark_index_maps(size, false, repeats);
+        benchmark_index_maps(size, true, repeats);
+    }
+}
+catch (std::exception const &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "obj_parser.hpp"
+#include "mapped_file.hpp"
+
+#include <span>
+
+namespace obj_parser {
+    // An OBJ scene either mapped from its binary cache or freshly parsed. In both cases the vertex and
+    // index spans can be handed to glBufferData as they are.
+    struct cached_obj {
+        std::span<obj_data::vertex const> vertices;
+        std::span<std::uint32_t const> indices;
+        std::vector<obj_data::group> groups;
+
+        bool from_cache = false;
+
+        // backing storage, only one of them is used
+        mapped_file file;
+        obj_data parsed;
+    };
+
+    // Maps "<path>.cache" if it was built from the current contents of `path` and of the .mtl files its
+    // mtllib lines name (size, mtime and content hash of each). Otherwise parses the OBJ and (re)writes
+    // the cache. A missing or unreadable OBJ gives an empty scene and no cache.
+    cached_obj load_obj_cached(std::filesystem::path const &path, parse_mode mode = parse_mode::mapped);
+
+    void write_obj_cache(std::filesystem::path const &path, obj_data const &data);
+}
@@ -3,9 +3,10 @@
 uniform vec3 camera_position;
 
 //uniform vec3 albedo;
-uniform sampler2D albedo;
-uniform sampler2D transparency;
-uniform int solid;
+// every material texture, a layer each; -1 for no albedo texture, or no transparency map (solid)
+uniform sampler2DArray materials;
+uniform int albedo_layer;
+uniform int transparency_layer;
 
 uniform vec3 sun_direction;
 uniform vec3 sun_color;
@@ -43,8 +44,8 @@ vec3 phong(vec3 direction) {
 
 void main()
 {
-    bool transparent = (solid == 0);
-    if (transparent && texture(transparency, texcoord).x < 0.5)
+    bool transparent = (transparency_layer >= 0);
+    if (transparent && texture(materials, vec3(texcoord, transparency_layer)).x < 0.5)
         discard;
     float ambient_light = 0.2;
 
@@ -80,7 +81,7 @@ void main()
 
     light += sum / sum_w;
 
-    vec4 tex_source = texture(albedo, texcoord);
+    vec4 tex_source = albedo_layer >= 0 ? texture(materials, vec3(texcoord, albedo_layer)) : vec4(1.0);
     vec3 color = (tex_source.xyz / tex_source.w) * light;
 
     out_color = vec4(color, 1.0);
@@ -0,0 +1,163 @@
+#include "texture_atlas.hpp"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+
+namespace texture_atlas {
+    namespace {
+        struct image_view {
+            int width;
+            int height;
+            unsigned char const *pixels;
+        };
+
+        // 2x2 box, the last row or column repeated for odd sizes
+        std::vector<unsigned char> halve(image_view source, int &width, int &height) {
+            width = std::max(1, source.width / 2);
+            height = std::max(1, source.height / 2);
+            std::vector<unsigned char> result(std::size_t(width) * height * 4);
+            for (int y = 0; y < height; ++y) {
+                int const y0 = std::min(2 * y, source.height - 1), y1 = std::min(2 * y + 1, source.height - 1);
+                for (int x = 0; x < width; ++x) {
+                    int const x0 = std::min(2 * x, source.width - 1), x1 = std::min(2 * x + 1, source.width - 1);
+                    for (int c = 0; c < 4; ++c) {
+                        unsigned const sum = source.pixels[(std::size_t(y0) * source.width + x0) * 4 + c]
+                                             + source.pixels[(std::size_t(y0) * source.width + x1) * 4 + c]
+                                             + source.pixels[(std::size_t(y1) * source.width + x0) * 4 + c]
+                                             + source.pixels[(std::size_t(y1) * source.width + x1) * 4 + c];
+                        result[(std::size_t(y) * width + x) * 4 + c] = (sum + 2) / 4;
+                    }
+                }
+            }
+            return result;
+        }
+
+        // bilinear, texel centres to texel centres, edges clamped
+        void resample(image_view source, int width, int height, unsigned char *result) {
+            if (source.width == width && source.height == height) {
+                std::memcpy(result, source.pixels, std::size_t(width) * height * 4);
+                return;
+            }
+
+            float const scale_x = float(source.width) / width, scale_y = float(source.height) / height;
+            for (int y = 0; y < height; ++y) {
+                float const sy = std::clamp((y + 0.5f) * scale_y - 0.5f, 0.f, float(source.height - 1));
+                int const y0 = int(sy), y1 = std::min(y0 + 1, source.height - 1);
+                float const fy = sy - y0;
+                for (int x = 0; x < width; ++x) {
+                    float const sx = std::clamp((x + 0.5f) * scale_x - 0.5f, 0.f, float(source.width - 1));
+                    int const x0 = int(sx), x1 = std::min(x0 + 1, source.width - 1);
+                    float const fx = sx - x0;
+                    for (int c = 0; c < 4; ++c) {
+                        auto texel = [&](int tx, int ty) -> float {
+                            return source.pixels[(std::size_t(ty) * source.width + tx) * 4 + c];
+                        };
+                        float const top = texel(x0, y0) + (texel(x1, y0) - texel(x0, y0)) * fx;
+                        float const bottom = texel(x0, y1) + (texel(x1, y1) - texel(x0, y1)) * fx;
+                        result[(std::size_t(y) * width + x) * 4 + c] = (unsigned char) (top + (bottom - top) * fy + 0.5f);
+                    }
+                }
+            }
+        }
+
+        // halves while the image is at least twice the layer both ways, so bilinear never skips texels
+        void fit(image_view source, int width, int height, unsigned char *result) {
+            std::vector<unsigned char> halved;
+            while (source.width >= 2 * width && source.height >= 2 * height) {
+                int halved_width, halved_height;
+                halved = halve(source, halved_width, halved_height);
+                source = {halved_width, halved_height, halved.data()};
+            }
+            resample(source, width, height, result);
+        }
+    }
+
+    int atlas::layer(std::string const &path) const {
+        if (path.empty())
+            return -1;
+        auto it = std::find(paths.begin(), paths.end(), path);
+        return it == paths.end() ? -1 : int(it - paths.begin());
+    }
+
+    atlas layout(std::vector<std::string> const &paths, options const &options) {
+        atlas result;
+        result.paths = paths;
+        for (auto const &path: paths) {
+            int width, height, n;
+            if (!stbi_info(path.c_str(), &width, &height, &n))
+                throw std::runtime_error("Cannot load texture " + path + ": " + stbi_failure_reason());
+            result.width = std::max(result.width, std::min(width, options.max_size));
+            result.height = std::max(result.height, std::min(height, options.max_size));
+        }
+        return result;
+    }
+
+    std::vector<unsigned char> fit_layer(atlas const &atlas, texture_loader::decoded_image const &image) {
+        if (!image.pixels)
+            throw std::runtime_error("Cannot load texture " + image.path + ": " + image.error);
+        std::vector<unsigned char> result(atlas.layer_size());
+        fit({image.width, image.height, image.pixels.get()}, atlas.width, atlas.height, result.data());
+        return result;
+    }
+
+    batched_groups batch_groups(std::span<obj_parser::obj_data::group const> groups,
+                                std::span<std::uint32_t const> indices, atlas const &atlas) {
+        using key = std::tuple<int, int, std::array<float, 3>, float>;
+
+        batched_groups result;
+        std::map<key, std::size_t> batch_of;
+        std::vector<std::vector<std::size_t>> members;
+        for (std::size_t i = 0; i < groups.size(); ++i) {
+            auto const &material = groups[i].material;
+            key const k{atlas.layer(material.albedo), atlas.layer(material.transparency), material.glossiness,
+                        material.roughness};
+            auto [it, added] = batch_of.emplace(k, result.batches.size());
+            if (added) {
+                result.batches.push_back({std::get<0>(k), std::get<1>(k), material.glossiness, material.roughness, 0, 0});
+                members.emplace_back();
+            }
+            members[it->second].push_back(i);
+        }
+
+        // group counts run past the next group (the parser adds 3 per corner, not per triangle), so a group
+        // ends where the next one starts
+        std::vector<std::size_t> ends(groups.size(), indices.size());
+        std::vector<std::size_t> by_offset(groups.size());
+        std::iota(by_offset.begin(), by_offset.end(), 0);
+        std::stable_sort(by_offset.begin(), by_offset.end(), [&](std::size_t a, std::size_t b) {
+            return groups[a].offset < groups[b].offset;
+        });
+        for (std::size_t k = 0; k + 1 < by_offset.size(); ++k)
+            ends[by_offset[k]] = groups[by_offset[k + 1]].offset;
+        for (std::size_t i = 0; i < groups.size(); ++i)
+            ends[i] = std::min<std::size_t>({ends[i], groups[i].offset + std::size_t(groups[i].count), indices.size()});
+
+        std::vector<bool> drawn(indices.size());
+        result.indices.reserve(indices.size());
+        for (std::size_t b = 0; b < result.batches.size(); ++b) {
+            auto &batch = result.batches[b];
+            batch.offset = result.indices.size();
+            for (auto i: members[b]) {
+                if (groups[i].offset >= ends[i])
+                    continue;
+                for (std::size_t k = groups[i].offset; k < ends[i]; ++k)
+                    drawn[k] = true;
+                result.indices.insert(result.indices.end(), indices.begin() + groups[i].offset, indices.begin() + ends[i]);
+            }
+            batch.count = result.indices.size() - batch.offset;
+        }
+
+        std::erase_if(result.batches, [](batch const &batch) { return batch.count == 0; });
+
+        // triangles in no group, still drawn by the passes that draw the whole buffer
+        for (std::size_t k = 0; k < indices.size(); ++k)
+            if (!drawn[k])
+                result.indices.push_back(indices[k]);
+        return result;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "obj_parser.hpp"
+#include "texture_loader.hpp"
+
+// The material textures of a scene as the layers of one GL_TEXTURE_2D_ARRAY, so that groups pick a layer
+// with a uniform instead of binding textures, and groups with the same material draw as one.
+namespace texture_atlas {
+    struct options {
+        int max_size = 1024; // layers are no wider or higher, larger images are scaled down
+    };
+
+    // RGBA8 layers, all the same size: the largest width and height of the images (up to max_size), the
+    // smaller images scaled up, so texcoords (and GL_REPEAT) work unchanged.
+    struct atlas {
+        int width = 0;
+        int height = 0;
+        std::vector<std::string> paths; // of the image in each layer
+
+        // -1 for an empty or unknown path
+        int layer(std::string const &path) const;
+
+        std::size_t layer_size() const { return std::size_t(width) * height * 4; }
+    };
+
+    // Layer i for paths[i], sized from the image headers alone (stbi_info), so that the texture array can be
+    // allocated before the images are decoded and each layer uploaded as its image comes in. Throws for an
+    // image whose header does not read.
+    atlas layout(std::vector<std::string> const &paths, options const &options = {});
+
+    // The pixels of layer decoded_image::index: `image` resized to the layers of `atlas`.
+    std::vector<unsigned char> fit_layer(atlas const &atlas, texture_loader::decoded_image const &image);
+
+    // What one draw of the scene's groups sets before glDrawElements.
+    struct batch {
+        int albedo_layer;       // -1 for none
+        int transparency_layer; // -1 for a solid material
+        std::array<float, 3> glossiness;
+        float roughness;
+        std::uint32_t offset;
+        std::uint32_t count;
+    };
+
+    struct batched_groups {
+        std::vector<batch> batches;
+        std::vector<std::uint32_t> indices; // all of them, reordered
+    };
+
+    // Reorders `indices` so that the groups with the same layers and material parameters are contiguous,
+    // with one batch for each such set of groups, in the order their first group comes. Only the order of
+    // the groups changes, the triangles within a group keep theirs.
+    batched_groups batch_groups(std::span<obj_parser::obj_data::group const> groups,
+                                std::span<std::uint32_t const> indices, atlas const &atlas);
+}
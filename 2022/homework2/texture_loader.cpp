@@ -0,0 +1,68 @@
+#include "texture_loader.hpp"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <set>
+
+namespace texture_loader {
+    std::vector<std::string> texture_paths(std::vector<obj_parser::obj_data::group> const &groups) {
+        std::vector<std::string> result;
+        std::set<std::string> seen;
+        for (auto const &group: groups)
+            for (auto const *path: {&group.material.albedo, &group.material.transparency})
+                if (!path->empty() && seen.insert(*path).second)
+                    result.push_back(*path);
+        return result;
+    }
+
+    decode_pool::decode_pool(std::vector<std::string> paths, unsigned threads) : paths_(std::move(paths)) {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min<std::size_t>(threads, paths_.size());
+
+        for (unsigned i = 0; i < threads; ++i)
+            workers_.emplace_back(&decode_pool::work, this);
+    }
+
+    decode_pool::~decode_pool() {
+        stop_ = true;
+        for (auto &worker: workers_)
+            worker.join();
+    }
+
+    bool decode_pool::pop(decoded_image &image) {
+        std::unique_lock lock(mutex_);
+        if (popped_ == paths_.size())
+            return false;
+
+        ready_.wait(lock, [this] { return !queue_.empty(); });
+        image = std::move(queue_.front());
+        queue_.pop_front();
+        ++popped_;
+        return true;
+    }
+
+    void decode_pool::work() {
+        // images are claimed one at a time, so a few large textures do not end up on the same worker
+        for (std::size_t index; !stop_ && (index = next_++) < paths_.size();) {
+            decoded_image image;
+            image.index = index;
+            image.path = paths_[index];
+
+            auto start = std::chrono::high_resolution_clock::now();
+            int n;
+            image.pixels = {stbi_load(image.path.c_str(), &image.width, &image.height, &n, 4), stbi_image_free};
+            image.decode_ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::high_resolution_clock::now() - start).count();
+            if (!image.pixels)
+                image.error = stbi_failure_reason(); // thread-local in stb_image
+
+            {
+                std::lock_guard lock(mutex_);
+                queue_.push_back(std::move(image));
+            }
+            ready_.notify_one();
+        }
+    }
+}
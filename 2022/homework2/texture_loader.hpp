@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "obj_parser.hpp"
+
+namespace texture_loader {
+    // An RGBA8 image decoded by stbi_load, still waiting for its glTexImage2D.
+    struct decoded_image {
+        std::size_t index; // into the path list given to decode_pool
+        std::string path;
+        int width = 0;
+        int height = 0;
+        std::unique_ptr<unsigned char, void (*)(void *)> pixels{nullptr, nullptr};
+        double decode_ms = 0.0;
+        std::string error; // stbi_failure_reason() if pixels is empty
+    };
+
+    // Every distinct albedo and transparency map of the groups, in first-use order.
+    std::vector<std::string> texture_paths(std::vector<obj_parser::obj_data::group> const &groups);
+
+    // Decodes images on worker threads and queues them, in completion order, for the thread owning the
+    // GL context. Destroying the pool stops the workers after their current image.
+    class decode_pool {
+    public:
+        // threads = 0 means std::thread::hardware_concurrency()
+        explicit decode_pool(std::vector<std::string> paths, unsigned threads = 0);
+        ~decode_pool();
+
+        decode_pool(decode_pool const &) = delete;
+        decode_pool &operator=(decode_pool const &) = delete;
+
+        // Blocks until the next image is decoded. Returns false once every image has been handed out.
+        bool pop(decoded_image &image);
+
+        std::size_t size() const { return paths_.size(); }
+
+    private:
+        void work();
+
+        std::vector<std::string> paths_;
+        std::atomic<std::size_t> next_{0};
+        std::atomic<bool> stop_{false};
+
+        std::mutex mutex_;
+        std::condition_variable ready_;
+        std::deque<decoded_image> queue_;
+        std::size_t popped_ = 0;
+
+        std::vector<std::thread> workers_;
+    };
+}
@@ -0,0 +1,325 @@
+#include "vertex_packing.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VERTEX_PACKING_SSE2
+#endif
+
+namespace vertex_packing {
+    namespace {
+        // GL enum values, to keep this file free of GL headers
+        constexpr unsigned int gl_short = 0x1402;
+        constexpr unsigned int gl_unsigned_short = 0x1403;
+        constexpr unsigned int gl_float = 0x1406;
+        constexpr unsigned int gl_half_float = 0x140B;
+        constexpr unsigned int gl_int_2_10_10_10_rev = 0x8D9F;
+
+        // round to nearest even, overflow goes to infinity
+        std::uint16_t to_half(float value) {
+            constexpr std::uint32_t f32_infinity = 255u << 23;
+            constexpr std::uint32_t f16_max = (127u + 16u) << 23;
+            constexpr std::uint32_t denormal_magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+            auto x = std::bit_cast<std::uint32_t>(value);
+            std::uint32_t sign = x & 0x80000000u;
+            x ^= sign;
+
+            std::uint16_t result;
+            if (x >= f16_max) {
+                result = x > f32_infinity ? 0x7E00 : 0x7C00;
+            } else if (x < (113u << 23)) {
+                // the FPU does the denormal rounding for us
+                float shifted = std::bit_cast<float>(x) + std::bit_cast<float>(denormal_magic);
+                result = std::bit_cast<std::uint32_t>(shifted) - denormal_magic;
+            } else {
+                std::uint32_t odd = (x >> 13) & 1;
+                x += ((15u - 127u) << 23) + 0xFFFu + odd;
+                result = x >> 13;
+            }
+            return result | (sign >> 16);
+        }
+
+        float from_half(std::uint16_t value) {
+            std::uint32_t sign = std::uint32_t(value & 0x8000) << 16;
+            std::uint32_t exponent = (value >> 10) & 0x1F;
+            std::uint32_t mantissa = value & 0x3FF;
+
+            if (exponent == 0) {
+                float result = std::ldexp(float(mantissa), -24);
+                return sign ? -result : result;
+            }
+            if (exponent == 31)
+                return std::bit_cast<float>(sign | 0x7F800000u | (mantissa << 13));
+            return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+        }
+
+        std::int16_t to_snorm16(float value) {
+            return std::int16_t(std::lrint(std::clamp(value, -1.f, 1.f) * 32767.f));
+        }
+
+        float from_snorm16(std::int16_t value) {
+            return std::max(value / 32767.f, -1.f);
+        }
+
+        float sign_not_zero(float value) {
+            return value < 0.f ? -1.f : 1.f;
+        }
+
+        std::array<std::int16_t, 2> encode_octahedral(std::array<float, 3> const &n) {
+            float l1 = std::abs(n[0]) + std::abs(n[1]) + std::abs(n[2]);
+            if (l1 == 0.f)
+                return {0, 0}; // obj files without vn
+            float x = n[0] / l1, y = n[1] / l1;
+            if (n[2] < 0.f) {
+                float folded_x = (1.f - std::abs(y)) * sign_not_zero(x);
+                y = (1.f - std::abs(x)) * sign_not_zero(y);
+                x = folded_x;
+            }
+            return {to_snorm16(x), to_snorm16(y)};
+        }
+
+        std::array<float, 3> decode_octahedral(std::array<std::int16_t, 2> const &encoded) {
+            float x = from_snorm16(encoded[0]), y = from_snorm16(encoded[1]);
+            float z = 1.f - std::abs(x) - std::abs(y);
+            if (z < 0.f) {
+                float unfolded_x = (1.f - std::abs(y)) * sign_not_zero(x);
+                y = (1.f - std::abs(x)) * sign_not_zero(y);
+                x = unfolded_x;
+            }
+            float length = std::sqrt(x * x + y * y + z * z);
+            return {x / length, y / length, z / length};
+        }
+
+        std::uint32_t pack_2_10_10_10(std::int32_t x, std::int32_t y, std::int32_t z) {
+            return (std::uint32_t(x) & 0x3FF) | (std::uint32_t(y) & 0x3FF) << 10 | (std::uint32_t(z) & 0x3FF) << 20;
+        }
+
+        float unpack_10(std::uint32_t bits) {
+            // sign-extend the 10-bit field
+            auto value = std::int32_t(bits << 22) >> 22;
+            return std::max(value / 511.f, -1.f);
+        }
+
+        template <typename T>
+        void store(char *destination, T const &value) {
+            std::memcpy(destination, &value, sizeof(T));
+        }
+
+        template <typename T>
+        T load(char const *source) {
+            T value;
+            std::memcpy(&value, source, sizeof(T));
+            return value;
+        }
+
+        // positions to unorm16 and normals to 2_10_10_10, the bulk of the work
+        void pack_positions_and_normals(std::span<obj_parser::obj_data::vertex const> vertices,
+                                        packed_vertices &packed) {
+            bool const quantize = packed.format.quantize_positions;
+            bool const int_normals = packed.format.normal == normal_format::int_2_10_10_10;
+            float const inverse_scale = 65535.f / packed.position_scale;
+
+            std::size_t i = 0;
+#ifdef VERTEX_PACKING_SSE2
+            if (quantize && int_normals) {
+                // one vertex per iteration, its three components side by side; the 4th lanes hold the
+                // neighbouring field of the vertex (normal.x, texcoord.u) and are masked out
+                __m128 const offset = _mm_setr_ps(packed.position_offset[0], packed.position_offset[1],
+                                                  packed.position_offset[2], 0.f);
+                __m128 const position_factor = _mm_setr_ps(inverse_scale, inverse_scale, inverse_scale, 0.f);
+                __m128 const normal_factor = _mm_setr_ps(511.f, 511.f, 511.f, 0.f);
+                __m128 const zero = _mm_setzero_ps(), unorm_max = _mm_set1_ps(65535.f);
+                __m128 const snorm_min = _mm_set1_ps(-511.f);
+                __m128i const bias = _mm_set1_epi32(32768);
+                __m128i const bias16 = _mm_set1_epi16(std::int16_t(0x8000));
+                __m128i const mask10 = _mm_set1_epi32(0x3FF);
+
+                for (; i < vertices.size(); ++i) {
+                    char *destination = packed.data.data() + i * packed.stride;
+                    auto const &vertex = vertices[i];
+
+                    __m128 position = _mm_loadu_ps(vertex.position.data());
+                    position = _mm_mul_ps(_mm_sub_ps(position, offset), position_factor);
+                    position = _mm_min_ps(_mm_max_ps(position, zero), unorm_max);
+                    // no unsigned saturating 32 -> 16 pack in SSE2: shift into the signed range and back
+                    __m128i q = _mm_sub_epi32(_mm_cvtps_epi32(position), bias);
+                    q = _mm_xor_si128(_mm_packs_epi32(q, q), bias16);
+                    _mm_storel_epi64(reinterpret_cast<__m128i *>(destination + packed.position.offset), q);
+
+                    __m128 normal = _mm_mul_ps(_mm_loadu_ps(vertex.normal.data()), normal_factor);
+                    normal = _mm_min_ps(_mm_max_ps(normal, snorm_min), normal_factor);
+                    __m128i n = _mm_and_si128(_mm_cvtps_epi32(normal), mask10);
+                    std::uint32_t bits = std::uint32_t(_mm_cvtsi128_si32(n)) |
+                                         std::uint32_t(_mm_cvtsi128_si32(_mm_srli_si128(n, 4))) << 10 |
+                                         std::uint32_t(_mm_cvtsi128_si32(_mm_srli_si128(n, 8))) << 20;
+                    store(destination + packed.normal.offset, bits);
+                }
+            }
+#endif
+            for (; i < vertices.size(); ++i) {
+                char *destination = packed.data.data() + i * packed.stride;
+                auto const &vertex = vertices[i];
+
+                if (quantize) {
+                    std::array<std::uint16_t, 4> q{0, 0, 0, 0};
+                    for (int k = 0; k < 3; ++k)
+                        q[k] = std::uint16_t(std::lrint(std::clamp(
+                                (vertex.position[k] - packed.position_offset[k]) * inverse_scale, 0.f, 65535.f)));
+                    store(destination + packed.position.offset, q);
+                } else {
+                    store(destination + packed.position.offset, vertex.position);
+                }
+
+                if (int_normals) {
+                    std::array<std::int32_t, 3> q;
+                    for (int k = 0; k < 3; ++k)
+                        q[k] = std::lrint(std::clamp(vertex.normal[k], -1.f, 1.f) * 511.f);
+                    store(destination + packed.normal.offset, pack_2_10_10_10(q[0], q[1], q[2]));
+                } else {
+                    store(destination + packed.normal.offset, encode_octahedral(vertex.normal));
+                }
+            }
+        }
+    }
+
+    char const octahedral_decode_glsl[] = R"(
+vec3 octahedral_decode(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x < 0.0 ? -1.0 : 1.0, v.y < 0.0 ? -1.0 : 1.0);
+    return normalize(v);
+}
+)";
+
+    packed_vertices pack(std::span<obj_parser::obj_data::vertex const> vertices, options const &format) {
+        packed_vertices result;
+        result.format = format;
+        result.count = vertices.size();
+
+        if (format.texcoord == texcoord_format::unorm16) {
+            bool in_range = std::all_of(vertices.begin(), vertices.end(), [](auto const &vertex) {
+                return vertex.texcoord[0] >= 0.f && vertex.texcoord[0] <= 1.f &&
+                       vertex.texcoord[1] >= 0.f && vertex.texcoord[1] <= 1.f;
+            });
+            if (!in_range)
+                result.format.texcoord = texcoord_format::half; // tiled textures
+        }
+
+        // every attribute starts 4-byte aligned
+        if (format.quantize_positions)
+            result.position = {3, gl_unsigned_short, true, 0};
+        else
+            result.position = {3, gl_float, false, 0};
+        result.normal.offset = format.quantize_positions ? 8 : 12;
+        if (format.normal == normal_format::int_2_10_10_10)
+            result.normal = {4, gl_int_2_10_10_10_rev, true, result.normal.offset};
+        else
+            result.normal = {2, gl_short, true, result.normal.offset};
+        if (result.format.texcoord == texcoord_format::half)
+            result.texcoord = {2, gl_half_float, false, result.normal.offset + 4};
+        else
+            result.texcoord = {2, gl_unsigned_short, true, result.normal.offset + 4};
+        result.stride = result.texcoord.offset + 4;
+
+        result.data.resize(result.stride * vertices.size());
+
+        if (format.quantize_positions && !vertices.empty()) {
+            std::array<float, 3> min = vertices[0].position, max = vertices[0].position;
+            for (auto const &vertex: vertices)
+                for (int k = 0; k < 3; ++k) {
+                    min[k] = std::min(min[k], vertex.position[k]);
+                    max[k] = std::max(max[k], vertex.position[k]);
+                }
+
+            float extent = std::max({max[0] - min[0], max[1] - min[1], max[2] - min[2]});
+            result.position_offset = min;
+            result.position_scale = extent > 0.f ? extent : 1.f;
+        }
+
+        pack_positions_and_normals(vertices, result);
+
+        for (std::size_t i = 0; i < vertices.size(); ++i) {
+            char *destination = result.data.data() + i * result.stride + result.texcoord.offset;
+            auto const &texcoord = vertices[i].texcoord;
+            if (result.format.texcoord == texcoord_format::half)
+                store(destination, std::array<std::uint16_t, 2>{to_half(texcoord[0]), to_half(texcoord[1])});
+            else
+                store(destination, std::array<std::uint16_t, 2>{std::uint16_t(std::lrint(texcoord[0] * 65535.f)),
+                                                                std::uint16_t(std::lrint(texcoord[1] * 65535.f))});
+        }
+
+        return result;
+    }
+
+    obj_parser::obj_data::vertex unpack(packed_vertices const &packed, std::size_t i) {
+        char const *source = packed.data.data() + i * packed.stride;
+        obj_parser::obj_data::vertex result;
+
+        if (packed.format.quantize_positions) {
+            // as setup_vertex_attributes hands the attribute to GL: normalized means q / 65535
+            auto q = load<std::array<std::uint16_t, 3>>(source + packed.position.offset);
+            float const unit = packed.position.normalized ? 1.f / 65535.f : 1.f;
+            for (int k = 0; k < 3; ++k)
+                result.position[k] = packed.position_offset[k] + packed.position_scale * (q[k] * unit);
+        } else {
+            result.position = load<std::array<float, 3>>(source + packed.position.offset);
+        }
+
+        if (packed.format.normal == normal_format::int_2_10_10_10) {
+            auto bits = load<std::uint32_t>(source + packed.normal.offset);
+            result.normal = {unpack_10(bits), unpack_10(bits >> 10), unpack_10(bits >> 20)};
+        } else {
+            result.normal = decode_octahedral(load<std::array<std::int16_t, 2>>(source + packed.normal.offset));
+        }
+
+        auto t = load<std::array<std::uint16_t, 2>>(source + packed.texcoord.offset);
+        if (packed.format.texcoord == texcoord_format::half)
+            result.texcoord = {from_half(t[0]), from_half(t[1])};
+        else
+            result.texcoord = {t[0] / 65535.f, t[1] / 65535.f};
+
+        return result;
+    }
+
+    packing_report measure(std::span<obj_parser::obj_data::vertex const> vertices, packed_vertices const &packed) {
+        packing_report report;
+        report.vertex_count = vertices.size();
+        report.float_bytes = vertices.size_bytes();
+        report.packed_bytes = packed.data.size();
+
+        for (std::size_t i = 0; i < vertices.size(); ++i) {
+            auto const &original = vertices[i];
+            auto unpacked = unpack(packed, i);
+
+            float distance = 0.f, dot = 0.f, length = 0.f;
+            for (int k = 0; k < 3; ++k) {
+                float d = original.position[k] - unpacked.position[k];
+                distance += d * d;
+                dot += original.normal[k] * unpacked.normal[k];
+                length += original.normal[k] * original.normal[k];
+            }
+            report.position_error = std::max(report.position_error, std::sqrt(distance));
+
+            if (length > 0.f) {
+                float unpacked_length = std::sqrt(unpacked.normal[0] * unpacked.normal[0] +
+                                                  unpacked.normal[1] * unpacked.normal[1] +
+                                                  unpacked.normal[2] * unpacked.normal[2]);
+                float cosine = std::clamp(dot / std::sqrt(length) / unpacked_length, -1.f, 1.f);
+                report.normal_error_degrees = std::max(report.normal_error_degrees,
+                                                       std::acos(cosine) * 180.f / 3.14159265f);
+            }
+
+            for (int k = 0; k < 2; ++k)
+                report.texcoord_error = std::max(report.texcoord_error,
+                                                 std::abs(original.texcoord[k] - unpacked.texcoord[k]));
+        }
+        return report;
+    }
+}
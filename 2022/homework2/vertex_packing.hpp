@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "obj_parser.hpp"
+
+// Compact vertex layouts for obj_data: 16 bytes instead of 32 with everything quantized.
+namespace vertex_packing {
+    enum class normal_format {
+        int_2_10_10_10,     // GL_INT_2_10_10_10_REV, normalized; drop-in for a vec3 attribute
+        octahedral_snorm16, // 2 x GL_SHORT, normalized; decode with octahedral_decode_glsl
+    };
+
+    enum class texcoord_format {
+        half,    // GL_HALF_FLOAT
+        unorm16, // GL_UNSIGNED_SHORT, normalized; only if every texcoord is in [0, 1], otherwise half is used
+    };
+
+    struct options {
+        normal_format normal = normal_format::int_2_10_10_10;
+        texcoord_format texcoord = texcoord_format::half;
+        // unorm16 in the bounding cube of the mesh, see packed_vertices::position_scale
+        bool quantize_positions = true;
+    };
+
+    // Arguments of glVertexAttribPointer, types are GL enum values.
+    struct attribute {
+        int size;
+        unsigned int type;
+        bool normalized;
+        std::size_t offset;
+    };
+
+    struct packed_vertices {
+        std::vector<char> data;
+        std::size_t stride = 0;
+        std::size_t count = 0;
+
+        attribute position;
+        attribute normal;
+        attribute texcoord;
+
+        // position = position_offset + position_scale * attribute, the attribute as the shader reads it
+        // (normalized unorm16, in [0, 1]). The scale is the same on every axis, so it folds into the model
+        // matrix without skewing normals.
+        std::array<float, 3> position_offset{0.f, 0.f, 0.f};
+        float position_scale = 1.f;
+
+        options format; // what was actually used
+    };
+
+    packed_vertices pack(std::span<obj_parser::obj_data::vertex const> vertices, options const &format = {});
+
+    // Unpacks vertex i the way GL reads the attributes, including the position transform.
+    obj_parser::obj_data::vertex unpack(packed_vertices const &packed, std::size_t i);
+
+    struct packing_report {
+        std::size_t vertex_count = 0;
+        std::size_t float_bytes = 0;
+        std::size_t packed_bytes = 0;
+
+        // worst case over all vertices
+        float position_error = 0.f;     // in model units
+        float normal_error_degrees = 0.f;
+        float texcoord_error = 0.f;
+    };
+
+    packing_report measure(std::span<obj_parser::obj_data::vertex const> vertices, packed_vertices const &packed);
+
+    // GLSL for the octahedral_snorm16 layout: `vec3 normal = octahedral_decode(in_normal);`
+    extern char const octahedral_decode_glsl[];
+}
@@ -0,0 +1,358 @@
+// Skeletal animation benchmark.
+//
+// Usage: animation_benchmark [frames] [model.gltf | model.glb]
+// Plays every animation of the model (the wolf by default) for `frames` frames at 60 fps (10000 by default),
+// looping it, and prints the average time per frame of sampling all of its channels with a binary search
+// per channel, with a cursor per channel and with the batch animation::sample, checking that they agree.
+// Random seeks are sampled with cursors too, to show that they fall back to the binary search.
+// Then the skinning palette of every animation is computed with pose_evaluator and the way main used
+// to, copying the clip and walking up the ancestors of every bone, which is also timed on synthetic
+// skeletons of 16 to 4096 bones. A blend_tree mixing all the animations, with an additive and a masked
+// layer on top, is timed, and so is its nlerp against a scalar one. Every animation is baked at its key
+// rate (24 frames per second for the wolf), which has to stay within bake_tolerance, and at 30 and 60
+// frames per second, and compressed at a few tolerances, with the size, the error and how fast the result
+// is sampled.
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "gltf_loader.hpp"
+#include "skeleton_pose.hpp"
+#include "blend_tree.hpp"
+#include "baked_animation.hpp"
+#include "compressed_animation.hpp"
+
+namespace {
+
+    struct pose {
+        std::vector<glm::vec3> translations;
+        std::vector<glm::quat> rotations;
+        std::vector<glm::vec3> scales;
+
+        explicit pose(std::size_t bones)
+                : translations(bones), rotations(bones), scales(bones) {}
+
+        bool operator==(pose const &other) const = default;
+    };
+
+    template <typename Function>
+    double average_us(int iterations, Function &&function) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            function(i);
+        return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    }
+
+    float frame_time(gltf_model::animation const &animation, int frame) {
+        return animation.max_time > 0.f ? std::fmod(frame / 60.f, animation.max_time) : 0.f;
+    }
+
+    void sample_search(gltf_model::animation const &animation, float time, pose &result) {
+        for (std::size_t i = 0; i < animation.bones.size(); ++i) {
+            auto const &bone = animation.bones[i];
+            result.translations[i] = bone.translation.values.empty() ? glm::vec3(0.f) : bone.translation(time);
+            result.rotations[i] = bone.rotation.values.empty() ? glm::quat(1.f, 0.f, 0.f, 0.f) : bone.rotation(time);
+            result.scales[i] = bone.scale.values.empty() ? glm::vec3(1.f) : bone.scale(time);
+        }
+    }
+
+    void sample_cursor(gltf_model::animation const &animation, float time, std::vector<std::size_t> &cursors, pose &result) {
+        cursors.resize(3 * animation.bones.size(), 0);
+        for (std::size_t i = 0; i < animation.bones.size(); ++i) {
+            auto const &bone = animation.bones[i];
+            auto *cursor = cursors.data() + 3 * i;
+            result.translations[i] = bone.translation.values.empty() ? glm::vec3(0.f) : bone.translation(time, cursor[0]);
+            result.rotations[i] = bone.rotation.values.empty() ? glm::quat(1.f, 0.f, 0.f, 0.f) : bone.rotation(time, cursor[1]);
+            result.scales[i] = bone.scale.values.empty() ? glm::vec3(1.f) : bone.scale(time, cursor[2]);
+        }
+    }
+
+    void measure_sampling(std::string const &name, gltf_model::animation const &animation, int frames) {
+        std::size_t keys = 0;
+        for (auto const &bone: animation.bones)
+            keys += bone.translation.timestamps.size() + bone.rotation.timestamps.size() + bone.scale.timestamps.size();
+        std::cout << "  " << name << ": " << animation.max_time << " s, " << keys << " keys" << std::endl;
+
+        std::size_t const bones = animation.bones.size();
+        pose expected(bones), actual(bones);
+        std::vector<std::size_t> cursors;
+        for (int frame = 0; frame < frames; ++frame) {
+            float const time = frame_time(animation, frame);
+            sample_search(animation, time, expected);
+            sample_cursor(animation, time, cursors, actual);
+            if (!(actual == expected))
+                throw std::runtime_error("Cursor sampling disagrees at " + std::to_string(time) + " s in " + name);
+        }
+
+        double const search_us = average_us(frames, [&](int frame) { sample_search(animation, frame_time(animation, frame), actual); });
+        cursors.clear();
+        double const cursor_us = average_us(frames, [&](int frame) { sample_cursor(animation, frame_time(animation, frame), cursors, actual); });
+        cursors.clear();
+        double const batch_us = average_us(frames, [&](int frame) {
+            animation.sample(frame_time(animation, frame), cursors, actual.translations, actual.rotations, actual.scales);
+        });
+
+        std::mt19937 random(frames);
+        std::uniform_real_distribution<float> seek(0.f, animation.max_time);
+        std::vector<float> seeks(frames);
+        for (auto &time: seeks)
+            time = seek(random);
+        cursors.clear();
+        double const seek_us = average_us(frames, [&](int frame) { sample_cursor(animation, seeks[frame], cursors, actual); });
+
+        std::cout << "    per frame: binary search " << search_us << " us, cursors " << cursor_us << " us (x" << search_us / cursor_us
+                  << "), batch " << batch_us << " us (x" << search_us / batch_us << "), cursors on random seeks " << seek_us << " us" << std::endl;
+    }
+
+    // what main did before pose_evaluator, copies included
+    void old_palette(std::vector<gltf_model::bone> const &skeleton, gltf_model::animation animation, float time,
+                     std::vector<glm::mat4x3> &bones) {
+        bones.assign(skeleton.size(), glm::mat4x3(1.f));
+        for (int i = 0; i < static_cast<int>(bones.size()); ++i) {
+            glm::mat4 transform = glm::mat4(1.f);
+            int p = i;
+            while (p != -1) {
+                auto bone = animation.bones[p];
+                glm::mat4 translation = glm::translate(glm::mat4(1.f), bone.translation(time));
+                glm::mat4 rotation = glm::toMat4(bone.rotation(time));
+                glm::mat4 scaling = glm::scale(glm::mat4(1.f), bone.scale(time));
+                transform = translation * rotation * scaling * transform;
+                p = skeleton[p].parent;
+            }
+            bones[i] = transform * skeleton[i].inverse_bind_matrix;
+        }
+    }
+
+    // returns the maximum difference of palette entries
+    float measure_pose(std::vector<gltf_model::bone> const &skeleton, gltf_model::animation const &animation, int frames) {
+        pose_evaluator evaluator(skeleton);
+        skeleton_pose pose(skeleton.size());
+        std::vector<std::size_t> cursors;
+        std::vector<glm::mat4x3> expected;
+
+        float error = 0.f;
+        for (int frame = 0; frame < std::min(frames, 100); ++frame) {
+            float const time = frame_time(animation, frame);
+            old_palette(skeleton, animation, time, expected);
+            sample_pose(animation, time, cursors, pose);
+            auto const palette = evaluator.evaluate(pose);
+            for (std::size_t i = 0; i < palette.size(); ++i)
+                for (int c = 0; c < 4; ++c)
+                    for (int r = 0; r < 3; ++r)
+                        error = std::max(error, std::abs(palette[i][c][r] - expected[i][c][r]));
+        }
+
+        int const old_frames = std::max(3, frames / static_cast<int>(skeleton.size()));
+        double const old_us = average_us(old_frames, [&](int frame) { old_palette(skeleton, animation, frame_time(animation, frame), expected); });
+        cursors.clear();
+        double const new_us = average_us(frames, [&](int frame) {
+            sample_pose(animation, frame_time(animation, frame), cursors, pose);
+            evaluator.evaluate(pose);
+        });
+        double const evaluate_us = average_us(frames, [&](int) { evaluator.evaluate(pose); });
+
+        std::cout << "    palette per frame: ancestor walk " << old_us << " us, sampling + pose_evaluator " << new_us << " us (x"
+                  << old_us / new_us << "), of which evaluate " << evaluate_us << " us" << std::endl;
+        return error;
+    }
+
+    // limbs of 8 bones hanging off random earlier bones, every channel with 30 random keys over a second
+    void make_skeleton(std::size_t size, std::vector<gltf_model::bone> &skeleton, gltf_model::animation &animation) {
+        std::mt19937 random(size);
+        std::uniform_real_distribution<float> value(-1.f, 1.f);
+
+        skeleton.assign(size, {});
+        animation.bones.assign(size, {});
+        animation.max_time = 1.f;
+        for (std::size_t i = 0; i < size; ++i) {
+            if (i > 0)
+                skeleton[i].parent = i % 8 != 0 ? i - 1 : std::uniform_int_distribution<std::size_t>(0, i - 1)(random);
+            skeleton[i].inverse_bind_matrix = glm::translate(glm::mat4(1.f), glm::vec3(value(random), value(random), value(random)));
+
+            auto &bone = animation.bones[i];
+            for (int k = 0; k < 30; ++k) {
+                float const time = k / 29.f;
+                bone.translation.timestamps.push_back(time);
+                bone.translation.values.emplace_back(value(random), value(random), value(random));
+                bone.rotation.timestamps.push_back(time);
+                bone.rotation.values.push_back(glm::normalize(glm::quat(value(random), value(random), value(random), value(random))));
+                bone.scale.timestamps.push_back(time);
+                bone.scale.values.emplace_back(1.f + 0.1f * value(random));
+            }
+        }
+    }
+
+    void measure_blend_tree(gltf_model const &model, int frames) {
+        std::vector<gltf_model::animation const *> animations;
+        for (auto const &[name, animation]: model.animations)
+            animations.push_back(&animation);
+
+        // all the clips mixed equally, the first one added on top relative to its first frame, and the
+        // second one layered over the second half of the skeleton
+        blend_tree tree(model.bones.size());
+        std::vector<blend_tree::node_id> clips;
+        for (auto const *animation: animations)
+            clips.push_back(tree.add_clip(*animation));
+        auto mix = clips[0];
+        for (std::size_t i = 1; i < clips.size(); ++i)
+            mix = tree.add_lerp(mix, clips[i], 1.f / (i + 1));
+        auto const reference = tree.add_clip(*animations[0]);
+        auto const additive = tree.add_additive(mix, clips[0], reference, 0.5f);
+        std::vector<float> mask(model.bones.size(), 0.f);
+        std::fill(mask.begin() + mask.size() / 2, mask.end(), 1.f);
+        tree.add_layer(additive, clips[std::min<std::size_t>(1, clips.size() - 1)], mask, 0.75f);
+
+        pose_evaluator evaluator(model.bones);
+        double const blend_us = average_us(frames, [&](int frame) {
+            for (auto clip: clips)
+                tree.set_time(clip, frame / 60.f);
+            evaluator.evaluate(tree.evaluate());
+        });
+        std::cout << "blend tree of " << tree.size() << " nodes over " << clips.size() << " clips: " << blend_us
+                  << " us per frame with the palette" << std::endl;
+
+        // against the scalar loop over quaternions stored one after another
+        std::size_t const count = 4096;
+        std::mt19937 random(count);
+        std::uniform_real_distribution<float> value(-1.f, 1.f);
+        std::vector<glm::quat> a(count), b(count), scalar(count);
+        skeleton_pose pose_a(count), pose_b(count), simd(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            a[i] = glm::normalize(glm::quat(value(random), value(random), value(random), value(random)));
+            b[i] = glm::normalize(glm::quat(value(random), value(random), value(random), value(random)));
+            pose_a.set_rotation(i, a[i]);
+            pose_b.set_rotation(i, b[i]);
+        }
+        float const weight = 0.3f;
+        double const scalar_us = average_us(frames, [&](int) {
+            for (std::size_t i = 0; i < count; ++i) {
+                glm::quat const target = glm::dot(a[i], b[i]) < 0.f ? -b[i] : b[i];
+                scalar[i] = glm::normalize(a[i] + (target - a[i]) * weight);
+            }
+        });
+        double const simd_us = average_us(frames, [&](int) { nlerp(pose_a, pose_b, weight, nullptr, simd); });
+        float error = 0.f;
+        for (std::size_t i = 0; i < count; ++i) {
+            glm::quat const r = simd.rotation(i);
+            error = std::max(error, glm::length(glm::vec4(r.x - scalar[i].x, r.y - scalar[i].y, r.z - scalar[i].z, r.w - scalar[i].w)));
+        }
+        std::cout << "nlerp of " << count << " rotations: scalar on glm::quat " << scalar_us << " us, by component "
+                  << simd_us << " us (x" << scalar_us / simd_us << "), max difference " << error << std::endl;
+    }
+
+    void measure_baking(std::string const &name, gltf_model::animation const &animation, int frames) {
+        skeleton_pose pose(animation.bones.size());
+        std::vector<std::size_t> cursors;
+        double const cursor_us = average_us(frames, [&](int frame) { sample_pose(animation, frame_time(animation, frame), cursors, pose); });
+        std::cout << "  " << name << ": splines " << memory_size(animation) / 1024 << " KiB, sampled with cursors in "
+                  << cursor_us << " us" << std::endl;
+
+        // 0 is the default, the key rate
+        for (float rate: {0.f, 30.f, 60.f}) {
+            auto const start = std::chrono::high_resolution_clock::now();
+            auto const baked = bake_animation(animation, rate);
+            double const bake_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            auto const error = measure_error(baked, animation);
+            if (rate == 0.f && !error.within(bake_tolerance))
+                throw std::runtime_error(name + " baked at its key rate is beyond bake_tolerance: rotation off by " +
+                                         std::to_string(glm::degrees(error.rotation)) + " degrees");
+            double const baked_us = average_us(frames, [&](int frame) { baked.sample(frame_time(animation, frame), pose); });
+            std::cout << "    ";
+            if (rate == 0.f)
+                std::cout << "key rate (" << key_rate(animation) << ")";
+            else
+                std::cout << rate;
+            std::cout << " fps: " << baked.frames << " frames, " << baked.memory_size() / 1024 << " KiB, baked in "
+                      << bake_ms << " ms, sampled in " << baked_us << " us (x" << cursor_us / baked_us << "), max error: translation "
+                      << error.translation << ", rotation " << glm::degrees(error.rotation) << " degrees, scale " << error.scale
+                      << (error.within(bake_tolerance) ? "" : "  [BEYOND TOLERANCE]") << std::endl;
+        }
+    }
+
+    void measure_compression(std::string const &name, gltf_model::animation const &animation, int frames) {
+        std::size_t keys = 0;
+        for (auto const &bone: animation.bones)
+            keys += bone.translation.values.size() + bone.rotation.values.size() + bone.scale.values.size();
+
+        skeleton_pose pose(animation.bones.size());
+        std::vector<std::size_t> cursors;
+        double const cursor_us = average_us(frames, [&](int frame) { sample_pose(animation, frame_time(animation, frame), cursors, pose); });
+        std::cout << "  " << name << ": splines " << memory_size(animation) / 1024 << " KiB, " << keys << " keys, sampled with cursors in "
+                  << cursor_us << " us" << std::endl;
+
+        for (float scale: {1.f, 10.f}) {
+            compression_options options;
+            options.translation_tolerance *= scale;
+            options.rotation_tolerance *= scale;
+            options.scale_tolerance *= scale;
+
+            auto const start = std::chrono::high_resolution_clock::now();
+            auto const compressed = compress_animation(animation, options);
+            double const compress_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+            std::size_t kept = 0, collapsed = 0, identity = 0;
+            for (auto const *track: {&compressed.translations, &compressed.rotations, &compressed.scales}) {
+                kept += track->keys.size();
+                for (auto const &channel: track->channels) {
+                    collapsed += channel.count == 1;
+                    identity += channel.count == 0;
+                }
+            }
+
+            auto const error = measure_error(compressed, animation);
+            cursors.clear();
+            double const decode_us = average_us(frames, [&](int frame) { compressed.sample(frame_time(animation, frame), cursors, pose); });
+            std::cout << "    tolerance x" << scale << ": " << compressed.memory_size() / 1024 << " KiB (x"
+                      << double(memory_size(animation)) / compressed.memory_size() << " smaller), " << kept << " keys, "
+                      << collapsed << " constant and " << identity << " identity channels, compressed in " << compress_ms
+                      << " ms, sampled in " << decode_us << " us, max error: translation " << error.translation << ", rotation "
+                      << glm::degrees(error.rotation) << " degrees, scale " << error.scale << std::endl;
+        }
+    }
+
+}
+
+int main(int argc, char *argv[]) try {
+    int const frames = argc > 1 ? std::stoi(argv[1]) : 10000;
+    std::string const path = argc > 2 ? argv[2] : std::string(PROJECT_ROOT) + "/external/wolf/Wolf-Blender-2.82a.gltf";
+
+    auto const model = load_gltf(path);
+    std::cout << path << ": " << model.bones.size() << " bones, " << model.animations.size() << " animations" << std::endl;
+
+    for (auto const &[name, animation]: model.animations)
+        measure_sampling(name, animation, frames);
+
+    std::cout << "skinning palettes:" << std::endl;
+    for (auto const &[name, animation]: model.animations) {
+        std::cout << "  " << name << ":" << std::endl;
+        float const error = measure_pose(model.bones, animation, frames);
+        std::cout << "    max difference to the ancestor walk " << error << std::endl;
+    }
+
+    std::vector<gltf_model::bone> skeleton;
+    gltf_model::animation animation;
+    for (std::size_t bones = 16; bones <= 4096; bones *= 4) {
+        make_skeleton(bones, skeleton, animation);
+        std::cout << "  synthetic, " << bones << " bones:" << std::endl;
+        float const error = measure_pose(skeleton, animation, frames);
+        std::cout << "    max difference to the ancestor walk " << error << std::endl;
+    }
+
+    measure_blend_tree(model, frames);
+
+    std::cout << "baked animations:" << std::endl;
+    for (auto const &[name, animation]: model.animations)
+        measure_baking(name, animation, frames);
+
+    std::cout << "compressed animations:" << std::endl;
+    for (auto const &[name, animation]: model.animations)
+        measure_compression(name, animation, frames);
+}
+catch (std::exception const &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,263 @@
+#include "baked_animation.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+
+#include <glm/gtc/packing.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BAKED_ANIMATION_SSE2
+#endif
+
+static constexpr std::uint16_t half_one = 0x3c00;
+
+static std::int16_t quantize(float value)
+{
+    return static_cast<std::int16_t>(std::round(std::clamp(value, -1.f, 1.f) * 32767.f));
+}
+
+#ifdef BAKED_ANIMATION_SSE2
+// Four half floats: exponent and mantissa shifted into place and rebiased, denormals converted through a
+// float subtraction, no denormal float ever comes up (those take a slow path in the multiplier).
+// glm::unpackHalf gets there with branches, too slow to beat the splines.
+static __m128 half_to_float(std::uint16_t const * half)
+{
+    __m128i const h = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<__m128i const *>(half)), _mm_setzero_si128());
+    __m128i const magnitude = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+    __m128i const sign = _mm_slli_epi32(_mm_xor_si128(h, magnitude), 16);
+    __m128i const shifted = _mm_slli_epi32(magnitude, 13);
+
+    __m128i const bias = _mm_set1_epi32((127 - 15) << 23);
+    __m128i const infinity = _mm_andnot_si128(_mm_cmpgt_epi32(_mm_set1_epi32(0x7c00), magnitude), bias);
+    __m128 const normal = _mm_castsi128_ps(_mm_add_epi32(_mm_add_epi32(shifted, bias), infinity));
+
+    __m128i const magic = _mm_set1_epi32(113 << 23);
+    __m128 const denormal = _mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(shifted, magic)), _mm_castsi128_ps(magic));
+    __m128 const is_denormal = _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_set1_epi32(0x0400), magnitude));
+
+    __m128 const result = _mm_or_ps(_mm_and_ps(is_denormal, denormal), _mm_andnot_ps(is_denormal, normal));
+    return _mm_or_ps(result, _mm_castsi128_ps(sign));
+}
+
+// four normalized 16-bit integers
+static __m128 snorm_to_float(std::int16_t const * value)
+{
+    __m128i const v = _mm_loadl_epi64(reinterpret_cast<__m128i const *>(value));
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)), _mm_set1_ps(1.f / 32767.f));
+}
+
+static __m128 lerp(__m128 a, __m128 b, __m128 t)
+{
+    return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+#else
+// exponent and mantissa shifted into place and rebiased, denormals converted through a float subtraction
+static float half_to_float(std::uint16_t half)
+{
+    std::uint32_t bits = std::uint32_t(half & 0x7fff) << 13;
+    std::uint32_t const exponent = bits & 0x0f800000;
+    bits += (127 - 15) << 23;
+    if (exponent == 0x0f800000)
+        bits += (128 - 16) << 23;  // infinity or NaN
+    else if (exponent == 0)
+        bits = std::bit_cast<std::uint32_t>(std::bit_cast<float>(bits + (1 << 23)) - std::bit_cast<float>(113u << 23));
+    return std::bit_cast<float>(bits | std::uint32_t(half & 0x8000) << 16);
+}
+#endif
+
+void baked_animation::sample(float time, skeleton_pose & pose) const
+{
+    assert(pose.size() == bones && pose.stride == stride);
+
+    if (frames == 0)
+        return;
+
+    std::uint32_t frame = 0;
+    float t = 0.f;
+    if (frames > 1 && frame_time > 0.f)
+    {
+        float const position = std::clamp(time, 0.f, duration) / frame_time;
+        frame = std::min(static_cast<std::uint32_t>(position), frames - 2);
+        t = position - frame;
+    }
+    std::uint32_t const next = std::min(frame + 1, frames - 1);
+
+    std::int16_t const * r0 = rotations.data() + std::size_t(frame) * 4 * stride;
+    std::int16_t const * r1 = rotations.data() + std::size_t(next) * 4 * stride;
+    std::uint16_t const * t0 = translations.data() + std::size_t(frame) * 3 * stride;
+    std::uint16_t const * t1 = translations.data() + std::size_t(next) * 3 * stride;
+    std::uint16_t const * s0 = scales.data() + std::size_t(frame) * 3 * stride;
+    std::uint16_t const * s1 = scales.data() + std::size_t(next) * 3 * stride;
+
+    // baking keeps neighbouring frames in the same hemisphere, no need to check here
+#ifdef BAKED_ANIMATION_SSE2
+    __m128 const weight = _mm_set1_ps(t);
+    __m128 const half = _mm_set1_ps(0.5f);
+    __m128 const three = _mm_set1_ps(3.f);
+    for (std::uint32_t i = 0; i < bones; i += 4)
+    {
+        float translation[3][4], scale[3][4];
+
+        __m128 r[4];
+        __m128 length = _mm_setzero_ps();
+        for (std::uint32_t c = 0; c < 4; ++c)
+        {
+            r[c] = lerp(snorm_to_float(r0 + c * stride + i), snorm_to_float(r1 + c * stride + i), weight);
+            length = _mm_add_ps(length, _mm_mul_ps(r[c], r[c]));
+        }
+        __m128 const estimate = _mm_rsqrt_ps(length);
+        __m128 const inverse_length = _mm_mul_ps(_mm_mul_ps(half, estimate),
+            _mm_sub_ps(three, _mm_mul_ps(_mm_mul_ps(length, estimate), estimate)));
+        // the pose stores rotations by component like the frames, padding included
+        for (std::uint32_t c = 0; c < 4; ++c)
+            _mm_storeu_ps(pose.rotations.data() + c * stride + i, _mm_mul_ps(r[c], inverse_length));
+
+        for (std::uint32_t c = 0; c < 3; ++c)
+        {
+            _mm_storeu_ps(translation[c], lerp(half_to_float(t0 + c * stride + i), half_to_float(t1 + c * stride + i), weight));
+            _mm_storeu_ps(scale[c], lerp(half_to_float(s0 + c * stride + i), half_to_float(s1 + c * stride + i), weight));
+        }
+
+        for (std::uint32_t k = 0; k < 4 && i + k < bones; ++k)
+        {
+            pose.translations[i + k] = glm::vec3(translation[0][k], translation[1][k], translation[2][k]);
+            pose.scales[i + k] = glm::vec3(scale[0][k], scale[1][k], scale[2][k]);
+        }
+    }
+#else
+    for (std::uint32_t i = 0; i < bones; ++i)
+    {
+        glm::vec4 a(0.f), b(0.f);
+        for (std::uint32_t c = 0; c < 4; ++c)
+        {
+            a[c] = r0[c * stride + i] * (1.f / 32767.f);
+            b[c] = r1[c * stride + i] * (1.f / 32767.f);
+        }
+        glm::vec4 const r = glm::normalize(glm::mix(a, b, t));
+        pose.set_rotation(i, glm::quat(r.w, r.x, r.y, r.z));
+
+        for (std::uint32_t c = 0; c < 3; ++c)
+        {
+            pose.translations[i][c] = glm::mix(half_to_float(t0[c * stride + i]), half_to_float(t1[c * stride + i]), t);
+            pose.scales[i][c] = glm::mix(half_to_float(s0[c * stride + i]), half_to_float(s1[c * stride + i]), t);
+        }
+    }
+#endif
+}
+
+std::size_t baked_animation::memory_size() const
+{
+    return rotations.size() * sizeof(rotations[0]) + translations.size() * sizeof(translations[0])
+        + scales.size() * sizeof(scales[0]);
+}
+
+float key_rate(gltf_model::animation const & animation)
+{
+    std::vector<float> times;
+    for (auto const & bone : animation.bones)
+        for (auto const * timestamps : {&bone.translation.timestamps, &bone.rotation.timestamps, &bone.scale.timestamps})
+            times.insert(times.end(), timestamps->begin(), timestamps->end());
+    std::sort(times.begin(), times.end());
+
+    // keys closer than a millisecond are taken for the same one written twice
+    float gap = 0.f;
+    for (std::size_t i = 1; i < times.size(); ++i)
+        if (float const step = times[i] - times[i - 1]; step > 1e-3f && (gap == 0.f || step < gap))
+            gap = step;
+    return gap > 0.f ? 1.f / gap : 30.f;
+}
+
+baked_animation bake_animation(gltf_model::animation const & animation, float rate)
+{
+    baked_animation result;
+    result.bones = animation.bones.size();
+    result.stride = (result.bones + 3) & ~3u;
+    result.duration = std::max(animation.max_time, 0.f);
+    if (result.duration == 0.f)
+        // a single pose, e.g. a clip of one key per channel
+        result.frames = 1;
+    else if (rate > 0.f)
+        result.frames = std::max<std::uint32_t>(1, std::ceil(result.duration * rate)) + 1;
+    else
+        // rounded rather than up: keys on a regular grid from 0 to the end land on frames exactly
+        result.frames = std::max<std::uint32_t>(1, std::lround(result.duration * key_rate(animation))) + 1;
+    result.frame_time = result.frames > 1 ? result.duration / (result.frames - 1) : 0.f;
+
+    std::size_t const row = result.stride;
+    result.rotations.assign(row * 4 * result.frames, 0);
+    result.translations.assign(row * 3 * result.frames, 0);
+    result.scales.assign(row * 3 * result.frames, half_one);
+
+    skeleton_pose pose(result.bones);
+    std::vector<std::size_t> cursors;
+    std::vector<glm::quat> previous(result.bones);
+    for (std::uint32_t frame = 0; frame < result.frames; ++frame)
+    {
+        float const time = std::min(frame * result.frame_time, result.duration);
+        sample_pose(animation, time, cursors, pose);
+
+        std::int16_t * rotations = result.rotations.data() + frame * 4 * row;
+        std::uint16_t * translations = result.translations.data() + frame * 3 * row;
+        std::uint16_t * scales = result.scales.data() + frame * 3 * row;
+        for (std::uint32_t i = result.bones; i < result.stride; ++i)
+            rotations[3 * row + i] = 32767;
+
+        for (std::uint32_t i = 0; i < result.bones; ++i)
+        {
+            glm::quat rotation = glm::normalize(pose.rotation(i));
+            if (frame > 0 && glm::dot(previous[i], rotation) < 0.f)
+                rotation = -rotation;
+            previous[i] = rotation;
+
+            rotations[0 * row + i] = quantize(rotation.x);
+            rotations[1 * row + i] = quantize(rotation.y);
+            rotations[2 * row + i] = quantize(rotation.z);
+            rotations[3 * row + i] = quantize(rotation.w);
+            for (std::uint32_t c = 0; c < 3; ++c)
+            {
+                translations[c * row + i] = glm::packHalf1x16(pose.translations[i][c]);
+                scales[c * row + i] = glm::packHalf1x16(pose.scales[i][c]);
+            }
+        }
+    }
+
+    return result;
+}
+
+pose_error measure_error(baked_animation const & baked, gltf_model::animation const & animation)
+{
+    std::vector<float> times;
+    for (auto const & bone : animation.bones)
+        for (auto const * timestamps : {&bone.translation.timestamps, &bone.rotation.timestamps, &bone.scale.timestamps})
+            times.insert(times.end(), timestamps->begin(), timestamps->end());
+    for (std::uint32_t frame = 0; frame + 1 < baked.frames; ++frame)
+        times.push_back((frame + 0.5f) * baked.frame_time);
+    std::sort(times.begin(), times.end());
+    times.erase(std::unique(times.begin(), times.end()), times.end());
+
+    pose_error result;
+    skeleton_pose expected(baked.bones), actual(baked.bones);
+    std::vector<std::size_t> cursors;
+    for (float time : times)
+    {
+        sample_pose(animation, time, cursors, expected);
+        baked.sample(time, actual);
+        result.add(expected, actual);
+    }
+    return result;
+}
+
+std::size_t memory_size(gltf_model::animation const & animation)
+{
+    std::size_t result = 0;
+    for (auto const & bone : animation.bones)
+    {
+        result += (bone.translation.timestamps.size() + bone.rotation.timestamps.size() + bone.scale.timestamps.size()) * sizeof(float);
+        result += bone.translation.values.size() * sizeof(glm::vec3) + bone.rotation.values.size() * sizeof(glm::quat)
+            + bone.scale.values.size() * sizeof(glm::vec3);
+    }
+    return result;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "gltf_loader.hpp"
+#include "skeleton_pose.hpp"
+
+// An animation resampled at a fixed rate: sampling it is an indexed lookup of two frames and a lerp instead
+// of a key search per channel. Each channel is a table of frames, each frame a row per component of all the
+// bones, so four bones are decoded at a time with SSE where available. Rotations are 16-bit normalized
+// integers and translations and scales half floats, 20 bytes per bone per frame.
+struct baked_animation
+{
+    std::uint32_t bones = 0;
+    std::uint32_t stride = 0;   // bones rounded up to a multiple of 4, the padding is the identity
+    std::uint32_t frames = 0;
+    float duration = 0.f;
+    float frame_time = 0.f;     // duration / (frames - 1), the first and last frames are at 0 and duration;
+                                // 0 for a clip of no duration, baked to a single frame
+
+    // [(frame * components + component) * stride + bone], x, y, z (and w) components
+    std::vector<std::int16_t> rotations;    // consecutive frames in the same hemisphere
+    std::vector<std::uint16_t> translations;
+    std::vector<std::uint16_t> scales;
+
+    // time is clamped to [0, duration]
+    void sample(float time, skeleton_pose & pose) const;
+
+    // of the tables
+    std::size_t memory_size() const;
+};
+
+// The rate `animation` was keyed at: one over the shortest time between two of its keys
+float key_rate(gltf_model::animation const & animation);
+
+// Resamples `animation` at about `rate` frames per second, exactly hitting its end. By default at its
+// key_rate, so that keys on a regular grid are frames and no corner between two keys is cut; a rate that is
+// not a multiple of the key rate misses keys and can be far off around sharp turns.
+baked_animation bake_animation(gltf_model::animation const & animation, float rate = 0.f);
+
+// Compares the two at every key of `animation` and halfway between the baked frames
+pose_error measure_error(baked_animation const & baked, gltf_model::animation const & animation);
+
+// What baking at the key rate stays well within, the quantization of the frames being most of it; past this
+// the bake has missed keys
+inline constexpr pose_error bake_tolerance{1e-3f, 1e-2f, 1e-3f};
+
+// of the keys and timestamps of `animation`, to compare with baked_animation::memory_size
+std::size_t memory_size(gltf_model::animation const & animation);
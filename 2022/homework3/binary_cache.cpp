@@ -0,0 +1,110 @@
+#include "binary_cache.hpp"
+#include "mapped_file.hpp"
+
+#include <fstream>
+
+namespace binary_cache {
+    namespace {
+        std::uint64_t mix(std::uint64_t h) {
+            h ^= h >> 33;
+            h *= 0xFF51AFD7ED558CCDull;
+            h ^= h >> 33;
+            h *= 0xC4CEB9FE1A85EC53ull;
+            h ^= h >> 33;
+            return h;
+        }
+    }
+
+    std::uint64_t hash_bytes(void const *data, std::size_t size) {
+        auto bytes = static_cast<unsigned char const *>(data);
+
+        // four independent lanes keep the multiplier latency out of the critical path
+        std::uint64_t lanes[4] = {0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, size};
+        std::size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+            for (int l = 0; l < 4; ++l) {
+                std::uint64_t word;
+                std::memcpy(&word, bytes + i + 8 * l, 8);
+                lanes[l] = (lanes[l] ^ word) * 0x9FB21C651E98DF25ull;
+                lanes[l] ^= lanes[l] >> 29;
+            }
+
+        std::uint64_t h = mix(lanes[0]) ^ mix(lanes[1] + 1) ^ mix(lanes[2] + 2) ^ mix(lanes[3] + 3);
+        for (; i < size; ++i)
+            h = (h ^ bytes[i]) * 0x100000001B3ull;
+        return mix(h);
+    }
+
+    source_key make_key(std::filesystem::path const &path) {
+        mapped_file file(path);
+
+        source_key key;
+        key.size = file.size();
+        key.mtime = std::filesystem::last_write_time(path).time_since_epoch().count();
+        key.hash = hash_bytes(file.data(), file.size());
+        return key;
+    }
+
+    std::filesystem::path cache_path(std::filesystem::path const &source) {
+        auto result = source;
+        result += ".cache";
+        return result;
+    }
+
+    writer::writer(std::array<char, 8> const &magic, std::uint32_t version) {
+        write(magic);
+        write(version);
+    }
+
+    void writer::write_string(std::string_view value) {
+        write<std::uint64_t>(value.size());
+        data_.insert(data_.end(), value.begin(), value.end());
+    }
+
+    void writer::align() {
+        data_.resize((data_.size() + alignment - 1) / alignment * alignment, '\0');
+    }
+
+    void writer::save(std::filesystem::path const &path) const {
+        auto temporary = path;
+        temporary += ".tmp";
+        {
+            std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+            output.write(data_.data(), data_.size());
+            if (!output)
+                throw std::runtime_error("Cannot write cache file " + temporary.string());
+        }
+        std::filesystem::rename(temporary, path);
+    }
+
+    reader::reader(std::string_view data, std::array<char, 8> const &magic, std::uint32_t version)
+            : begin_(data.data()), cur_(data.data()), end_(data.data() + data.size()) {
+        if (read<std::array<char, 8>>() != magic)
+            throw std::runtime_error("Not a cache file");
+        if (read<std::uint32_t>() != version)
+            throw std::runtime_error("Cache version mismatch");
+    }
+
+    void reader::expect_key(source_key const &key) {
+        if (read<source_key>() != key)
+            throw std::runtime_error("Cache is out of date");
+    }
+
+    std::string_view reader::read_string() {
+        auto size = read<std::uint64_t>();
+        return {take(size), size};
+    }
+
+    char const *reader::take(std::size_t size) {
+        if (size > static_cast<std::size_t>(end_ - cur_))
+            throw std::runtime_error("Truncated cache file");
+        auto result = cur_;
+        cur_ += size;
+        return result;
+    }
+
+    void reader::align() {
+        auto offset = static_cast<std::size_t>(cur_ - begin_);
+        take((offset + alignment - 1) / alignment * alignment - offset);
+    }
+}
@@ -0,0 +1,250 @@
+#include "blend_tree.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BLEND_TREE_SSE2
+#endif
+
+static glm::quat nlerp(glm::quat const & a, glm::quat b, float weight)
+{
+    if (glm::dot(a, b) < 0.f)
+        b = -b;
+    return glm::normalize(a + (b - a) * weight);
+}
+
+void nlerp(skeleton_pose const & a, skeleton_pose const & b, float weight, float const * mask, skeleton_pose & result)
+{
+    assert(a.size() == result.size() && b.size() == result.size());
+
+    std::size_t const bones = result.size();
+    std::size_t const stride = result.stride;
+    std::size_t i = 0;
+#ifdef BLEND_TREE_SSE2
+    // each register holds one component of four bones, straight from the pose
+    float const * pa = a.rotations.data();
+    float const * pb = b.rotations.data();
+    float * pr = result.rotations.data();
+    __m128 const sign = _mm_set1_ps(-0.f);
+    __m128 const half = _mm_set1_ps(0.5f);
+    __m128 const three = _mm_set1_ps(3.f);
+
+    // the padding blends identities into the identity, but a mask has none: its last partial block is
+    // left to the scalar loop
+    std::size_t const end = mask ? bones & ~std::size_t(3) : stride;
+    for (; i < end; i += 4)
+    {
+        __m128 qa[4], qb[4], r[4];
+        for (std::size_t c = 0; c < 4; ++c)
+        {
+            qa[c] = _mm_loadu_ps(pa + c * stride + i);
+            qb[c] = _mm_loadu_ps(pb + c * stride + i);
+        }
+
+        __m128 const w = mask ? _mm_mul_ps(_mm_loadu_ps(mask + i), _mm_set1_ps(weight)) : _mm_set1_ps(weight);
+
+        __m128 dot = _mm_setzero_ps();
+        for (std::size_t c = 0; c < 4; ++c)
+            dot = _mm_add_ps(dot, _mm_mul_ps(qa[c], qb[c]));
+        __m128 const flip = _mm_and_ps(dot, sign);
+
+        __m128 length = _mm_setzero_ps();
+        for (std::size_t c = 0; c < 4; ++c)
+        {
+            r[c] = _mm_add_ps(qa[c], _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(qb[c], flip), qa[c]), w));
+            length = _mm_add_ps(length, _mm_mul_ps(r[c], r[c]));
+        }
+        // rsqrt refined by a Newton step, good to about 1e-7 where sqrt and a division would take longer
+        __m128 const estimate = _mm_rsqrt_ps(length);
+        __m128 const scale = _mm_mul_ps(_mm_mul_ps(half, estimate),
+            _mm_sub_ps(three, _mm_mul_ps(_mm_mul_ps(length, estimate), estimate)));
+        for (std::size_t c = 0; c < 4; ++c)
+            _mm_storeu_ps(pr + c * stride + i, _mm_mul_ps(r[c], scale));
+    }
+#endif
+    for (; i < bones; ++i)
+        result.set_rotation(i, nlerp(a.rotation(i), b.rotation(i), mask ? weight * mask[i] : weight));
+}
+
+void blend(skeleton_pose const & a, skeleton_pose const & b, float weight, float const * mask, skeleton_pose & result)
+{
+    for (std::size_t i = 0; i < result.size(); ++i)
+    {
+        float const w = mask ? weight * mask[i] : weight;
+        result.translations[i] = a.translations[i] + (b.translations[i] - a.translations[i]) * w;
+        result.scales[i] = a.scales[i] + (b.scales[i] - a.scales[i]) * w;
+    }
+    nlerp(a, b, weight, mask, result);
+}
+
+// base * (pose relative to reference)^weight, the rotation difference taken in the bone's local frame
+static void apply_additive(skeleton_pose const & base, skeleton_pose const & pose, skeleton_pose const & reference, float weight,
+    skeleton_pose & result)
+{
+    glm::quat const identity(1.f, 0.f, 0.f, 0.f);
+    for (std::size_t i = 0; i < result.size(); ++i)
+    {
+        glm::quat const difference = glm::conjugate(reference.rotation(i)) * pose.rotation(i);
+        result.translations[i] = base.translations[i] + (pose.translations[i] - reference.translations[i]) * weight;
+        result.set_rotation(i, glm::normalize(base.rotation(i) * nlerp(identity, difference, weight)));
+        result.scales[i] = base.scales[i] * (glm::vec3(1.f) + (pose.scales[i] / reference.scales[i] - glm::vec3(1.f)) * weight);
+    }
+}
+
+blend_tree::blend_tree(std::size_t bones)
+    : bones_(bones)
+{}
+
+blend_tree::node_id blend_tree::add_clip(gltf_model::animation const & animation)
+{
+    assert(animation.bones.size() == bones_);
+
+    node value;
+    value.type = node_type::clip;
+    value.animation = &animation;
+    return add(std::move(value));
+}
+
+blend_tree::node_id blend_tree::add_lerp(node_id a, node_id b, float weight)
+{
+    node value;
+    value.type = node_type::lerp;
+    value.inputs[0] = a;
+    value.inputs[1] = b;
+    value.weight = weight;
+    return add(std::move(value));
+}
+
+blend_tree::node_id blend_tree::add_additive(node_id base, node_id pose, node_id reference, float weight)
+{
+    node value;
+    value.type = node_type::additive;
+    value.inputs[0] = base;
+    value.inputs[1] = pose;
+    value.inputs[2] = reference;
+    value.weight = weight;
+    return add(std::move(value));
+}
+
+blend_tree::node_id blend_tree::add_layer(node_id base, node_id layer, std::vector<float> mask, float weight)
+{
+    assert(mask.size() == bones_);
+
+    node value;
+    value.type = node_type::layer;
+    value.inputs[0] = base;
+    value.inputs[1] = layer;
+    value.weight = weight;
+    value.mask = std::move(mask);
+    return add(std::move(value));
+}
+
+void blend_tree::set_time(node_id clip, float time)
+{
+    assert(nodes_[clip].type == node_type::clip);
+
+    nodes_[clip].time = time;
+}
+
+void blend_tree::set_weight(node_id node, float weight)
+{
+    assert(nodes_[node].type != node_type::clip);
+
+    nodes_[node].weight = weight;
+}
+
+blend_tree::node_id blend_tree::add(node value)
+{
+    node_id const id = nodes_.size();
+    for (node_id input : value.inputs)
+        assert(input == no_input || input < id);
+
+    nodes_.push_back(std::move(value));
+    poses_.emplace_back(bones_);
+    results_.push_back(nullptr);
+    used_.push_back(0);
+    return id;
+}
+
+skeleton_pose const & blend_tree::evaluate()
+{
+    assert(!nodes_.empty());
+
+    // what the root needs, walking back from it
+    std::fill(used_.begin(), used_.end(), 0);
+    used_.back() = 1;
+    for (std::size_t id = nodes_.size(); id-- > 0;)
+    {
+        if (!used_[id])
+            continue;
+
+        auto const & value = nodes_[id];
+        switch (value.type)
+        {
+        case node_type::clip:
+            break;
+        case node_type::lerp:
+            used_[value.inputs[0]] |= value.weight < 1.f;
+            used_[value.inputs[1]] |= value.weight > 0.f;
+            break;
+        case node_type::additive:
+            used_[value.inputs[0]] = 1;
+            used_[value.inputs[1]] |= value.weight != 0.f;
+            used_[value.inputs[2]] |= value.weight != 0.f;
+            break;
+        case node_type::layer:
+            used_[value.inputs[0]] = 1;
+            used_[value.inputs[1]] |= value.weight != 0.f;
+            break;
+        }
+    }
+
+    for (node_id id = 0; id < nodes_.size(); ++id)
+        if (used_[id])
+            evaluate(id);
+
+    return *results_.back();
+}
+
+void blend_tree::evaluate(node_id id)
+{
+    auto & value = nodes_[id];
+    auto & pose = poses_[id];
+    results_[id] = &pose;
+
+    switch (value.type)
+    {
+    case node_type::clip:
+    {
+        float const duration = value.animation->max_time;
+        float time = duration > 0.f ? std::fmod(value.time, duration) : 0.f;
+        if (time < 0.f)
+            time += duration;
+        sample_pose(*value.animation, time, value.cursors, pose);
+        break;
+    }
+    case node_type::lerp:
+        if (value.weight <= 0.f)
+            results_[id] = results_[value.inputs[0]];
+        else if (value.weight >= 1.f)
+            results_[id] = results_[value.inputs[1]];
+        else
+            blend(*results_[value.inputs[0]], *results_[value.inputs[1]], value.weight, nullptr, pose);
+        break;
+    case node_type::additive:
+        if (value.weight == 0.f)
+            results_[id] = results_[value.inputs[0]];
+        else
+            apply_additive(*results_[value.inputs[0]], *results_[value.inputs[1]], *results_[value.inputs[2]], value.weight, pose);
+        break;
+    case node_type::layer:
+        if (value.weight == 0.f)
+            results_[id] = results_[value.inputs[0]];
+        else
+            blend(*results_[value.inputs[0]], *results_[value.inputs[1]], value.weight, value.mask.data(), pose);
+        break;
+    }
+}
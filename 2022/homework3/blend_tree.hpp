@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "gltf_loader.hpp"
+#include "skeleton_pose.hpp"
+
+// The rotations of `result` set to normalize(a + (±b - a) * w) bone by bone, b taken in the hemisphere of
+// a, where w is `weight` times mask[bone] if there is a mask. Four bones at a time with SSE where
+// available, loaded as they are from the by-component rotations of the poses.
+void nlerp(skeleton_pose const & a, skeleton_pose const & b, float weight, float const * mask, skeleton_pose & result);
+
+// `a` blended towards `b` by `weight`, times mask[bone] if there is a mask, rotations with nlerp
+void blend(skeleton_pose const & a, skeleton_pose const & b, float weight, float const * mask, skeleton_pose & result);
+
+// Blends any number of animations into one pose. Nodes only take earlier nodes as inputs, so the tree
+// (a DAG really, a node may feed several others) is evaluated in one pass over the nodes, each into its
+// own pose buffer that every node using it reads: a clip is sampled once however many blends it is in.
+// Nodes whose weight hides them from the root are skipped, and blends with a weight of 0 or 1 pass their
+// input through. Buffers are allocated as nodes are added, evaluating does not allocate.
+class blend_tree
+{
+public:
+    using node_id = std::uint32_t;
+
+    explicit blend_tree(std::size_t bones);
+
+    // `animation` sampled at the time given to set_time, looped
+    node_id add_clip(gltf_model::animation const & animation);
+    // `a` blended towards `b` by the weight
+    node_id add_lerp(node_id a, node_id b, float weight = 0.f);
+    // `base` with the difference of `pose` from `reference` applied on top, scaled by the weight
+    node_id add_additive(node_id base, node_id pose, node_id reference, float weight = 1.f);
+    // `layer` over `base` by the weight times mask[bone], e.g. a mask of 1 for the upper body bones only
+    node_id add_layer(node_id base, node_id layer, std::vector<float> mask, float weight = 1.f);
+
+    void set_time(node_id clip, float time);
+    void set_weight(node_id node, float weight);
+
+    std::size_t size() const { return nodes_.size(); }
+    std::size_t bones() const { return bones_; }
+
+    // evaluates the last node added and whatever it depends on
+    skeleton_pose const & evaluate();
+
+    // as of the last evaluate, only valid for nodes it used
+    skeleton_pose const & pose(node_id node) const { return *results_[node]; }
+
+private:
+    enum class node_type
+    {
+        clip,
+        lerp,
+        additive,
+        layer,
+    };
+
+    static constexpr node_id no_input = -1;
+
+    struct node
+    {
+        node_type type = node_type::clip;
+        node_id inputs[3] = {no_input, no_input, no_input};
+        float weight = 1.f;
+
+        gltf_model::animation const * animation = nullptr;
+        float time = 0.f;
+        std::vector<std::size_t> cursors;
+
+        std::vector<float> mask;
+    };
+
+    node_id add(node value);
+    void evaluate(node_id id);
+
+    std::size_t bones_;
+    std::vector<node> nodes_;
+    std::vector<skeleton_pose> poses_;
+    std::vector<skeleton_pose const *> results_;
+    std::vector<char> used_;
+};
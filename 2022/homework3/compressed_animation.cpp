@@ -0,0 +1,283 @@
+#include "compressed_animation.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <span>
+
+#include <glm/gtc/constants.hpp>
+
+using channel = compressed_animation::channel;
+using track = compressed_animation::track;
+
+static float difference(glm::vec3 const & a, glm::vec3 const & b)
+{
+    return glm::distance(a, b);
+}
+
+static float difference(glm::quat const & a, glm::quat const & b)
+{
+    return 2.f * std::acos(std::min(1.f, std::abs(glm::dot(glm::normalize(a), glm::normalize(b)))));
+}
+
+static glm::vec3 interpolate(glm::vec3 const & a, glm::vec3 const & b, float t)
+{
+    return glm::mix(a, b, t);
+}
+
+static glm::quat interpolate(glm::quat const & a, glm::quat b, float t)
+{
+    if (glm::dot(a, b) < 0.f)
+        b = -b;
+    glm::quat const result = a + (b - a) * t;
+    return result * (1.f / std::sqrt(glm::dot(result, result)));
+}
+
+// Indices of the keys to keep: each one is as far from the previous one as it can be with the keys skipped
+// still within `tolerance` of the interpolation between the two. The first and last keys are always kept.
+template <typename T>
+static std::vector<std::size_t> reduce_keys(gltf_model::spline<T> const & spline, float tolerance)
+{
+    auto const & times = spline.timestamps;
+    auto const & values = spline.values;
+
+    auto within = [&](std::size_t a, std::size_t b)
+    {
+        float const span = times[b] - times[a];
+        for (std::size_t k = a + 1; k < b; ++k)
+        {
+            float const t = span > 0.f ? (times[k] - times[a]) / span : 0.f;
+            if (difference(interpolate(values[a], values[b], t), values[k]) > tolerance)
+                return false;
+        }
+        return true;
+    };
+
+    std::vector<std::size_t> result{0};
+    for (std::size_t a = 0; a + 1 < values.size();)
+    {
+        std::size_t b = a + 1;
+        while (b + 1 < values.size() && within(a, b + 1))
+            ++b;
+        result.push_back(b);
+        a = b;
+    }
+    return result;
+}
+
+static std::uint16_t quantize_time(float time, float duration)
+{
+    return duration > 0.f ? static_cast<std::uint16_t>(std::round(std::clamp(time / duration, 0.f, 1.f) * 65535.f)) : 0;
+}
+
+static glm::u16vec3 encode(channel const & channel, glm::vec3 const & value)
+{
+    glm::vec3 const scaled = glm::clamp((value - channel.minimum) / glm::max(channel.step, glm::vec3(1e-30f)), 0.f, 65535.f);
+    return glm::u16vec3(glm::round(scaled));
+}
+
+static glm::vec3 decode(channel const & channel, glm::u16vec3 const & key)
+{
+    return channel.minimum + glm::vec3(key) * channel.step;
+}
+
+// Smallest three: the largest component is dropped and made positive by negating the quaternion, the
+// others are within ±1/sqrt(2) and take 15 bits each, the top bits of the first two say which was dropped
+static glm::u16vec3 encode(glm::quat const & rotation)
+{
+    glm::vec4 const q = glm::normalize(glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w));
+    int largest = 0;
+    for (int i = 1; i < 4; ++i)
+        if (std::abs(q[i]) > std::abs(q[largest]))
+            largest = i;
+    float const sign = q[largest] < 0.f ? -1.f : 1.f;
+
+    glm::u16vec3 result;
+    for (int i = 0, k = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+        float const value = std::clamp(q[i] * sign * glm::root_two<float>(), -1.f, 1.f);
+        result[k++] = static_cast<std::uint16_t>(std::round((value * 0.5f + 0.5f) * 32767.f));
+    }
+    result[0] |= (largest & 1) << 15;
+    result[1] |= (largest >> 1) << 15;
+    return result;
+}
+
+static glm::quat decode(glm::u16vec3 const & key)
+{
+    int const largest = (key[0] >> 15) | (key[1] >> 15) << 1;
+    float q[4];
+    for (int k = 0; k < 3; ++k)
+        q[k] = ((key[k] & 0x7fff) * (2.f / 32767.f) - 1.f) * glm::one_over_root_two<float>();
+    float const largest_value = std::sqrt(std::max(0.f, 1.f - q[0] * q[0] - q[1] * q[1] - q[2] * q[2]));
+    for (int i = 3; i > largest; --i)
+        q[i] = q[i - 1];
+    q[largest] = largest_value;
+    return glm::quat(q[3], q[0], q[1], q[2]);
+}
+
+static void compress_channel(gltf_model::spline<glm::vec3> const & spline, float tolerance, glm::vec3 const & identity,
+    float duration, track & result)
+{
+    channel result_channel;
+    result_channel.first = result.keys.size();
+
+    std::vector<std::size_t> kept;
+    if (!spline.values.empty())
+    {
+        glm::vec3 const & first = spline.values.front();
+        bool const constant = std::all_of(spline.values.begin(), spline.values.end(),
+            [&](glm::vec3 const & value) { return difference(value, first) <= tolerance; });
+        if (!constant)
+            kept = reduce_keys(spline, tolerance);
+        else if (difference(first, identity) > tolerance)
+            kept = {0};
+    }
+
+    if (!kept.empty())
+    {
+        glm::vec3 minimum = spline.values[kept[0]], maximum = minimum;
+        for (std::size_t k : kept)
+        {
+            minimum = glm::min(minimum, spline.values[k]);
+            maximum = glm::max(maximum, spline.values[k]);
+        }
+        result_channel.minimum = minimum;
+        result_channel.step = (maximum - minimum) / 65535.f;
+
+        for (std::size_t k : kept)
+        {
+            result.times.push_back(quantize_time(spline.timestamps[k], duration));
+            result.keys.push_back(encode(result_channel, spline.values[k]));
+        }
+    }
+
+    result_channel.count = kept.size();
+    result.channels.push_back(result_channel);
+}
+
+static void compress_channel(gltf_model::spline<glm::quat> const & spline, float tolerance, float duration, track & result)
+{
+    channel result_channel;
+    result_channel.first = result.keys.size();
+
+    std::vector<std::size_t> kept;
+    if (!spline.values.empty())
+    {
+        glm::quat const & first = spline.values.front();
+        bool const constant = std::all_of(spline.values.begin(), spline.values.end(),
+            [&](glm::quat const & value) { return difference(value, first) <= tolerance; });
+        if (!constant)
+            kept = reduce_keys(spline, tolerance);
+        else if (difference(first, glm::quat(1.f, 0.f, 0.f, 0.f)) > tolerance)
+            kept = {0};
+    }
+
+    for (std::size_t k : kept)
+    {
+        result.times.push_back(quantize_time(spline.timestamps[k], duration));
+        result.keys.push_back(encode(spline.values[k]));
+    }
+
+    result_channel.count = kept.size();
+    result.channels.push_back(result_channel);
+}
+
+// `time` is in the 0-65535 scale of the key times
+template <typename T, typename Decode>
+static T sample_channel(track const & source, channel const & channel, float time, std::size_t & cursor, T const & identity,
+    Decode const & decode)
+{
+    if (channel.count == 0)
+        return identity;
+
+    glm::u16vec3 const * keys = source.keys.data() + channel.first;
+    if (channel.count == 1)
+        return decode(keys[0]);
+
+    std::span<std::uint16_t const> const times(source.times.data() + channel.first, channel.count);
+    std::size_t const i = find_key(times, time, cursor);
+    if (i == 0)
+        return decode(keys[0]);
+    if (i == times.size())
+        return decode(keys[i - 1]);
+
+    float const t = (time - times[i - 1]) / (times[i] - times[i - 1]);
+    return interpolate(decode(keys[i - 1]), decode(keys[i]), t);
+}
+
+void compressed_animation::sample(float time, std::vector<std::size_t> & cursors, skeleton_pose & pose) const
+{
+    assert(pose.size() == bones());
+
+    cursors.resize(3 * bones(), 0);
+
+    float const scaled_time = duration > 0.f ? std::clamp(time / duration, 0.f, 1.f) * 65535.f : 0.f;
+    auto const decode_rotation = [](glm::u16vec3 const & key) { return decode(key); };
+
+    for (std::size_t i = 0; i < bones(); ++i)
+    {
+        std::size_t * cursor = cursors.data() + 3 * i;
+
+        auto const & translation = translations.channels[i];
+        pose.translations[i] = sample_channel(translations, translation, scaled_time, cursor[0], glm::vec3(0.f),
+            [&](glm::u16vec3 const & key) { return decode(translation, key); });
+
+        pose.set_rotation(i, sample_channel(rotations, rotations.channels[i], scaled_time, cursor[1],
+            glm::quat(1.f, 0.f, 0.f, 0.f), decode_rotation));
+
+        auto const & scale = scales.channels[i];
+        pose.scales[i] = sample_channel(scales, scale, scaled_time, cursor[2], glm::vec3(1.f),
+            [&](glm::u16vec3 const & key) { return decode(scale, key); });
+    }
+}
+
+std::size_t compressed_animation::memory_size() const
+{
+    std::size_t result = 0;
+    for (auto const * track : {&translations, &rotations, &scales})
+        result += track->channels.size() * sizeof(channel) + track->times.size() * sizeof(std::uint16_t)
+            + track->keys.size() * sizeof(glm::u16vec3);
+    return result;
+}
+
+compressed_animation compress_animation(gltf_model::animation const & animation, compression_options const & options)
+{
+    compressed_animation result;
+    result.duration = animation.max_time;
+
+    for (auto const & bone : animation.bones)
+    {
+        compress_channel(bone.translation, options.translation_tolerance, glm::vec3(0.f), result.duration, result.translations);
+        compress_channel(bone.rotation, options.rotation_tolerance, result.duration, result.rotations);
+        compress_channel(bone.scale, options.scale_tolerance, glm::vec3(1.f), result.duration, result.scales);
+    }
+
+    return result;
+}
+
+pose_error measure_error(compressed_animation const & compressed, gltf_model::animation const & animation)
+{
+    std::vector<float> times;
+    for (auto const & bone : animation.bones)
+        for (auto const * timestamps : {&bone.translation.timestamps, &bone.rotation.timestamps, &bone.scale.timestamps})
+            times.insert(times.end(), timestamps->begin(), timestamps->end());
+    std::sort(times.begin(), times.end());
+    times.erase(std::unique(times.begin(), times.end()), times.end());
+    for (std::size_t i = 0, size = times.size(); i + 1 < size; ++i)
+        times.push_back((times[i] + times[i + 1]) * 0.5f);
+    std::sort(times.begin(), times.end());
+
+    pose_error result;
+    skeleton_pose expected(compressed.bones()), actual(compressed.bones());
+    std::vector<std::size_t> expected_cursors, actual_cursors;
+    for (float time : times)
+    {
+        sample_pose(animation, time, expected_cursors, expected);
+        compressed.sample(time, actual_cursors, actual);
+        result.add(expected, actual);
+    }
+    return result;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/gtc/type_precision.hpp>
+
+#include "gltf_loader.hpp"
+#include "skeleton_pose.hpp"
+
+struct compression_options
+{
+    float translation_tolerance = 1e-4f;    // distance
+    float rotation_tolerance = 1e-3f;       // radians
+    float scale_tolerance = 1e-4f;
+};
+
+// An animation with only the keys needed to stay within the tolerances of the source. Channels that stay
+// put collapse to a single key, or to none when that key is the identity. Keys are 3 16-bit integers:
+// translations and scales quantized within the range of their channel, rotations as their smallest three
+// components (the largest one follows from them, its index taken from the top bits). Key times are 16-bit
+// fractions of the duration.
+struct compressed_animation
+{
+    struct channel
+    {
+        std::uint32_t first = 0;    // in times and keys
+        std::uint32_t count = 0;
+        glm::vec3 minimum{0.f};     // translations and scales are minimum + key * step
+        glm::vec3 step{0.f};
+    };
+
+    struct track
+    {
+        std::vector<channel> channels;  // per bone
+        std::vector<std::uint16_t> times;
+        std::vector<glm::u16vec3> keys;
+    };
+
+    float duration = 0.f;
+    track translations;
+    track rotations;
+    track scales;
+
+    std::size_t bones() const { return rotations.channels.size(); }
+
+    // Like sample_pose: `cursors` keeps the keys found, 3 per bone, for the next call and is sized on first
+    // use. Rotations are interpolated with nlerp.
+    void sample(float time, std::vector<std::size_t> & cursors, skeleton_pose & pose) const;
+
+    std::size_t memory_size() const;
+};
+
+compressed_animation compress_animation(gltf_model::animation const & animation, compression_options const & options = {});
+
+// Compares the two at every key of `animation` and halfway between them
+pose_error measure_error(compressed_animation const & compressed, gltf_model::animation const & animation);
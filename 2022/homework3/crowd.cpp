@@ -0,0 +1,94 @@
+#include "crowd.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#include "blend_tree.hpp"
+
+// enough work to be worth a trip through the scheduler, few enough instances to balance the threads
+static constexpr std::size_t instances_per_block = 16;
+
+static float loop(float time, float duration)
+{
+    if (duration <= 0.f)
+        return 0.f;
+    time = std::fmod(time, duration);
+    return time < 0.f ? time + duration : time;
+}
+
+crowd::crowd(gltf_model const & model, float rate)
+    : bones_(model.bones)
+{
+    for (auto const & [name, animation] : model.animations)
+        clip_names_.push_back(name);
+    std::sort(clip_names_.begin(), clip_names_.end());
+
+    for (auto const & name : clip_names_)
+    {
+        auto const & animation = model.animations.at(name);
+        clips_.push_back(bake_animation(animation, rate));
+        assert(clips_.back().bones == bones());
+
+        if (auto const error = measure_error(clips_.back(), animation); !error.within(bake_tolerance))
+            std::cerr << "Animation " << name << " baked to " << clips_.back().frames << " frames is off by up to " << error.translation
+                << " in translation, " << error.rotation << " radians in rotation and " << error.scale
+                << " in scale, bake it at its key rate" << std::endl;
+    }
+}
+
+std::uint32_t crowd::clip(std::string const & name) const
+{
+    auto it = std::lower_bound(clip_names_.begin(), clip_names_.end(), name);
+    if (it == clip_names_.end() || *it != name)
+        throw std::runtime_error("No animation " + name);
+    return it - clip_names_.begin();
+}
+
+void crowd::update(job_scheduler & scheduler)
+{
+    palettes_.resize(instances.size() * bones());
+
+    // allocated once, updating does not allocate
+    while (scratch_.size() < scheduler.threads())
+        scratch_.push_back({skeleton_pose(bones()), skeleton_pose(bones()), skeleton_pose(bones()), pose_evaluator(bones_)});
+
+    std::span<glm::mat4x3> const palettes(palettes_);
+    scheduler.parallel_for(instances.size(), instances_per_block, [&](std::size_t begin, std::size_t end, unsigned int thread)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+            update(instances[i], scratch_[thread], palettes.subspan(i * bones(), bones()));
+    });
+}
+
+void crowd::update(crowd_instance const & instance, scratch & scratch, std::span<glm::mat4x3> palette) const
+{
+    assert(instance.from < clips() && instance.to < clips());
+
+    auto const & from = clips_[instance.from];
+    auto const & to = clips_[instance.to];
+
+    // like blend_tree, a clip blended out is not sampled
+    skeleton_pose const * pose;
+    if (instance.weight <= 0.f)
+    {
+        from.sample(loop(instance.time, from.duration), scratch.from);
+        pose = &scratch.from;
+    }
+    else if (instance.weight >= 1.f)
+    {
+        to.sample(loop(instance.time, to.duration), scratch.to);
+        pose = &scratch.to;
+    }
+    else
+    {
+        from.sample(loop(instance.time, from.duration), scratch.from);
+        to.sample(loop(instance.time, to.duration), scratch.to);
+        blend(scratch.from, scratch.to, instance.weight, nullptr, scratch.blended);
+        pose = &scratch.blended;
+    }
+
+    scratch.evaluator.evaluate(*pose, palette, instance.transform);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <glm/mat4x3.hpp>
+
+#include "gltf_loader.hpp"
+#include "skeleton_pose.hpp"
+#include "baked_animation.hpp"
+#include "job_scheduler.hpp"
+
+// What one member of a crowd plays: two of its clips, both at `time` (looped) and blended by `weight`, and
+// where it stands
+struct crowd_instance
+{
+    std::uint32_t from = 0;
+    std::uint32_t to = 0;
+    float time = 0.f;
+    float weight = 0.f;             // 0 is `from` alone, 1 is `to` alone
+    glm::mat4x3 transform{1.f};     // applied to the root bones, so to the whole palette
+};
+
+// Many instances of one skinned model, posed in parallel. The clips are baked, so an instance has no
+// sampling state of its own (no cursors) and costs the same wherever its time jumps. Instances are split in
+// blocks over the threads of a job_scheduler, each thread with its own scratch poses and pose_evaluator,
+// and every palette goes to one buffer, instance after instance, to be uploaded at once for instanced draws.
+class crowd
+{
+public:
+    // bakes every animation of `model` at `rate`, by default at its key rate, see bake_animation; warns on
+    // std::cerr of clips that come out beyond bake_tolerance
+    explicit crowd(gltf_model const & model, float rate = 0.f);
+
+    std::vector<crowd_instance> instances;
+
+    std::size_t bones() const { return bones_.size(); }
+    std::size_t clips() const { return clips_.size(); }
+
+    // the clip baked from the animation named `name`, throws if the model has none
+    std::uint32_t clip(std::string const & name) const;
+    baked_animation const & clip(std::uint32_t index) const { return clips_[index]; }
+
+    // evaluates the palettes of all the instances
+    void update(job_scheduler & scheduler);
+
+    // as of the last update, the palette of instance i at [i * bones(), (i + 1) * bones())
+    std::span<glm::mat4x3 const> palettes() const { return palettes_; }
+    std::span<glm::mat4x3 const> palette(std::size_t instance) const
+    {
+        return std::span<glm::mat4x3 const>(palettes_).subspan(instance * bones(), bones());
+    }
+
+private:
+    struct scratch
+    {
+        skeleton_pose from;
+        skeleton_pose to;
+        skeleton_pose blended;
+        pose_evaluator evaluator;
+    };
+
+    void update(crowd_instance const & instance, scratch & scratch, std::span<glm::mat4x3> palette) const;
+
+    std::vector<gltf_model::bone> bones_;
+    std::vector<std::string> clip_names_;
+    std::vector<baked_animation> clips_;
+    std::vector<scratch> scratch_;      // per thread of the scheduler
+    std::vector<glm::mat4x3> palettes_;
+};
@@ -0,0 +1,136 @@
+// Crowd animation benchmark.
+//
+// Usage: crowd_benchmark [max threads] [model.gltf | model.glb]
+// Poses herds of 1 to 10000 instances of the model (the wolf by default), each blending its walk and run
+// cycles (the first two animations otherwise) at its own time and weight, and prints the time of a crowd
+// update with 1, 2, 4... threads up to `max threads` (the hardware threads by default), per frame and per
+// instance, checking that every thread count writes the same palettes. For reference, the same herd is
+// posed one instance at a time with a blend_tree sampling the splines, the way main poses its one wolf.
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "gltf_loader.hpp"
+#include "skeleton_pose.hpp"
+#include "blend_tree.hpp"
+#include "crowd.hpp"
+#include "job_scheduler.hpp"
+
+namespace {
+
+    template <typename Function>
+    double average_us(int iterations, Function &&function) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            function(i);
+        return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    }
+
+    // about the same amount of work for every herd size
+    int iterations(std::size_t instances) {
+        return std::max<int>(3, 20000 / instances);
+    }
+
+    void randomize(std::vector<crowd_instance> &instances, std::uint32_t from, std::uint32_t to, std::size_t count) {
+        std::mt19937 random(count);
+        std::uniform_real_distribution<float> time(0.f, 10.f), weight(0.f, 1.f);
+        instances.resize(count);
+        for (auto &instance: instances)
+            instance = {from, to, time(random), weight(random)};
+    }
+
+    void advance(std::vector<crowd_instance> &instances) {
+        for (auto &instance: instances)
+            instance.time += 1.f / 60.f;
+    }
+
+    double measure_blend_tree(gltf_model const &model, std::string const &from, std::string const &to,
+                              std::vector<crowd_instance> instances) {
+        std::vector<blend_tree> trees;
+        for (std::size_t i = 0; i < instances.size(); ++i) {
+            auto &tree = trees.emplace_back(model.bones.size());
+            tree.add_lerp(tree.add_clip(model.animations.at(from)), tree.add_clip(model.animations.at(to)));
+        }
+        pose_evaluator evaluator(model.bones);
+        std::vector<glm::mat4x3> palettes(instances.size() * model.bones.size());
+
+        return average_us(iterations(instances.size()), [&](int) {
+            advance(instances);
+            for (std::size_t i = 0; i < instances.size(); ++i) {
+                auto &tree = trees[i];
+                tree.set_time(0, instances[i].time);
+                tree.set_time(1, instances[i].time);
+                tree.set_weight(2, instances[i].weight);
+                evaluator.evaluate(tree.evaluate(), std::span(palettes).subspan(i * model.bones.size(), model.bones.size()));
+            }
+        });
+    }
+
+}
+
+int main(int argc, char *argv[]) try {
+    unsigned int const max_threads = argc > 1 ? std::stoi(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+    std::string const path = argc > 2 ? argv[2] : std::string(PROJECT_ROOT) + "/external/wolf/Wolf-Blender-2.82a.gltf";
+
+    auto const model = load_gltf(path);
+    std::cout << path << ": " << model.bones.size() << " bones, " << model.animations.size() << " animations" << std::endl;
+
+    std::vector<std::string> names;
+    for (auto const &[name, animation]: model.animations)
+        names.push_back(name);
+    std::sort(names.begin(), names.end());
+    if (names.empty())
+        throw std::runtime_error("No animations");
+    std::string const from = model.animations.contains("02_walk") ? "02_walk" : names.front();
+    std::string const to = model.animations.contains("01_Run") ? "01_Run" : names[std::min<std::size_t>(1, names.size() - 1)];
+    std::cout << "blending " << from << " and " << to << std::endl;
+
+    crowd herd(model);
+
+    std::vector<unsigned int> thread_counts;
+    for (unsigned int threads = 1; threads < max_threads; threads *= 2)
+        thread_counts.push_back(threads);
+    thread_counts.push_back(max_threads);
+
+    for (std::size_t instances = 1; instances <= 10000; instances *= 10) {
+        randomize(herd.instances, herd.clip(from), herd.clip(to), instances);
+        std::cout << instances << " instances, " << instances * herd.bones() * sizeof(glm::mat4x3) / 1024.0 << " KiB of palettes:" << std::endl;
+
+        std::vector<glm::mat4x3> expected;
+        double single = 0.0;
+        for (unsigned int threads: thread_counts) {
+            job_scheduler scheduler(threads);
+            auto instances_copy = herd.instances;
+            double const time = average_us(iterations(instances), [&](int) {
+                advance(herd.instances);
+                herd.update(scheduler);
+            });
+            if (threads == 1)
+                single = time;
+            std::cout << "  " << threads << " threads: " << time << " us, " << time / instances << " us per instance, "
+                      << single / time << "x" << std::endl;
+
+            // the same frame again to compare
+            herd.instances = instances_copy;
+            herd.update(scheduler);
+            std::vector<glm::mat4x3> const result(herd.palettes().begin(), herd.palettes().end());
+            if (expected.empty())
+                expected = result;
+            else if (result != expected)
+                throw std::runtime_error("Palettes differ with " + std::to_string(threads) + " threads");
+        }
+
+        if (instances <= 1000) {
+            double const time = measure_blend_tree(model, from, to, herd.instances);
+            std::cout << "  blend_tree of splines, one at a time: " << time << " us, " << time / instances << " us per instance"
+                      << std::endl;
+        }
+    }
+}
+catch (std::exception const &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
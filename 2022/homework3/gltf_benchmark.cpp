@@ -0,0 +1,194 @@
+// glTF loading benchmark.
+//
+// Usage: gltf_benchmark [iterations] [model.gltf | model.glb | directory ...]
+// Loads every model of the corpus (the wolf by default, directories are searched recursively) with
+// load_gltf, reads its whole binary data the way the VBO upload does and prints the load time, how much
+// the peak resident set grew meanwhile and how much of that is private memory the model keeps (as opposed
+// to mapped file pages the OS can drop). Every .gltf is also packed into a .glb in the temporary directory
+// and measured from there, so both ways of storing the same asset are compared. The JSON stage alone is
+// timed both as a DOM parsed from an istream, the way load_gltf used to, and in situ from one buffer.
+// Times are averages over `iterations` loads (10 by default); memory is only reported on Linux
+// (/proc/self/status).
+
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <rapidjson/document.h>
+#include <rapidjson/istreamwrapper.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include "gltf_loader.hpp"
+
+namespace {
+
+    // in KiB
+    std::optional<long> read_status(std::string const &field) {
+        std::ifstream status("/proc/self/status");
+        for (std::string line; std::getline(status, line);)
+            if (line.compare(0, field.size() + 1, field + ":") == 0)
+                return std::stol(line.substr(field.size() + 1));
+        return std::nullopt;
+    }
+
+    bool reset_peak() {
+#ifdef __GLIBC__
+        malloc_trim(0); // otherwise memory freed by the previous load is reused without showing up
+#endif
+        std::ofstream clear_refs("/proc/self/clear_refs");
+        clear_refs << "5";
+        clear_refs.flush();
+        return bool(clear_refs);
+    }
+
+    // .gltf + .bin -> .glb with the same JSON minus the buffer uri
+    std::filesystem::path pack_glb(std::filesystem::path const &path) {
+        rapidjson::Document document;
+        {
+            std::ifstream input(path, std::ios::binary);
+            rapidjson::IStreamWrapper stream(input);
+            document.ParseStream(stream);
+        }
+
+        auto buffers = document["buffers"].GetArray();
+        if (buffers.Size() != 1)
+            throw std::runtime_error("Only single-buffer models can be packed: " + path.string());
+
+        auto const bin_path = path.parent_path() / buffers[0]["uri"].GetString();
+        std::vector<char> bin(std::filesystem::file_size(bin_path));
+        std::ifstream(bin_path, std::ios::binary).read(bin.data(), bin.size());
+        buffers[0].RemoveMember("uri");
+
+        rapidjson::StringBuffer json_buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(json_buffer);
+        document.Accept(writer);
+
+        std::string json(json_buffer.GetString(), json_buffer.GetSize());
+        json.resize((json.size() + 3) & ~std::size_t(3), ' ');
+        bin.resize((bin.size() + 3) & ~std::size_t(3), 0);
+
+        auto const result = std::filesystem::temp_directory_path() / (path.stem().string() + ".glb");
+        std::ofstream output(result, std::ios::binary);
+        auto write_u32 = [&](std::uint32_t value) { output.write(reinterpret_cast<char const *>(&value), 4); };
+
+        write_u32(0x46546C67); // "glTF"
+        write_u32(2);
+        write_u32(12 + 8 + json.size() + 8 + bin.size());
+        write_u32(json.size());
+        write_u32(0x4E4F534A); // "JSON"
+        output.write(json.data(), json.size());
+        write_u32(bin.size());
+        write_u32(0x004E4942); // "BIN\0"
+        output.write(bin.data(), bin.size());
+
+        if (!output)
+            throw std::runtime_error("Failed to write " + result.string());
+        return result;
+    }
+
+    template <typename Function>
+    double average_ms(int iterations, Function &&function) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            function();
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    }
+
+    // what glBufferData does with the data
+    unsigned read_binary(gltf_model const &model) {
+        unsigned checksum = 0;
+        auto binary = model.binary();
+        for (std::size_t i = 0; i < binary.size(); i += 64)
+            checksum += static_cast<unsigned char>(binary[i]);
+        return checksum;
+    }
+
+    void measure_json(std::filesystem::path const &path, int iterations) {
+        double stream_ms = average_ms(iterations, [&] {
+            rapidjson::Document document;
+            std::ifstream input(path, std::ios::binary);
+            rapidjson::IStreamWrapper stream(input);
+            document.ParseStream(stream);
+        });
+        double insitu_ms = average_ms(iterations, [&] {
+            rapidjson::Document document;
+            std::vector<char> json(std::filesystem::file_size(path) + 1, '\0');
+            std::ifstream(path, std::ios::binary).read(json.data(), json.size() - 1);
+            document.ParseInsitu(json.data());
+        });
+        std::cout << "  JSON, " << std::filesystem::file_size(path) / 1024 << " KiB: DOM from istream " << stream_ms
+                  << " ms, in situ " << insitu_ms << " ms, x" << stream_ms / insitu_ms << std::endl;
+    }
+
+    // returns the average load time
+    double measure(std::filesystem::path const &path, int iterations) {
+        bool const has_peak = reset_peak();
+        auto const rss_before = read_status("VmRSS");
+        auto const anon_before = read_status("RssAnon");
+
+        {
+            auto model = load_gltf(path);
+            unsigned const checksum = read_binary(model);
+
+            auto const peak = read_status("VmHWM");
+            auto const anon = read_status("RssAnon");
+            std::cout << "  " << path.filename().string() << ": " << model.binary().size() / 1024 << " KiB binary "
+                      << (model.file ? "mapped" : "on the heap");
+            if (has_peak && rss_before && peak)
+                std::cout << ", peak RSS +" << *peak - *rss_before << " KiB";
+            if (anon_before && anon)
+                std::cout << ", private memory kept +" << *anon - *anon_before << " KiB";
+            std::cout << " (checksum " << checksum << ")" << std::endl;
+        }
+
+        double load_ms = average_ms(iterations, [&] { load_gltf(path); });
+        double total_ms = average_ms(iterations, [&] { read_binary(load_gltf(path)); });
+        std::cout << "    load " << load_ms << " ms, with upload read " << total_ms << " ms" << std::endl;
+        return load_ms;
+    }
+
+}
+
+int main(int argc, char *argv[]) try {
+    int iterations = 10;
+    std::vector<std::filesystem::path> paths;
+    for (int i = 1; i < argc; ++i) {
+        std::filesystem::path path = argv[i];
+        if (std::isdigit(static_cast<unsigned char>(argv[i][0])) && !std::filesystem::exists(path))
+            iterations = std::stoi(argv[i]);
+        else if (std::filesystem::is_directory(path)) {
+            for (auto const &entry: std::filesystem::recursive_directory_iterator(path))
+                if (entry.path().extension() == ".gltf" || entry.path().extension() == ".glb")
+                    paths.push_back(entry.path());
+        } else
+            paths.push_back(path);
+    }
+    if (paths.empty())
+        paths.emplace_back(std::string(PROJECT_ROOT) + "/external/wolf/Wolf-Blender-2.82a.gltf");
+
+    double gltf_ms = 0.0, glb_ms = 0.0;
+    for (auto const &path: paths) {
+        std::cout << path.string() << ":" << std::endl;
+        if (is_glb(path))
+            glb_ms += measure(path, iterations);
+        else {
+            measure_json(path, iterations);
+            gltf_ms += measure(path, iterations);
+            glb_ms += measure(pack_glb(path), iterations);
+        }
+    }
+    std::cout << "corpus of " << paths.size() << ": .gltf loads " << gltf_ms << " ms, .glb loads " << glb_ms << " ms" << std::endl;
+}
+catch (std::exception const &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
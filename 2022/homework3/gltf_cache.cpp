@@ -0,0 +1,234 @@
+#include "gltf_cache.hpp"
+#include "binary_cache.hpp"
+
+#include <rapidjson/document.h>
+#include <rapidjson/istreamwrapper.h>
+
+#include <fstream>
+
+namespace
+{
+
+    constexpr std::array<char, 8> magic{'G', 'L', 'T', 'F', 'C', 'A', 'C', 'H'};
+    // bump whenever gltf_model or the layout below changes
+    constexpr std::uint32_t version = 2;
+
+    static_assert(std::is_trivially_copyable_v<gltf_model::accessor>);
+    static_assert(std::is_trivially_copyable_v<glm::vec3>);
+    static_assert(std::is_trivially_copyable_v<glm::quat>);
+    static_assert(std::is_trivially_copyable_v<glm::mat4>);
+
+    // only needed when (re)building the cache: the .bin files are part of the cache key
+    std::vector<std::string> buffer_uris(std::filesystem::path const & path)
+    {
+        rapidjson::Document document;
+        {
+            std::ifstream input(path, std::ios::binary);
+            rapidjson::IStreamWrapper stream(input);
+            document.ParseStream(stream);
+        }
+
+        std::vector<std::string> result;
+        // data uris are part of the .gltf, and buffers no accessor uses are not loaded and may be missing
+        for (auto const & buffer : document["buffers"].GetArray())
+            if (buffer.HasMember("uri") && std::string_view(buffer["uri"].GetString()).substr(0, 5) != "data:"
+                && std::filesystem::exists(path.parent_path() / buffer["uri"].GetString()))
+                result.push_back(buffer["uri"].GetString());
+        return result;
+    }
+
+    template <typename T>
+    void write_spline(binary_cache::writer & writer, gltf_model::spline<T> const & spline)
+    {
+        writer.write_array(spline.timestamps);
+        writer.write_array(spline.values);
+    }
+
+    template <typename T>
+    void read_spline(binary_cache::reader & reader, gltf_model::spline<T> & spline)
+    {
+        auto timestamps = reader.read_array<float>();
+        spline.timestamps.assign(timestamps.begin(), timestamps.end());
+        auto values = reader.read_array<T>();
+        spline.values.assign(values.begin(), values.end());
+    }
+
+    void write_cache(std::filesystem::path const & path, std::vector<std::string> const & uris,
+        std::vector<binary_cache::source_key> const & keys, gltf_model const & model)
+    {
+        binary_cache::writer writer(magic, version);
+        writer.write(keys[0]);
+        writer.write<std::uint32_t>(uris.size());
+        for (std::size_t i = 0; i < uris.size(); ++i)
+        {
+            writer.write_string(uris[i]);
+            writer.write(keys[i + 1]);
+        }
+
+        writer.write_array(model.binary());
+
+        writer.write<std::uint64_t>(model.meshes.size());
+        for (auto const & mesh : model.meshes)
+        {
+            writer.write_string(mesh.name);
+            writer.write(mesh.mode);
+            writer.write<std::uint8_t>(mesh.material.two_sided);
+            writer.write<std::uint8_t>(mesh.material.transparent);
+            writer.write<std::uint8_t>(mesh.material.texture_path.has_value());
+            if (mesh.material.texture_path)
+                writer.write_string(*mesh.material.texture_path);
+            writer.write<std::uint8_t>(mesh.material.color.has_value());
+            if (mesh.material.color)
+                writer.write(*mesh.material.color);
+
+            for (auto const * accessor : {&mesh.indices, &mesh.position, &mesh.normal, &mesh.texcoord, &mesh.joints, &mesh.weights})
+                writer.write(*accessor);
+        }
+
+        writer.write<std::uint64_t>(model.bones.size());
+        for (auto const & bone : model.bones)
+        {
+            writer.write(bone.parent);
+            writer.write_string(bone.name);
+            writer.write(bone.inverse_bind_matrix);
+        }
+
+        writer.write<std::uint64_t>(model.animations.size());
+        for (auto const & [name, animation] : model.animations)
+        {
+            writer.write_string(name);
+            writer.write(animation.max_time);
+            writer.write<std::uint64_t>(animation.bones.size());
+            for (auto const & bone : animation.bones)
+            {
+                write_spline(writer, bone.translation);
+                write_spline(writer, bone.rotation);
+                write_spline(writer, bone.scale);
+            }
+        }
+
+        writer.save(binary_cache::cache_path(path));
+    }
+
+    void read_cache(cached_gltf & result, std::filesystem::path const & path, binary_cache::source_key const & key)
+    {
+        binary_cache::reader reader(result.file.view(), magic, version);
+        reader.expect_key(key);
+        auto buffer_count = reader.read<std::uint32_t>();
+        for (std::uint32_t i = 0; i < buffer_count; ++i)
+        {
+            auto uri = reader.read_string();
+            reader.expect_key(binary_cache::make_key(path.parent_path() / uri));
+        }
+
+        result.buffer = reader.read_array<char>();
+
+        auto & model = result.model;
+
+        model.meshes.resize(reader.read<std::uint64_t>());
+        for (auto & mesh : model.meshes)
+        {
+            mesh.name = reader.read_string();
+            mesh.mode = reader.read<unsigned int>();
+            mesh.material.two_sided = reader.read<std::uint8_t>();
+            mesh.material.transparent = reader.read<std::uint8_t>();
+            if (reader.read<std::uint8_t>())
+                mesh.material.texture_path = std::string(reader.read_string());
+            if (reader.read<std::uint8_t>())
+                mesh.material.color = reader.read<glm::vec4>();
+
+            for (auto * accessor : {&mesh.indices, &mesh.position, &mesh.normal, &mesh.texcoord, &mesh.joints, &mesh.weights})
+                *accessor = reader.read<gltf_model::accessor>();
+        }
+
+        model.bones.resize(reader.read<std::uint64_t>());
+        for (auto & bone : model.bones)
+        {
+            bone.parent = reader.read<unsigned int>();
+            bone.name = reader.read_string();
+            bone.inverse_bind_matrix = reader.read<glm::mat4>();
+        }
+
+        auto animation_count = reader.read<std::uint64_t>();
+        for (std::uint64_t i = 0; i < animation_count; ++i)
+        {
+            std::string name(reader.read_string());
+            auto & animation = model.animations[std::move(name)];
+            animation.max_time = reader.read<float>();
+            animation.bones.resize(reader.read<std::uint64_t>());
+            for (auto & bone : animation.bones)
+            {
+                read_spline(reader, bone.translation);
+                read_spline(reader, bone.rotation);
+                read_spline(reader, bone.scale);
+            }
+        }
+    }
+
+    std::vector<binary_cache::source_key> make_keys(std::filesystem::path const & path, std::vector<std::string> const & uris)
+    {
+        std::vector<binary_cache::source_key> keys{binary_cache::make_key(path)};
+        for (auto const & uri : uris)
+            keys.push_back(binary_cache::make_key(path.parent_path() / uri));
+        return keys;
+    }
+
+}
+
+cached_gltf load_gltf_cached(std::filesystem::path const & path)
+{
+    cached_gltf result;
+
+    // a .glb is mapped as is, a cache would only hold a second copy of its BIN chunk
+    if (is_glb(path))
+    {
+        result.model = load_gltf(path);
+        result.buffer = result.model.binary();
+        return result;
+    }
+
+    auto const key = binary_cache::make_key(path);
+    auto const cache = binary_cache::cache_path(path);
+
+    if (std::filesystem::exists(cache))
+    {
+        try
+        {
+            result.file = mapped_file(cache);
+            read_cache(result, path, key);
+            result.from_cache = true;
+            return result;
+        }
+        catch (std::runtime_error const &)
+        {
+            // stale or damaged cache, rebuild it below
+            result = cached_gltf{};
+        }
+    }
+
+    auto const uris = buffer_uris(path);
+    auto const keys = make_keys(path, uris);
+
+    result.model = load_gltf(path);
+    result.buffer = result.model.binary();
+
+    try
+    {
+        write_cache(path, uris, keys, result.model);
+    }
+    catch (std::runtime_error const &)
+    {
+        // the asset directory may be read-only, the cache is an optimization only
+    }
+
+    return result;
+}
+
+void write_gltf_cache(std::filesystem::path const & path, gltf_model const & model)
+{
+    if (is_glb(path))
+        throw std::runtime_error(".glb files are loaded directly and have no cache: " + path.string());
+
+    auto const uris = buffer_uris(path);
+    write_cache(path, uris, make_keys(path, uris), model);
+}
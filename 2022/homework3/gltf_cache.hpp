@@ -0,0 +1,25 @@
+#pragma once
+
+#include "gltf_loader.hpp"
+#include "mapped_file.hpp"
+
+#include <span>
+
+// A glTF model either mapped from its binary cache or freshly loaded. model.buffer stays empty when
+// the model comes from the cache: use `buffer`, which points into the mapped cache file, instead.
+struct cached_gltf
+{
+    gltf_model model;
+    std::span<char const> buffer;
+
+    bool from_cache = false;
+
+    mapped_file file;
+};
+
+// Maps "<path>.cache" if it was built from the current .gltf and .bin files (size, mtime and content
+// hash of each), otherwise runs load_gltf and (re)writes the cache. A .glb bypasses the cache, load_gltf
+// maps it directly.
+cached_gltf load_gltf_cached(std::filesystem::path const & path);
+
+void write_gltf_cache(std::filesystem::path const & path, gltf_model const & model);
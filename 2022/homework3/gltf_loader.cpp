@@ -1,67 +1,375 @@
 #include "gltf_loader.hpp"
 
 #include <rapidjson/document.h>
-#include <rapidjson/istreamwrapper.h>
 
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <future>
+#include <map>
 #include <stdexcept>
 
+// GLB layout: 12-byte header, then chunks of {length, type, data padded to 4 bytes}; the JSON chunk comes
+// first, the optional BIN chunk is buffer 0
+static constexpr std::uint32_t glb_magic = 0x46546C67;      // "glTF"
+static constexpr std::uint32_t glb_chunk_json = 0x4E4F534A; // "JSON"
+static constexpr std::uint32_t glb_chunk_bin = 0x004E4942;  // "BIN\0"
+
+struct glb_chunks
+{
+    std::string_view json;
+    std::span<char const> bin;
+};
+
+static glb_chunks split_glb(std::string_view file, std::filesystem::path const & path)
+{
+    auto read_u32 = [&](std::size_t offset)
+    {
+        if (offset + 4 > file.size())
+            throw std::runtime_error("Truncated GLB file " + path.string());
+        std::uint32_t value;
+        std::memcpy(&value, file.data() + offset, 4);
+        return value;
+    };
+
+    if (read_u32(0) != glb_magic || read_u32(4) != 2)
+        throw std::runtime_error("Not a GLB 2.0 file: " + path.string());
+    std::size_t const length = std::min<std::size_t>(read_u32(8), file.size());
+
+    glb_chunks result;
+    for (std::size_t offset = 12; offset + 8 <= length;)
+    {
+        std::size_t const chunk_length = read_u32(offset);
+        std::uint32_t const chunk_type = read_u32(offset + 4);
+        offset += 8;
+        if (offset + chunk_length > length)
+            throw std::runtime_error("Truncated GLB chunk in " + path.string());
+
+        if (chunk_type == glb_chunk_json && result.json.empty())
+            result.json = file.substr(offset, chunk_length);
+        else if (chunk_type == glb_chunk_bin && result.bin.empty())
+            result.bin = {file.data() + offset, chunk_length};
+        // unknown chunks must be ignored
+
+        offset += (chunk_length + 3) & ~std::size_t(3);
+    }
+
+    if (result.json.empty())
+        throw std::runtime_error("No JSON chunk in " + path.string());
+    return result;
+}
+
+bool is_glb(std::filesystem::path const & path)
+{
+    std::ifstream input(path, std::ios::binary);
+    std::uint32_t magic = 0;
+    input.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+    return input && magic == glb_magic;
+}
+
 static unsigned int attribute_type_to_size(std::string const & type)
 {
     if (type == "SCALAR") return 1;
     if (type == "VEC2") return 2;
     if (type == "VEC3") return 3;
     if (type == "VEC4") return 4;
-    return 0;
+    if (type == "MAT2") return 4;
+    if (type == "MAT3") return 9;
+    if (type == "MAT4") return 16;
     throw std::runtime_error("Unknown attribute type: " + type);
 }
 
+static unsigned int component_size(unsigned int type)
+{
+    switch (type)
+    {
+    case 0x1400: // GL_BYTE
+    case 0x1401: // GL_UNSIGNED_BYTE
+        return 1;
+    case 0x1402: // GL_SHORT
+    case 0x1403: // GL_UNSIGNED_SHORT
+        return 2;
+    case 0x1405: // GL_UNSIGNED_INT
+    case 0x1406: // GL_FLOAT
+        return 4;
+    }
+    throw std::runtime_error("Unknown component type: " + std::to_string(type));
+}
+
+unsigned int gltf_model::accessor::element_size() const
+{
+    return size * component_size(type);
+}
+
+static std::uint32_t read_index(char const * data, unsigned int type)
+{
+    switch (type)
+    {
+    case 0x1401: // GL_UNSIGNED_BYTE
+        return static_cast<unsigned char>(*data);
+    case 0x1403: // GL_UNSIGNED_SHORT
+    {
+        std::uint16_t index;
+        std::memcpy(&index, data, sizeof(index));
+        return index;
+    }
+    default:
+    {
+        std::uint32_t index;
+        std::memcpy(&index, data, sizeof(index));
+        return index;
+    }
+    }
+}
+
+// "data:[<media type>];base64,<data>" buffer uris, decoded to `size` bytes at `output`
+static void decode_data_uri(std::string_view uri, char * output, std::size_t size)
+{
+    auto const start = uri.find(";base64,");
+    if (start == std::string_view::npos)
+        throw std::runtime_error("Only base64 data uris are supported");
+
+    auto sextet = [](char c) -> int
+    {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '+') return 62;
+        if (c == '/') return 63;
+        return -1;
+    };
+
+    std::size_t written = 0;
+    std::uint32_t bits = 0;
+    int bit_count = 0;
+    for (char c : uri.substr(start + 8))
+    {
+        int const value = sextet(c);
+        if (value < 0)
+            break; // '=' padding
+        bits = (bits << 6) | value;
+        bit_count += 6;
+        if (bit_count >= 8)
+        {
+            bit_count -= 8;
+            if (written == size)
+                break;
+            output[written++] = static_cast<char>((bits >> bit_count) & 0xFF);
+        }
+    }
+
+    if (written != size)
+        throw std::runtime_error("Data uri is shorter than its buffer");
+}
+
+static bool is_data_uri(std::string_view uri)
+{
+    return uri.substr(0, 5) == "data:";
+}
+
 gltf_model load_gltf(std::filesystem::path const & path)
 {
     rapidjson::Document document;
 
+    gltf_model result;
+
+    // The JSON goes into one null-terminated buffer and is parsed in situ: strings in the document point
+    // into it instead of being copied, and the parser reads memory rather than going through a stream.
+    // A GLB JSON chunk is copied out of the read-only mapping for that, it's small.
+    std::vector<char> json;
+
+    if (is_glb(path))
+    {
+        auto file = std::make_shared<mapped_file const>(path);
+        auto const chunks = split_glb(file->view(), path);
+
+        json.assign(chunks.json.begin(), chunks.json.end());
+
+        result.file = std::move(file);
+        result.binary_chunk = chunks.bin;
+    }
+    else
     {
         std::ifstream input(path, std::ios::binary);
-        rapidjson::IStreamWrapper stream(input);
-        document.ParseStream(stream);
+        json.resize(std::filesystem::file_size(path));
+        input.read(json.data(), json.size());
     }
 
-    gltf_model result;
+    json.push_back('\0');
+    document.ParseInsitu(json.data());
+
+    if (document.HasParseError())
+        throw std::runtime_error("Failed to parse " + path.string());
 
+    auto const empty_array = rapidjson::Value(rapidjson::kArrayType);
+    auto array = [&](char const * name) -> rapidjson::Value const &
     {
-        auto buffers = document["buffers"].GetArray();
-        assert(buffers.Size() == 1);
+        return document.HasMember(name) ? document[name] : empty_array;
+    };
 
-        auto const buffer_uri = buffers[0]["uri"].GetString();
+    auto buffers = array("buffers").GetArray();
+    auto buffer_views = array("bufferViews").GetArray();
+    auto accessors = array("accessors").GetArray();
 
-        auto const buffer_path = path.parent_path() / buffer_uri;
+    // Only buffers some accessor points into are loaded (images may have buffers of their own). They are
+    // laid out one after another, so that accessor offsets are offsets into one binary and the whole
+    // model fits one VBO.
+    std::vector<bool> used_buffers(buffers.Size(), false);
+    bool sparse = false;
+    {
+        auto use_view = [&](rapidjson::Value const & object)
+        {
+            if (object.HasMember("bufferView"))
+                used_buffers.at(buffer_views[object["bufferView"].GetUint()]["buffer"].GetUint()) = true;
+        };
 
-        result.buffer.resize(std::filesystem::file_size(buffer_path));
-        std::ifstream buffer(buffer_path, std::ios::binary);
-        buffer.read(result.buffer.data(), result.buffer.size());
+        for (auto const & accessor : accessors)
+        {
+            use_view(accessor);
+            if (accessor.HasMember("sparse"))
+            {
+                sparse = true;
+                use_view(accessor["sparse"]["indices"]);
+                use_view(accessor["sparse"]["values"]);
+            }
+        }
+    }
+
+    std::vector<std::size_t> buffer_offsets(buffers.Size(), 0);
+
+    // a lone GLB BIN chunk is used right from the mapping, anything else is copied into result.buffer
+    bool const mapped = result.file && !sparse && std::count(used_buffers.begin(), used_buffers.end(), true) == 1
+        && used_buffers[0] && !buffers[0].HasMember("uri");
+
+    // accessors read the mapping directly, a truncated or lying .glb must not send them past its end
+    if (mapped && result.binary_chunk.size() < buffers[0]["byteLength"].GetUint())
+        throw std::runtime_error("Buffer 0 has no data in " + path.string());
+
+    if (!mapped)
+    {
+        std::size_t size = 0;
+        for (rapidjson::SizeType i = 0; i < buffers.Size(); ++i)
+        {
+            if (!used_buffers[i])
+                continue;
+            buffer_offsets[i] = size;
+            size += (buffers[i]["byteLength"].GetUint() + 15) & ~std::size_t(15);
+        }
+        result.buffer.resize(size);
+
+        // every buffer is read (or decoded) by a thread of its own
+        std::vector<std::future<void>> loads;
+        for (rapidjson::SizeType i = 0; i < buffers.Size(); ++i)
+        {
+            if (!used_buffers[i])
+                continue;
+
+            char * output = result.buffer.data() + buffer_offsets[i];
+            std::size_t const length = buffers[i]["byteLength"].GetUint();
+
+            if (!buffers[i].HasMember("uri"))
+            {
+                if (i != 0 || result.binary_chunk.size() < length)
+                    throw std::runtime_error("Buffer " + std::to_string(i) + " has no data in " + path.string());
+                std::memcpy(output, result.binary_chunk.data(), length);
+                continue;
+            }
+
+            std::string_view const uri = buffers[i]["uri"].GetString();
+            if (is_data_uri(uri))
+                loads.push_back(std::async(std::launch::async, [=] { decode_data_uri(uri, output, length); }));
+            else
+                loads.push_back(std::async(std::launch::async, [=, buffer_path = path.parent_path() / uri]
+                {
+                    std::ifstream input(buffer_path, std::ios::binary);
+                    if (!input.read(output, length))
+                        throw std::runtime_error("Failed to read " + buffer_path.string());
+                }));
+        }
+        for (auto & load : loads)
+            load.get();
+
+        result.file.reset();
+        result.binary_chunk = {};
     }
 
     auto parse_buffer_view = [&](int index) -> gltf_model::buffer_view
     {
-        auto view = document["bufferViews"].GetArray()[index].GetObject();
-        return {view["byteOffset"].GetUint(), view["byteLength"].GetUint()};
+        auto view = buffer_views[index].GetObject();
+        return {
+            static_cast<unsigned int>(buffer_offsets[view["buffer"].GetUint()] + (view.HasMember("byteOffset") ? view["byteOffset"].GetUint() : 0)),
+            view["byteLength"].GetUint(),
+            view.HasMember("byteStride") ? view["byteStride"].GetUint() : 0,
+        };
     };
 
+    // sparse accessors are made dense at the end of result.buffer, once each
+    std::map<int, gltf_model::accessor> densified;
+
     auto parse_accessor = [&](int index) -> gltf_model::accessor
     {
-        auto accessor = document["accessors"].GetArray()[index].GetObject();
-        return {
-            parse_buffer_view(accessor["bufferView"].GetInt()),
-            accessor["componentType"].GetUint(),
-            attribute_type_to_size(accessor["type"].GetString()),
-            accessor["count"].GetUint(),
-        };
+        if (auto it = densified.find(index); it != densified.end())
+            return it->second;
+
+        auto accessor = accessors[index].GetObject();
+
+        gltf_model::accessor result_accessor;
+        result_accessor.type = accessor["componentType"].GetUint();
+        result_accessor.size = attribute_type_to_size(accessor["type"].GetString());
+        result_accessor.count = accessor["count"].GetUint();
+        result_accessor.normalized = accessor.HasMember("normalized") && accessor["normalized"].GetBool();
+
+        unsigned int const offset = accessor.HasMember("byteOffset") ? accessor["byteOffset"].GetUint() : 0;
+        if (accessor.HasMember("bufferView"))
+        {
+            result_accessor.view = parse_buffer_view(accessor["bufferView"].GetInt());
+            result_accessor.view.offset += offset;
+            result_accessor.view.size -= offset;
+        }
+
+        if (!accessor.HasMember("sparse"))
+            return result_accessor;
+
+        std::size_t const element_size = result_accessor.element_size();
+        std::vector<char> dense(result_accessor.count * element_size, 0);
+        if (accessor.HasMember("bufferView"))
+            for (std::size_t i = 0; i < result_accessor.count; ++i)
+                std::memcpy(dense.data() + i * element_size, result.buffer.data() + result_accessor.view.offset + i * result_accessor.stride(), element_size);
+
+        auto const & sparse = accessor["sparse"];
+        auto const & indices = sparse["indices"];
+        auto const & values = sparse["values"];
+        unsigned int const index_type = indices["componentType"].GetUint();
+        char const * index_data = result.buffer.data() + parse_buffer_view(indices["bufferView"].GetInt()).offset
+            + (indices.HasMember("byteOffset") ? indices["byteOffset"].GetUint() : 0);
+        char const * value_data = result.buffer.data() + parse_buffer_view(values["bufferView"].GetInt()).offset
+            + (values.HasMember("byteOffset") ? values["byteOffset"].GetUint() : 0);
+
+        for (std::size_t i = 0; i < sparse["count"].GetUint(); ++i)
+        {
+            std::uint32_t const target = read_index(index_data + i * component_size(index_type), index_type);
+            if (target >= result_accessor.count)
+                throw std::runtime_error("Sparse index out of range in " + path.string());
+            std::memcpy(dense.data() + target * element_size, value_data + i * element_size, element_size);
+        }
+
+        result_accessor.view = {static_cast<unsigned int>(result.buffer.size()), static_cast<unsigned int>(dense.size()), 0};
+        result.buffer.insert(result.buffer.end(), dense.begin(), dense.end());
+        result.buffer.resize((result.buffer.size() + 15) & ~std::size_t(15));
+
+        return densified[index] = result_accessor;
     };
 
-    auto parse_texture = [&](int index) -> std::string
+    // images embedded in a buffer have no path and are left out
+    auto parse_texture = [&](int index) -> std::optional<std::string>
     {
-        auto const source_index = document["textures"].GetArray()[index]["source"].GetInt();
-        return document["images"].GetArray()[source_index]["uri"].GetString();
+        auto const & texture = document["textures"].GetArray()[index];
+        if (!texture.HasMember("source"))
+            return std::nullopt;
+        auto const & image = document["images"].GetArray()[texture["source"].GetInt()];
+        if (!image.HasMember("uri") || is_data_uri(image["uri"].GetString()))
+            return std::nullopt;
+        return image["uri"].GetString();
     };
 
     auto parse_color = [&](auto const & array)
@@ -74,45 +382,68 @@ gltf_model load_gltf(std::filesystem::path const & path)
         };
     };
 
-    for (auto const & mesh : document["meshes"].GetArray())
+    for (auto const & mesh : array("meshes").GetArray())
     {
-        auto & result_mesh = result.meshes.emplace_back();
-        result_mesh.name = mesh["name"].GetString();
+        for (auto const & primitive : mesh["primitives"].GetArray())
+        {
+            auto & result_mesh = result.meshes.emplace_back();
+            result_mesh.name = mesh.HasMember("name") ? mesh["name"].GetString() : "";
+            result_mesh.mode = primitive.HasMember("mode") ? primitive["mode"].GetUint() : 4; // GL_TRIANGLES
 
-        auto primitives = mesh["primitives"].GetArray();
-        assert(primitives.Size() == 1);
+            auto const & attributes = primitive["attributes"];
+            auto parse_attribute = [&](char const * name)
+            {
+                return attributes.HasMember(name) ? parse_accessor(attributes[name].GetInt()) : gltf_model::accessor{};
+            };
 
-        auto const & attributes = primitives[0]["attributes"];
+            if (primitive.HasMember("indices"))
+                result_mesh.indices = parse_accessor(primitive["indices"].GetInt());
+            result_mesh.position = parse_attribute("POSITION");
+            result_mesh.normal = parse_attribute("NORMAL");
+            result_mesh.texcoord = parse_attribute("TEXCOORD_0");
+            result_mesh.joints = parse_attribute("JOINTS_0");
+            result_mesh.weights = parse_attribute("WEIGHTS_0");
 
-        result_mesh.indices = parse_accessor(primitives[0]["indices"].GetInt());
-        result_mesh.position = parse_accessor(attributes["POSITION"].GetInt());
-        result_mesh.normal = parse_accessor(attributes["NORMAL"].GetInt());
-        result_mesh.texcoord = parse_accessor(attributes["TEXCOORD_0"].GetInt());
-        result_mesh.joints = parse_accessor(attributes["JOINTS_0"].GetInt());
-        result_mesh.weights = parse_accessor(attributes["WEIGHTS_0"].GetInt());
+            result_mesh.material = {false, false, std::nullopt, std::nullopt};
+            if (!primitive.HasMember("material"))
+            {
+                result_mesh.material.color = glm::vec4(1.f);
+                continue;
+            }
 
-        auto const & material = document["materials"].GetArray()[primitives[0]["material"].GetInt()];
+            auto const & material = document["materials"].GetArray()[primitive["material"].GetInt()];
 
-        result_mesh.material.two_sided = material.HasMember("doubleSided") && material["doubleSided"].GetBool();
-        result_mesh.material.transparent = material.HasMember("alphaMode") && (material["alphaMode"].GetString() == std::string("BLEND"));
+            result_mesh.material.two_sided = material.HasMember("doubleSided") && material["doubleSided"].GetBool();
+            result_mesh.material.transparent = material.HasMember("alphaMode") && (material["alphaMode"].GetString() == std::string("BLEND"));
 
-        auto const & pbr = material["pbrMetallicRoughness"];
-        if (pbr.HasMember("baseColorTexture"))
-            result_mesh.material.texture_path = parse_texture(pbr["baseColorTexture"]["index"].GetInt());
-        else if (pbr.HasMember("baseColorFactor"))
-            result_mesh.material.color = parse_color(pbr["baseColorFactor"].GetArray());
+            if (material.HasMember("pbrMetallicRoughness"))
+            {
+                auto const & pbr = material["pbrMetallicRoughness"];
+                if (pbr.HasMember("baseColorTexture"))
+                    result_mesh.material.texture_path = parse_texture(pbr["baseColorTexture"]["index"].GetInt());
+                if (!result_mesh.material.texture_path && pbr.HasMember("baseColorFactor"))
+                    result_mesh.material.color = parse_color(pbr["baseColorFactor"].GetArray());
+            }
+            if (!result_mesh.material.texture_path && !result_mesh.material.color)
+                result_mesh.material.color = glm::vec4(1.f);
+        }
     }
 
-    auto skins = document["skins"].GetArray();
-    assert(skins.Size() == 1);
+    auto skins = array("skins").GetArray();
+    if (skins.Size() > 1)
+        throw std::runtime_error("Models with several skins are not supported: " + path.string());
 
+    if (skins.Size() == 1)
     {
         auto fill_buffer = [&](auto & vector, gltf_model::accessor const & accessor)
         {
             assert(accessor.type == 0x1406); // GL_FLOAT
             using value_type = std::decay_t<decltype(vector[0])>;
-            auto begin = reinterpret_cast<value_type const *>(result.buffer.data() + accessor.view.offset);
-            vector.assign(begin, begin + accessor.count);
+            assert(accessor.element_size() == sizeof(value_type));
+            char const * data = result.binary().data() + accessor.view.offset;
+            vector.resize(accessor.count);
+            for (std::size_t i = 0; i < accessor.count; ++i)
+                std::memcpy(&vector[i], data + i * accessor.stride(), sizeof(value_type));
         };
 
         auto fix_rotations = [](std::vector<glm::quat> & rotations)
@@ -133,7 +464,8 @@ gltf_model load_gltf(std::filesystem::path const & path)
         {
             int const node_id = joints[i].GetInt();
             bone_node_to_index[node_id] = i;
-            result.bones[i].name = document["nodes"].GetArray()[node_id]["name"].GetString();
+            auto const & node = document["nodes"].GetArray()[node_id];
+            result.bones[i].name = node.HasMember("name") ? node["name"].GetString() : "";
             result.bones[i].inverse_bind_matrix = inverse_bind_matrices[i];
         }
 
@@ -158,9 +490,9 @@ gltf_model load_gltf(std::filesystem::path const & path)
         for (int i = 0; i < result.bones.size(); ++i)
             assert(result.bones[i].parent == -1 || result.bones[i].parent < i);
 
-        for (auto const & animation : document["animations"].GetArray())
+        for (auto const & animation : array("animations").GetArray())
         {
-            std::string name = animation["name"].GetString();
+            std::string name = animation.HasMember("name") ? animation["name"].GetString() : "";
 
             auto samplers = animation["samplers"].GetArray();
 
@@ -218,3 +550,21 @@ gltf_model load_gltf(std::filesystem::path const & path)
 
     return result;
 }
+
+void gltf_model::animation::sample(float time, std::vector<std::size_t> & cursors, std::span<glm::vec3> translations,
+    std::span<glm::quat> rotations, std::span<glm::vec3> scales) const
+{
+    assert(translations.size() >= bones.size() && rotations.size() >= bones.size() && scales.size() >= bones.size());
+
+    cursors.resize(3 * bones.size(), 0);
+
+    for (std::size_t i = 0; i < bones.size(); ++i)
+    {
+        auto const & bone = bones[i];
+        std::size_t * cursor = cursors.data() + 3 * i;
+
+        translations[i] = bone.translation.values.empty() ? glm::vec3(0.f) : bone.translation(time, cursor[0]);
+        rotations[i] = bone.rotation.values.empty() ? glm::quat(1.f, 0.f, 0.f, 0.f) : bone.rotation(time, cursor[1]);
+        scales[i] = bone.scale.values.empty() ? glm::vec3(1.f) : bone.scale(time, cursor[2]);
+    }
+}
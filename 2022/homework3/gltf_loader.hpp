@@ -1,6 +1,8 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
+#include <span>
 #include <vector>
 #include <string>
 #include <optional>
@@ -14,20 +16,27 @@
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtx/compatibility.hpp>
 
+#include "mapped_file.hpp"
+
 struct gltf_model
 {
     struct buffer_view
     {
-        unsigned int offset;
+        unsigned int offset;    // into binary(), including the byteOffset of the accessor
         unsigned int size;
+        unsigned int stride;    // byteStride, 0 when the elements are tightly packed
     };
 
     struct accessor
     {
-        buffer_view view;
-        unsigned int type;
-        unsigned int size;
-        unsigned int count;
+        buffer_view view{};
+        unsigned int type = 0;
+        unsigned int size = 0;
+        unsigned int count = 0; // 0 for attributes a primitive doesn't have
+        bool normalized = false;
+
+        unsigned int element_size() const;
+        unsigned int stride() const { return view.stride ? view.stride : element_size(); }
     };
 
     struct material
@@ -52,6 +61,14 @@ struct gltf_model
         std::vector<T> values;
 
         T operator()(float time) const;
+
+        // Same value, but the key search starts from `cursor`, the key found by the previous call on this
+        // spline (start with 0): amortized O(1) while time moves forward, a binary search after seeks and
+        // loops
+        T operator()(float time, std::size_t & cursor) const;
+
+        // value at `time` given the key found for it
+        T at_key(std::size_t key, float time) const;
     };
 
     struct bone_animation
@@ -65,14 +82,22 @@ struct gltf_model
     {
         std::vector<bone_animation> bones;
         float max_time = 0.f;
+
+        // Samples every channel of every bone at `time` into the outputs, one element per bone; channels
+        // without keys give the identity. `cursors` keeps the keys found, 3 per bone, for the next call
+        // and is sized on first use.
+        void sample(float time, std::vector<std::size_t> & cursors, std::span<glm::vec3> translations,
+            std::span<glm::quat> rotations, std::span<glm::vec3> scales) const;
     };
 
+    // One per primitive of every glTF mesh, primitives of one mesh share its name
     struct mesh
     {
         std::string name;
         struct material material;
+        unsigned int mode = 4; // GL_TRIANGLES
 
-        accessor indices;
+        accessor indices;      // count is 0 for non-indexed primitives
 
         accessor position;
         accessor normal;
@@ -81,44 +106,90 @@ struct gltf_model
         accessor weights;
     };
 
+    // All buffers the accessors use, one after another. Stays empty for a .glb whose accessors only use
+    // its BIN chunk, which is used right where it is mapped: `file` keeps the mapping alive and
+    // `binary_chunk` points into it.
     std::vector<char> buffer;
+    std::shared_ptr<mapped_file const> file;
+    std::span<char const> binary_chunk;
+
+    // the binary data all accessors point into, wherever it lives
+    std::span<char const> binary() const
+    {
+        return file ? binary_chunk : std::span<char const>(buffer);
+    }
+
     std::vector<mesh> meshes;
     std::vector<bone> bones;
     std::unordered_map<std::string, animation> animations;
 };
 
+// Loads a .gltf with its buffers (read in parallel, only those accessors use), or a .glb (told apart by
+// the header, not the extension). Sparse accessors are made dense at the end of the binary data.
 gltf_model load_gltf(std::filesystem::path const & path);
 
-template <>
-inline glm::vec3 gltf_model::spline<glm::vec3>::operator()(float time) const
+bool is_glb(std::filesystem::path const & path);
+
+// The first key not before `time`, like std::lower_bound, searched from `cursor` (the key found last
+// time), which is updated
+template <typename Timestamps>
+std::size_t find_key(Timestamps const & timestamps, float time, std::size_t & cursor)
+{
+    std::size_t i = std::min(cursor, timestamps.size());
+    if (i > 0 && !(timestamps[i - 1] < time))
+    {
+        // went back in time
+        i = std::lower_bound(timestamps.begin(), timestamps.begin() + i, time) - timestamps.begin();
+    }
+    else
+    {
+        // a frame usually moves a key or two forward, anything further is searched for
+        std::size_t const limit = std::min(i + 4, timestamps.size());
+        while (i < limit && timestamps[i] < time)
+            ++i;
+        if (i == limit)
+            i = std::lower_bound(timestamps.begin() + i, timestamps.end(), time) - timestamps.begin();
+    }
+    cursor = i;
+    return i;
+}
+
+template <typename T>
+T gltf_model::spline<T>::operator()(float time) const
 {
     assert(!values.empty());
 
-    auto it = std::lower_bound(timestamps.begin(), timestamps.end(), time);
-    if (it == timestamps.begin())
-        return values.back();
-    if (it == timestamps.end())
-        return values.back();
+    return at_key(std::lower_bound(timestamps.begin(), timestamps.end(), time) - timestamps.begin(), time);
+}
+
+template <typename T>
+T gltf_model::spline<T>::operator()(float time, std::size_t & cursor) const
+{
+    assert(!values.empty());
 
-    int i = it - timestamps.begin();
+    return at_key(find_key(timestamps, time, cursor), time);
+}
+
+template <>
+inline glm::vec3 gltf_model::spline<glm::vec3>::at_key(std::size_t i, float time) const
+{
+    if (i == 0)
+        return values.front();
+    if (i == timestamps.size())
+        return values.back();
 
     float t = (time - timestamps[i - 1]) / (timestamps[i] - timestamps[i - 1]);
     return glm::lerp(values[i - 1], values[i], t);
 }
 
 template <>
-inline glm::quat gltf_model::spline<glm::quat>::operator()(float time) const
+inline glm::quat gltf_model::spline<glm::quat>::at_key(std::size_t i, float time) const
 {
-    assert(!values.empty());
-
-    auto it = std::lower_bound(timestamps.begin(), timestamps.end(), time);
-    if (it == timestamps.begin())
-        return values.back();
-    if (it == timestamps.end())
+    if (i == 0)
+        return values.front();
+    if (i == timestamps.size())
         return values.back();
 
-    int i = it - timestamps.begin();
-
     float t = (time - timestamps[i - 1]) / (timestamps[i] - timestamps[i - 1]);
     return glm::slerp(values[i - 1], values[i], t);
 }
@@ -0,0 +1,95 @@
+#include "job_scheduler.hpp"
+
+#include <algorithm>
+#include <utility>
+
+job_scheduler::job_scheduler(unsigned int threads)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned int t = 1; t < threads; ++t)
+        workers_.emplace_back([this, t]{ work(t); });
+}
+
+job_scheduler::~job_scheduler()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    start_.notify_all();
+    for (auto & worker : workers_)
+        worker.join();
+}
+
+void job_scheduler::parallel_for(std::size_t count, std::size_t block,
+    std::function<void(std::size_t, std::size_t, unsigned int)> const & function)
+{
+    block = std::max<std::size_t>(block, 1);
+
+    // not worth waking anyone up
+    if (workers_.empty() || count <= block)
+    {
+        for (std::size_t begin = 0; begin < count; begin += block)
+            function(begin, std::min(begin + block, count), 0);
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex_);
+        function_ = &function;
+        count_ = count;
+        block_ = block;
+        next_ = 0;
+        error_ = nullptr;
+        busy_ = workers_.size();
+        ++generation_;
+    }
+    start_.notify_all();
+
+    run(0);
+
+    std::unique_lock lock(mutex_);
+    done_.wait(lock, [this]{ return busy_ == 0; });
+    function_ = nullptr;
+    if (auto error = std::exchange(error_, nullptr))
+        std::rethrow_exception(error);
+}
+
+void job_scheduler::work(unsigned int thread)
+{
+    std::uint64_t generation = 0;
+    std::unique_lock lock(mutex_);
+    while (true)
+    {
+        start_.wait(lock, [&]{ return stop_ || generation_ != generation; });
+        if (stop_)
+            return;
+        generation = generation_;
+
+        lock.unlock();
+        run(thread);
+        lock.lock();
+
+        // parallel_for waits for every worker, none can miss a loop by waking up late
+        if (--busy_ == 0)
+            done_.notify_one();
+    }
+}
+
+void job_scheduler::run(unsigned int thread)
+{
+    try
+    {
+        for (std::size_t begin; (begin = next_.fetch_add(block_)) < count_;)
+            (*function_)(begin, std::min(begin + block_, count_), thread);
+    }
+    catch (...)
+    {
+        std::lock_guard lock(mutex_);
+        if (!error_)
+            error_ = std::current_exception();
+        next_ = count_;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs loops split in blocks over a fixed set of threads started once, so that a per frame job only costs
+// waking them up. The calling thread takes part in the work: threads() counts it, and a scheduler of one
+// thread runs everything on the caller.
+class job_scheduler
+{
+public:
+    // `threads` including the caller, 0 for one per hardware thread
+    explicit job_scheduler(unsigned int threads = 0);
+    ~job_scheduler();
+
+    job_scheduler(job_scheduler const &) = delete;
+    job_scheduler & operator=(job_scheduler const &) = delete;
+
+    unsigned int threads() const { return workers_.size() + 1; }
+
+    // Calls function(begin, end, thread) for the blocks [begin, end) of [0, count), `block` elements each
+    // (but the last), and returns once all are done. `thread` is in [0, threads()), 0 for the caller, and no
+    // two blocks run on the same thread at the same time, so it can index per thread scratch buffers. The
+    // first exception thrown by `function` is rethrown here, the blocks not started yet are skipped.
+    void parallel_for(std::size_t count, std::size_t block,
+        std::function<void(std::size_t, std::size_t, unsigned int)> const & function);
+
+private:
+    void work(unsigned int thread);
+    void run(unsigned int thread);
+
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    std::uint64_t generation_ = 0;
+    unsigned int busy_ = 0;
+    bool stop_ = false;
+
+    // the current loop
+    std::function<void(std::size_t, std::size_t, unsigned int)> const * function_ = nullptr;
+    std::size_t count_ = 0;
+    std::size_t block_ = 0;
+    std::atomic<std::size_t> next_{0};
+    std::exception_ptr error_;
+};
@@ -31,7 +31,15 @@
 #include <glm/gtx/string_cast.hpp>
 
 #include "obj_parser.hpp"
+#include "obj_cache.hpp"
 #include "gltf_loader.hpp"
+#include "gltf_cache.hpp"
+#include "skeleton_pose.hpp"
+#include "crowd.hpp"
+#include "job_scheduler.hpp"
+#include "skinning.hpp"
+#include "texture_streamer.hpp"
+#include "texture_cache.hpp"
 #include "stb_image.h"
 #include "main.h"
 
@@ -76,6 +84,10 @@ int main() try {
     const std::string project_root = PROJECT_ROOT;
     std::map<std::string, GLuint> programs;
 
+    // decoded on worker threads and uploaded a level at a time while the first frames render
+    texture_streamer textures;
+    auto const streaming_start = std::chrono::high_resolution_clock::now();
+
     // Environment
     programs["sky"] = create_program(project_root + "/shaders/", "environment");
 
@@ -85,7 +97,7 @@ int main() try {
                                                         "brightness"});
     GLuint skybox_vao;
     glGenVertexArrays(1, &skybox_vao);
-    GLuint environment_map = load_texture2D(project_root + "/external/environment_map.jpg");
+    GLuint environment_map = textures.load(project_root + "/external/environment_map.jpg");
 
     // Wolf
     programs["wolf"] = create_program(project_root + "/shaders/", "wolf");
@@ -95,18 +107,35 @@ int main() try {
                                                           "projection",
                                                           "albedo",
                                                           "color",
-                                                          "use_texture",
+                                                          "layer",
                                                           "light_direction",
                                                           "bones",
+                                                          "bone_count",
                                                           "brightness"});
 
+    // the same with dual quaternion skinning, Q switches
+    programs["wolf_dq"] = create_program(project_root + "/shaders/", "wolf_dq", "wolf");
+    auto wolf_dq_locations = getLocations(programs["wolf_dq"], {"model",
+                                                                "view",
+                                                                "projection",
+                                                                "albedo",
+                                                                "color",
+                                                                "layer",
+                                                                "light_direction",
+                                                                "bones",
+                                                                "bone_count",
+                                                                "brightness"});
+
     const std::string wolf_path = project_root + "/external/wolf/Wolf-Blender-2.82a.gltf";
-    auto const wolf_model = load_gltf(wolf_path);
+    auto load_start = std::chrono::high_resolution_clock::now();
+    auto const wolf = load_gltf_cached(wolf_path);
+    auto const &wolf_model = wolf.model;
+    report_load_time(wolf_path, load_start, wolf.from_cache);
 
     GLuint wolf_vbo;
     glGenBuffers(1, &wolf_vbo);
     glBindBuffer(GL_ARRAY_BUFFER, wolf_vbo);
-    glBufferData(GL_ARRAY_BUFFER, wolf_model.buffer.size(), wolf_model.buffer.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, wolf.buffer.size(), wolf.buffer.data(), GL_STATIC_DRAW);
 
     std::vector<mesh> wolf_meshes;
     for (auto const &mesh: wolf_model.meshes) {
@@ -115,6 +144,8 @@ int main() try {
         glBindVertexArray(result.vao);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, wolf_vbo);
+        result.mode = mesh.mode;
+        result.vertex_count = mesh.position.count;
         result.indices = mesh.indices;
 
         setup_attribute(0, mesh.position);
@@ -126,14 +157,28 @@ int main() try {
         result.material = mesh.material;
     }
 
-    std::map<std::string, GLuint> wolf_textures;
-    for (auto const &mesh: wolf_meshes) {
+    // every texture of the wolf is a layer of one texture array, bound once, and each mesh draws with the
+    // layer of its material instead of binding its own texture
+    std::map<std::string, GLint> wolf_layers;
+    std::vector<std::string> wolf_texture_paths;
+    for (auto &mesh: wolf_meshes) {
+        mesh.layer = -1;
         if (!mesh.material.texture_path) continue;
-        if (wolf_textures.contains(*mesh.material.texture_path)) continue;
-
-        auto path = std::filesystem::path(wolf_path).parent_path() / *mesh.material.texture_path;
 
-        wolf_textures[*mesh.material.texture_path] = load_texture2D(path);
+        auto [it, added] = wolf_layers.emplace(*mesh.material.texture_path, wolf_texture_paths.size());
+        if (added)
+            wolf_texture_paths.push_back((std::filesystem::path(wolf_path).parent_path() / it->first).string());
+        mesh.layer = it->second;
+    }
+    GLuint wolf_albedo = textures.load_array(wolf_texture_paths);
+    {
+        // per pass of draw_wolf_meshes, the same for the shadow, the herd and the lighthouse
+        auto const textured = std::count_if(wolf_meshes.begin(), wolf_meshes.end(), [](auto const &mesh) { return mesh.layer >= 0; });
+        auto const drawn = std::count_if(wolf_meshes.begin(), wolf_meshes.end(), [](auto const &mesh) {
+            return mesh.layer >= 0 || mesh.material.color;
+        });
+        std::cout << "Wolf: " << wolf_texture_paths.size() << " textures in one texture array; per pass "
+                  << textured << " -> 0 texture binds, " << drawn << " draws (one per mesh VAO either way)" << std::endl;
     }
 
     // Floor
@@ -174,7 +219,8 @@ int main() try {
 
         floor_index_count = indices.size();
     }
-    GLuint floor_normal = load_texture2D(project_root + "/external/snow_normal.png");
+    GLuint floor_normal = textures.load(project_root + "/external/snow_normal.png", mip_content::normal_map,
+                                       {128, 128, 255, 255});
 
     // Lighthouse
     programs["lighthouse"] = create_program(project_root + "/shaders/", "lighthouse");
@@ -190,7 +236,9 @@ int main() try {
 
     const std::string lighthouse_path =
             project_root + "/external/Octagonal_Lighthouse_v1/_17498_Octagonal_Lighthouse_v1_NEW.obj";
-    obj_parser::obj_data lighthouse_model = obj_parser::parse_obj(lighthouse_path);
+    load_start = std::chrono::high_resolution_clock::now();
+    auto const lighthouse_model = obj_parser::load_obj_cached(lighthouse_path);
+    report_load_time(lighthouse_path, load_start, lighthouse_model.from_cache);
     GLuint lighthouse_vao;
     glGenVertexArrays(1, &lighthouse_vao);
     glBindVertexArray(lighthouse_vao);
@@ -221,7 +269,7 @@ int main() try {
     for (auto const &group: lighthouse_model.groups) {
         if (!group.material.albedo.empty()) continue;
 
-        lighthouse_textures[group.material.albedo] = load_texture2D(group.material.albedo);
+        lighthouse_textures[group.material.albedo] = textures.load(group.material.albedo);
     }
     // ...
     // To hell with this. Now wolf is a lighthouse.
@@ -339,17 +387,49 @@ int main() try {
     glEnableVertexAttribArray(3);
     glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(vertex), (void *)offsetof(vertex, texcoord));
 
-    // Assigning some wolf_textures to fixed texture units
+    // Assigning some textures to fixed texture units
     const int sky_sampler = 1;
     glActiveTexture(GL_TEXTURE0 + sky_sampler);
     glBindTexture(GL_TEXTURE_2D, environment_map);
 
     const int wolf_sampler = 2;
+    glActiveTexture(GL_TEXTURE0 + wolf_sampler);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, wolf_albedo);
     const int floor_sampler = 3;
     glActiveTexture(GL_TEXTURE0 + floor_sampler);
     glBindTexture(GL_TEXTURE_2D, floor_normal);
     const int lighthouse_sampler = 4;
     const int shadow_sampler = 5;
+    const int bones_sampler = 6;
+
+    // A herd of wolves running in a ring, posed in parallel into one buffer texture and drawn with one
+    // instanced draw per mesh
+    GLint max_texture_buffer_size;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texture_buffer_size);
+    const std::size_t herd_size = std::min<std::size_t>(8, max_texture_buffer_size / (3 * wolf_model.bones.size()));
+
+    job_scheduler scheduler;
+    crowd herd(wolf_model);
+    herd.instances.resize(herd_size);
+    std::vector<float> herd_phases(herd_size, 0.f);
+    {
+        std::default_random_engine random;
+        std::uniform_real_distribution<float> phase(0.f, 10.f);
+        for (std::size_t i = 1; i < herd_size; ++i)
+            herd_phases[i] = phase(random);
+        for (auto &instance: herd.instances) {
+            instance.from = herd.clip("02_walk");
+            instance.to = herd.clip("01_Run");
+        }
+    }
+    std::vector<dual_quaternion> herd_dual_quaternions;
+
+    auto herd_palettes = create_buffer_texture();
+    auto rest_palette = create_buffer_texture();
+    {
+        std::vector<glm::mat4x3> const rest_bones(wolf_model.bones.size(), glm::mat4x3(1.f));
+        update_buffer_texture(rest_palette, rest_bones.data(), rest_bones.size() * sizeof(rest_bones[0]));
+    }
 
     // In-loop variables
     auto last_frame_start = std::chrono::high_resolution_clock::now();
@@ -368,8 +448,11 @@ int main() try {
     const float animation_speed = 1.f;
 
     bool paused = false;
+    bool dual_quaternion_skinning = false;
     float interpolation = 0.f;
 
+    bool streamed = false;
+
     bool running = true;
     while (running) {
         for (SDL_Event event; SDL_PollEvent(&event);)
@@ -390,6 +473,8 @@ int main() try {
                     button_down[event.key.keysym.sym] = true;
                     if (event.key.keysym.sym == SDLK_SPACE)
                         paused = !paused;
+                    if (event.key.keysym.sym == SDLK_q)
+                        dual_quaternion_skinning = !dual_quaternion_skinning;
                     break;
                 case SDL_KEYUP:
                     button_down[event.key.keysym.sym] = false;
@@ -406,6 +491,16 @@ int main() try {
         if (!paused)
             time += dt;
 
+        textures.update();
+        if (!streamed && textures.idle()) {
+            streamed = true;
+            std::cout << "Streamed " << textures.stats().textures << " textures in "
+                      << std::chrono::duration<float, std::milli>(now - streaming_start).count() << " ms" << std::endl;
+        }
+        textures.use(environment_map);
+        textures.use(floor_normal);
+        textures.use(wolf_albedo);
+
         if (button_down[SDLK_UP])
             camera_distance -= 3.f * dt;
         if (button_down[SDLK_DOWN])
@@ -439,13 +534,8 @@ int main() try {
 
         float near = 0.01f;
         float far = 100.f;
-        float scale = 0.75f + cos(time) * 0.25f;
 
         glm::mat4 model(1.f);
-        glm::mat4 wolf_model_mat(1.f);
-        wolf_model_mat = glm::rotate(wolf_model_mat, -time * 1.13f, {0.f, 1.f, 0.f});
-        wolf_model_mat = glm::translate(wolf_model_mat, {0.7f, 0.f, 0.f});
-        wolf_model_mat = glm::scale(wolf_model_mat, glm::vec3(0.6f));
         glm::mat4 lighthouse_model_mat(1.f);
         lighthouse_model_mat = glm::rotate(lighthouse_model_mat, glm::pi<float>() / 2.f, {-1.f, 0.f, 0.f});
         lighthouse_model_mat = glm::translate(lighthouse_model_mat, {0.f, -0.2f, 0.4f});
@@ -463,44 +553,39 @@ int main() try {
 
         glm::vec3 light_direction = glm::normalize(glm::vec3(std::cos(time), 1.f, std::sin(time)));
 
-        std::vector<glm::mat4x3> bones = std::vector<glm::mat4x3>(wolf_model.bones.size(), glm::mat4x3(scale));
-
-        auto run_animation = wolf_model.animations.at("01_Run");
-        auto walk_animation = wolf_model.animations.at("02_walk");
-
-        float walk_frame = fmod(time * animation_speed, walk_animation.max_time);
-        float run_frame = fmod(time * animation_speed, run_animation.max_time);
-
-        for (int i = 0; i < bones.size(); ++i) {
-            glm::mat4 transform = glm::mat4(1.f);
-            int p = i;
-            while (p != -1) {
-                auto walk_bone = walk_animation.bones[p];
-                auto run_bone = run_animation.bones[p];
-
-                auto t = walk_bone.translation(walk_frame) * (1 - interpolation) +
-                         run_bone.translation(run_frame) * interpolation;
-                auto r = walk_bone.rotation(walk_frame) * (1 - interpolation) +
-                         run_bone.rotation(run_frame) * interpolation;
-                auto s = walk_bone.scale(walk_frame) * (1 - interpolation) + run_bone.scale(run_frame) * interpolation;
+        // The first wolf where the one wolf used to be, the others spread around the ring out of step. The
+        // palettes only get rigid transforms: dual quaternions cannot hold a scale, so the herd is scaled by
+        // its model matrix (a uniform scale commutes with the ring's rotation).
+        float const herd_scale = 0.6f;
+        glm::mat4 const herd_model = glm::scale(glm::mat4(1.f), glm::vec3(herd_scale));
+        for (std::size_t i = 0; i < herd_size; ++i) {
+            auto &instance = herd.instances[i];
+            instance.time = time * animation_speed + herd_phases[i];
+            instance.weight = interpolation;
+
+            glm::mat4 transform(1.f);
+            transform = glm::rotate(transform, -time * 1.13f + 2.f * glm::pi<float>() * i / herd_size, {0.f, 1.f, 0.f});
+            transform = glm::translate(transform, {0.7f / herd_scale, 0.f, 0.f});
+            instance.transform = glm::mat4x3(transform);
+        }
+        herd.update(scheduler);
 
-                glm::mat4 translation = glm::translate(glm::mat4(1.f), t);
-                glm::mat4 rotation = glm::toMat4(r);
-                glm::mat4 scaling = glm::scale(glm::mat4(1.f), s);
-                transform = translation * rotation * scaling * transform;
+        if (dual_quaternion_skinning) {
+            herd_dual_quaternions.resize(herd.palettes().size());
+            to_dual_quaternions(herd.palettes(), herd_dual_quaternions);
+            update_buffer_texture(herd_palettes, herd_dual_quaternions.data(),
+                                  herd_dual_quaternions.size() * sizeof(herd_dual_quaternions[0]));
+        } else
+            update_buffer_texture(herd_palettes, herd.palettes().data(), herd.palettes().size_bytes());
 
-                p = wolf_model.bones[p].parent;
-            }
-            bones[i] = transform;
-        }
-        for (int i = 0; i < bones.size(); ++i) {
-            bones[i] = bones[i] * wolf_model.bones[i].inverse_bind_matrix;
-        }
+        // the locations of whichever wolf program is in use, for draw_wolf_meshes
+        auto *skinned_locations = &wolf_locations;
 
         glm::mat4 view_projection_inverse = glm::inverse(projection * view);
 
         // lambda for wolf
-        auto draw_wolf_meshes = [&](bool transparent) {
+        auto draw_wolf_meshes = [&](bool transparent, GLsizei instances) {
+            glUniform1i((*skinned_locations)["albedo"], wolf_sampler);
             for (auto const &mesh: wolf_meshes) {
                 if (mesh.material.transparent != transparent)
                     continue;
@@ -515,20 +600,20 @@ int main() try {
                 else
                     glDisable(GL_BLEND);
 
-                if (mesh.material.texture_path) {
-                    glActiveTexture(GL_TEXTURE0 + wolf_sampler);
-                    glBindTexture(GL_TEXTURE_2D, wolf_textures[*mesh.material.texture_path]);
-                    glUniform1i(wolf_locations["use_texture"], 1);
-                    glUniform1i(wolf_locations["albedo"], wolf_sampler);
-                } else if (mesh.material.color) {
-                    glUniform1i(wolf_locations["use_texture"], 0);
-                    glUniform4fv(wolf_locations["color"], 1, reinterpret_cast<const float *>(&(*mesh.material.color)));
+                if (mesh.layer >= 0)
+                    glUniform1i((*skinned_locations)["layer"], mesh.layer);
+                else if (mesh.material.color) {
+                    glUniform1i((*skinned_locations)["layer"], -1);
+                    glUniform4fv((*skinned_locations)["color"], 1, reinterpret_cast<const float *>(&(*mesh.material.color)));
                 } else
                     continue;
 
                 glBindVertexArray(mesh.vao);
-                glDrawElements(GL_TRIANGLES, mesh.indices.count, mesh.indices.type,
-                               reinterpret_cast<void *>(mesh.indices.view.offset));
+                if (mesh.indices.count == 0)
+                    glDrawArraysInstanced(mesh.mode, 0, mesh.vertex_count, instances);
+                else
+                    glDrawElementsInstanced(mesh.mode, mesh.indices.count, mesh.indices.type,
+                                            reinterpret_cast<void *>(mesh.indices.view.offset), instances);
             }
         };
 
@@ -558,9 +643,9 @@ int main() try {
         glUniformMatrix4fv(shadow_locations["model"], 1, GL_FALSE, reinterpret_cast<float *>(&lighthouse_model_mat));
         glUniformMatrix4fv(shadow_locations["transform"], 1, GL_FALSE, reinterpret_cast<float *>(&transform));
 
-        draw_wolf_meshes(false);
+        draw_wolf_meshes(false, 1);
         glDepthMask(GL_FALSE);
-        draw_wolf_meshes(true);
+        draw_wolf_meshes(true, 1);
         glDepthMask(GL_TRUE);
 
         glActiveTexture(GL_TEXTURE0 + shadow_sampler);
@@ -591,17 +676,24 @@ int main() try {
         glEnable(GL_DEPTH_TEST);
         glEnable(GL_CULL_FACE);
 
-        glUseProgram(programs["wolf"]);
-        glUniformMatrix4fv(wolf_locations["model"], 1, GL_FALSE, reinterpret_cast<float *>(&wolf_model_mat));
-        glUniformMatrix4fv(wolf_locations["view"], 1, GL_FALSE, reinterpret_cast<float *>(&view));
-        glUniformMatrix4fv(wolf_locations["projection"], 1, GL_FALSE, reinterpret_cast<float *>(&projection));
-        glUniform3fv(wolf_locations["light_direction"], 1, reinterpret_cast<float *>(&light_direction));
-        glUniformMatrix4x3fv(wolf_locations["bones"], bones.size(), GL_FALSE, reinterpret_cast<float *>(bones.data()));
-        glUniform1f(wolf_locations["brightness"], brightness);
-
-        draw_wolf_meshes(false);
+        if (dual_quaternion_skinning) {
+            glUseProgram(programs["wolf_dq"]);
+            skinned_locations = &wolf_dq_locations;
+        } else
+            glUseProgram(programs["wolf"]);
+        glActiveTexture(GL_TEXTURE0 + bones_sampler);
+        glBindTexture(GL_TEXTURE_BUFFER, herd_palettes.texture);
+        glUniform1i((*skinned_locations)["bones"], bones_sampler);
+        glUniform1i((*skinned_locations)["bone_count"], herd.bones());
+        glUniformMatrix4fv((*skinned_locations)["model"], 1, GL_FALSE, reinterpret_cast<float const *>(&herd_model));
+        glUniformMatrix4fv((*skinned_locations)["view"], 1, GL_FALSE, reinterpret_cast<float *>(&view));
+        glUniformMatrix4fv((*skinned_locations)["projection"], 1, GL_FALSE, reinterpret_cast<float *>(&projection));
+        glUniform3fv((*skinned_locations)["light_direction"], 1, reinterpret_cast<float *>(&light_direction));
+        glUniform1f((*skinned_locations)["brightness"], brightness);
+
+        draw_wolf_meshes(false, herd_size);
         glDepthMask(GL_FALSE);
-        draw_wolf_meshes(true);
+        draw_wolf_meshes(true, herd_size);
         glDepthMask(GL_TRUE);
 
         // lighthouse?
@@ -609,14 +701,20 @@ int main() try {
         glEnable(GL_CULL_FACE);
 
         glUseProgram(programs["wolf"]);
+        skinned_locations = &wolf_locations;
         glUniformMatrix4fv(wolf_locations["model"], 1, GL_FALSE, reinterpret_cast<float *>(&lighthouse_model_mat));
-        std::vector<glm::mat4x3> bones_ = std::vector<glm::mat4x3>(wolf_model.bones.size(), glm::mat4x3(1.f));
-        glUniformMatrix4x3fv(wolf_locations["bones"], bones_.size(), GL_FALSE,
-                             reinterpret_cast<float *>(bones_.data()));
+        glUniformMatrix4fv(wolf_locations["view"], 1, GL_FALSE, reinterpret_cast<float *>(&view));
+        glUniformMatrix4fv(wolf_locations["projection"], 1, GL_FALSE, reinterpret_cast<float *>(&projection));
+        glUniform3fv(wolf_locations["light_direction"], 1, reinterpret_cast<float *>(&light_direction));
+        glUniform1f(wolf_locations["brightness"], brightness);
+        glActiveTexture(GL_TEXTURE0 + bones_sampler);
+        glBindTexture(GL_TEXTURE_BUFFER, rest_palette.texture);
+        glUniform1i(wolf_locations["bones"], bones_sampler);
+        glUniform1i(wolf_locations["bone_count"], herd.bones());
 
-        draw_wolf_meshes(false);
+        draw_wolf_meshes(false, 1);
         glDepthMask(GL_FALSE);
-        draw_wolf_meshes(true);
+        draw_wolf_meshes(true, 1);
         glDepthMask(GL_TRUE);
 
 //        glUseProgram(programs["lighthouse"]);
@@ -12,6 +12,7 @@
 #include <stdexcept>
 #include <iostream>
 #include <fstream>
+#include <chrono>
 #include <vector>
 #include <map>
 
@@ -161,8 +162,11 @@ struct vec2 {
 
 struct mesh {
     GLuint vao;
+    GLenum mode;
+    GLsizei vertex_count;
     gltf_model::accessor indices;
     gltf_model::material material;
+    GLint layer; // of the material's texture in the texture array of the model, -1 for a plain colour
 };
 
 std::map<std::string, GLint> getLocations(GLuint program, const std::vector<std::string> &loc_names) {
@@ -179,36 +183,78 @@ float clamp(float value, float from = 0, float to = 1) {
 }
 
 void setup_attribute(int index, gltf_model::accessor const &accessor, bool integer = false) {
+    if (accessor.count == 0) {
+        // not in this primitive, the shader gets the constant default
+        glDisableVertexAttribArray(index);
+        return;
+    }
     glEnableVertexAttribArray(index);
     if (integer)
-        glVertexAttribIPointer(index, accessor.size, accessor.type, 0,
+        glVertexAttribIPointer(index, accessor.size, accessor.type, accessor.view.stride,
                                reinterpret_cast<void *>(accessor.view.offset));
     else
-        glVertexAttribPointer(index, accessor.size, accessor.type, GL_FALSE, 0,
-                              reinterpret_cast<void *>(accessor.view.offset));
+        glVertexAttribPointer(index, accessor.size, accessor.type, accessor.normalized ? GL_TRUE : GL_FALSE,
+                              accessor.view.stride, reinterpret_cast<void *>(accessor.view.offset));
 };
 
-GLuint create_program(std::string directory, std::string name) {
-    std::string vertex_shader_source = readFile(directory + name + ".vert");
-    std::string fragment_shader_source = readFile(directory + name + ".frag");
+GLuint create_program(std::string directory, std::string vertex_name, std::string fragment_name) {
+    std::string vertex_shader_source = readFile(directory + vertex_name + ".vert");
+    std::string fragment_shader_source = readFile(directory + fragment_name + ".frag");
     auto vertex_shader = create_shader(GL_VERTEX_SHADER, vertex_shader_source.data());
     auto fragment_shader = create_shader(GL_FRAGMENT_SHADER, fragment_shader_source.data());
     return create_program(vertex_shader, fragment_shader);
 }
 
-GLuint load_texture2D(std::string const &path) {
-    int width, height, channels;
-    auto pixels = stbi_load(path.data(), &width, &height, &channels, 4);
+GLuint create_program(std::string directory, std::string name) {
+    return create_program(directory, name, name);
+}
+
+// A buffer of RGBA32F texels, read in shaders as a samplerBuffer
+struct buffer_texture {
+    GLuint buffer = 0;
+    GLuint texture = 0;
+};
+
+buffer_texture create_buffer_texture() {
+    buffer_texture result;
+    glGenBuffers(1, &result.buffer);
+    glGenTextures(1, &result.texture);
+    glBindBuffer(GL_TEXTURE_BUFFER, result.buffer);
+    glBufferData(GL_TEXTURE_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, result.texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, result.buffer);
+    return result;
+}
+
+// Orphans the old storage before writing: draws still reading it keep it, the driver hands out a fresh one
+// instead of stalling until they are done
+void update_buffer_texture(buffer_texture const &texture, void const *data, std::size_t size) {
+    glBindBuffer(GL_TEXTURE_BUFFER, texture.buffer);
+    glBufferData(GL_TEXTURE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+}
+
+void report_load_time(std::string const &path, std::chrono::high_resolution_clock::time_point start, bool from_cache) {
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Loaded " << path << " in " << std::chrono::duration<float, std::milli>(end - start).count()
+              << " ms (" << (from_cache ? "binary cache" : "parsed") << ")" << std::endl;
+}
+
+// every level comes pre-built from the texture cache (see texture_cache.hpp), no glGenerateMipmap
+GLuint load_texture2D(std::string const &path, mip_content content = mip_content::color) {
+    auto const texture = load_texture_cached(path, content);
 
     GLuint result;
     glGenTextures(1, &result);
     glBindTexture(GL_TEXTURE_2D, result);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    for (std::size_t level = 0; level < texture.levels.size(); ++level) {
+        auto const &source = texture.levels[level];
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, source.width, source.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                     source.pixels.data());
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levels.size() - 1);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    stbi_image_free(pixels);
 
     return result;
 }
@@ -0,0 +1,90 @@
+// Offline vertex cache / vertex fetch optimization of our OBJ scenes and glTF models.
+//
+// Usage: mesh_optimize [--write-cache] [cache size] [model.gltf | scene.obj ...]
+// Without paths the wolf model is optimized. Prints ACMR and ATVR (see mesh_optimizer.hpp) for a FIFO
+// of `cache size` entries (16 by default) before and after, per OBJ group or glTF mesh and in total.
+// With --write-cache the optimized data is stored as the binary cache of the source file, which is
+// what homework3 loads from then on; the source files themselves are never touched.
+
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "mesh_optimizer.hpp"
+#include "obj_cache.hpp"
+#include "gltf_cache.hpp"
+
+namespace {
+
+    void print(std::vector<mesh_optimizer::range_report> const &reports, double ms) {
+        std::size_t triangles = 0;
+        mesh_optimizer::vertex_cache_stats before, after;
+        for (auto const &report: reports) {
+            if (reports.size() <= 16) // scenes with hundreds of groups only get the total
+                std::cout << "  " << (report.name.empty() ? "<no group>" : report.name) << ", " << report.triangles
+                          << " triangles: ACMR " << report.before.acmr << " -> " << report.after.acmr
+                          << ", ATVR " << report.before.atvr << " -> " << report.after.atvr
+                          << (report.fetch_optimized ? "" : ", vertex order kept") << std::endl;
+
+            // triangle-weighted, like the ratios of one big index buffer
+            triangles += report.triangles;
+            before.acmr += report.before.acmr * report.triangles;
+            before.atvr += report.before.atvr * report.triangles;
+            after.acmr += report.after.acmr * report.triangles;
+            after.atvr += report.after.atvr * report.triangles;
+        }
+        if (triangles == 0)
+            return;
+
+        std::cout << "  total, " << triangles << " triangles: ACMR " << before.acmr / triangles << " -> "
+                  << after.acmr / triangles << ", ATVR " << before.atvr / triangles << " -> "
+                  << after.atvr / triangles << " (" << ms << " ms)" << std::endl;
+    }
+
+    double elapsed_ms(std::chrono::high_resolution_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+}
+
+int main(int argc, char *argv[]) try {
+    bool write_cache = false;
+    unsigned cache_size = 16;
+    std::vector<std::filesystem::path> paths;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--write-cache") == 0)
+            write_cache = true;
+        else if (std::isdigit(static_cast<unsigned char>(argv[i][0])))
+            cache_size = std::stoi(argv[i]);
+        else
+            paths.emplace_back(argv[i]);
+    }
+    if (paths.empty())
+        paths.emplace_back(std::string(PROJECT_ROOT) + "/external/wolf/Wolf-Blender-2.82a.gltf");
+
+    for (auto const &path: paths) {
+        std::cout << path.string() << ":" << std::endl;
+
+        if (path.extension() == ".obj") {
+            auto data = obj_parser::parse_obj(path);
+            auto start = std::chrono::high_resolution_clock::now();
+            auto reports = mesh_optimizer::optimize(data, cache_size);
+            print(reports, elapsed_ms(start));
+            if (write_cache)
+                obj_parser::write_obj_cache(path, data);
+        } else {
+            auto model = load_gltf(path);
+            auto start = std::chrono::high_resolution_clock::now();
+            auto reports = mesh_optimizer::optimize(model, cache_size);
+            print(reports, elapsed_ms(start));
+            if (write_cache)
+                write_gltf_cache(path, model);
+        }
+    }
+}
+catch (std::exception const &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,317 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+namespace mesh_optimizer {
+    namespace {
+        constexpr std::uint32_t unused = ~0u;
+
+        // Forsyth's scoring: recently used vertices and vertices with few triangles left win
+        constexpr unsigned max_cache_size = 32;
+        constexpr unsigned max_valence = 32;
+
+        struct score_tables {
+            float cache[max_cache_size + 3];
+            float valence[max_valence + 1];
+
+            score_tables() {
+                for (unsigned i = 0; i < max_cache_size + 3; ++i) {
+                    if (i < 3)
+                        cache[i] = 0.75f; // the last triangle: no reason to prefer its order
+                    else if (i < max_cache_size)
+                        cache[i] = std::pow(1.f - float(i - 3) / (max_cache_size - 3), 1.5f);
+                    else
+                        cache[i] = 0.f;
+                }
+                valence[0] = 0.f;
+                for (unsigned i = 1; i <= max_valence; ++i)
+                    valence[i] = 2.f / std::sqrt(float(i));
+            }
+        };
+
+        score_tables const scores;
+
+        float vertex_score(int cache_position, std::uint32_t remaining) {
+            if (remaining == 0)
+                return -1.f; // nothing left to draw with it
+            float score = scores.valence[std::min(remaining, max_valence)];
+            if (cache_position >= 0)
+                score += scores.cache[cache_position];
+            return score;
+        }
+
+        template <typename T>
+        void copy_indices(char const *data, std::vector<std::uint32_t> &indices) {
+            for (std::size_t i = 0; i < indices.size(); ++i) {
+                T index;
+                std::memcpy(&index, data + i * sizeof(T), sizeof(T));
+                indices[i] = index;
+            }
+        }
+
+        template <typename T>
+        void store_indices(std::vector<std::uint32_t> const &indices, char *data) {
+            for (std::size_t i = 0; i < indices.size(); ++i) {
+                T index = static_cast<T>(indices[i]);
+                std::memcpy(data + i * sizeof(T), &index, sizeof(T));
+            }
+        }
+    }
+
+    vertex_cache_stats analyze_vertex_cache(std::span<std::uint32_t const> indices, std::size_t vertex_count,
+                                            unsigned cache_size) {
+        vertex_cache_stats result;
+        if (indices.empty())
+            return result;
+
+        // a vertex is in the FIFO iff fewer than cache_size misses happened since it was loaded
+        std::vector<std::size_t> loaded_at(vertex_count, 0);
+        std::vector<bool> referenced(vertex_count, false);
+        std::size_t misses = 0, unique = 0;
+        for (auto index: indices) {
+            if (loaded_at[index] == 0 || misses - loaded_at[index] >= cache_size) {
+                ++misses;
+                loaded_at[index] = misses;
+            }
+            if (!referenced[index]) {
+                referenced[index] = true;
+                ++unique;
+            }
+        }
+
+        result.acmr = double(misses) / (indices.size() / 3);
+        result.atvr = double(misses) / unique;
+        return result;
+    }
+
+    void optimize_vertex_cache(std::span<std::uint32_t> indices, std::size_t vertex_count) {
+        std::size_t const triangle_count = indices.size() / 3;
+        if (triangle_count == 0)
+            return;
+
+        // live triangles of every vertex, as CSR
+        std::vector<std::uint32_t> remaining(vertex_count, 0);
+        for (auto index: indices)
+            ++remaining[index];
+
+        std::vector<std::uint32_t> offsets(vertex_count + 1, 0);
+        for (std::size_t v = 0; v < vertex_count; ++v)
+            offsets[v + 1] = offsets[v] + remaining[v];
+
+        std::vector<std::uint32_t> adjacency(indices.size());
+        {
+            std::vector<std::uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (std::size_t i = 0; i < indices.size(); ++i)
+                adjacency[fill[indices[i]]++] = i / 3;
+        }
+
+        std::vector<int> cache_position(vertex_count, -1);
+        std::vector<float> vertex_scores(vertex_count);
+        for (std::size_t v = 0; v < vertex_count; ++v)
+            vertex_scores[v] = vertex_score(-1, remaining[v]);
+
+        std::vector<float> triangle_scores(triangle_count);
+        for (std::size_t t = 0; t < triangle_count; ++t)
+            triangle_scores[t] = vertex_scores[indices[3 * t]] + vertex_scores[indices[3 * t + 1]] +
+                                 vertex_scores[indices[3 * t + 2]];
+
+        std::vector<bool> emitted(triangle_count, false);
+        std::vector<std::uint32_t> result;
+        result.reserve(indices.size());
+
+        std::vector<std::uint32_t> cache, next_cache;
+        cache.reserve(max_cache_size + 3);
+        next_cache.reserve(max_cache_size + 3);
+
+        std::size_t best = std::max_element(triangle_scores.begin(), triangle_scores.end()) - triangle_scores.begin();
+        std::size_t scan = 0; // every triangle before it was emitted
+
+        while (true) {
+            std::uint32_t const *triangle = &indices[3 * best];
+            result.insert(result.end(), triangle, triangle + 3);
+            emitted[best] = true;
+
+            for (int k = 0; k < 3; ++k) {
+                auto v = triangle[k];
+                auto begin = adjacency.begin() + offsets[v];
+                auto end = begin + remaining[v];
+                std::iter_swap(std::find(begin, end, best), end - 1);
+                --remaining[v];
+            }
+
+            // the triangle's vertices move to the front, the rest shifts back and may fall out
+            next_cache.assign(triangle, triangle + 3);
+            for (auto v: cache)
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                    next_cache.push_back(v);
+            std::swap(cache, next_cache);
+
+            for (std::size_t i = 0; i < cache.size(); ++i) {
+                auto v = cache[i];
+                cache_position[v] = i < max_cache_size ? int(i) : -1;
+                vertex_scores[v] = vertex_score(cache_position[v], remaining[v]);
+            }
+
+            // the best candidate is among the triangles touching the (old and new) cache
+            best = triangle_count;
+            float best_score = -1.f;
+            for (auto v: cache)
+                for (std::uint32_t i = offsets[v]; i < offsets[v] + remaining[v]; ++i) {
+                    auto t = adjacency[i];
+                    triangle_scores[t] = vertex_scores[indices[3 * t]] + vertex_scores[indices[3 * t + 1]] +
+                                         vertex_scores[indices[3 * t + 2]];
+                    if (triangle_scores[t] > best_score) {
+                        best_score = triangle_scores[t];
+                        best = t;
+                    }
+                }
+
+            if (cache.size() > max_cache_size)
+                cache.resize(max_cache_size);
+
+            if (best == triangle_count) {
+                // dead end, continue with the next triangle in the original order
+                while (scan < triangle_count && emitted[scan])
+                    ++scan;
+                if (scan == triangle_count)
+                    break;
+                best = scan;
+            }
+        }
+
+        std::copy(result.begin(), result.end(), indices.begin());
+    }
+
+    std::vector<std::uint32_t> optimize_vertex_fetch(std::span<std::uint32_t> indices, std::size_t vertex_count) {
+        std::vector<std::uint32_t> remap(vertex_count, unused);
+        std::uint32_t next = 0;
+        for (auto &index: indices) {
+            if (remap[index] == unused)
+                remap[index] = next++;
+            index = remap[index];
+        }
+        for (auto &index: remap)
+            if (index == unused)
+                index = next++;
+        return remap;
+    }
+
+    void remap_vertices(void *data, std::size_t count, std::size_t stride, std::vector<std::uint32_t> const &remap) {
+        auto bytes = static_cast<char *>(data);
+        std::vector<char> copy(bytes, bytes + count * stride);
+        for (std::size_t i = 0; i < count; ++i)
+            std::memcpy(bytes + remap[i] * stride, copy.data() + i * stride, stride);
+    }
+
+    std::vector<range_report> optimize(obj_parser::obj_data &data, unsigned cache_size) {
+        // groups only remember where they start, ranges end at the next group's offset
+        std::vector<std::pair<std::uint32_t, std::string>> starts{{0, ""}};
+        for (auto const &group: data.groups)
+            starts.emplace_back(group.offset, group.material.name);
+        std::stable_sort(starts.begin(), starts.end(),
+                         [](auto const &a, auto const &b) { return a.first < b.first; });
+
+        std::vector<range_report> result;
+        for (std::size_t i = 0; i < starts.size(); ++i) {
+            std::size_t begin = starts[i].first;
+            std::size_t end = i + 1 < starts.size() ? starts[i + 1].first : data.indices.size();
+            if (begin == end)
+                continue;
+
+            std::span<std::uint32_t> range(data.indices.data() + begin, end - begin);
+
+            auto &report = result.emplace_back();
+            report.name = starts[i].second;
+            report.triangles = range.size() / 3;
+            report.before = analyze_vertex_cache(range, data.vertices.size(), cache_size);
+            optimize_vertex_cache(range, data.vertices.size());
+            report.after = analyze_vertex_cache(range, data.vertices.size(), cache_size);
+            report.fetch_optimized = true;
+        }
+
+        auto remap = optimize_vertex_fetch(data.indices, data.vertices.size());
+        remap_vertices(data.vertices.data(), data.vertices.size(), sizeof(data.vertices[0]), remap);
+
+        return result;
+    }
+
+    std::vector<range_report> optimize(gltf_model &model, unsigned cache_size) {
+        // a .glb is mapped read-only, work on a copy of its BIN chunk
+        if (model.file) {
+            auto binary = model.binary();
+            model.buffer.assign(binary.begin(), binary.end());
+            model.file.reset();
+            model.binary_chunk = {};
+        }
+
+        std::map<unsigned int, int> view_users;
+        for (auto const &mesh: model.meshes)
+            for (auto const *accessor: {&mesh.position, &mesh.normal, &mesh.texcoord, &mesh.joints, &mesh.weights})
+                if (accessor->count != 0)
+                    ++view_users[accessor->view.offset];
+
+        std::vector<range_report> result;
+        for (auto &mesh: model.meshes) {
+            if (mesh.indices.count == 0 || mesh.mode != 4) // only indexed GL_TRIANGLES
+                continue;
+
+            auto &report = result.emplace_back();
+            report.name = mesh.name;
+
+            std::vector<std::uint32_t> indices(mesh.indices.count);
+            char *index_data = model.buffer.data() + mesh.indices.view.offset;
+            switch (mesh.indices.type) {
+                case 0x1401: // GL_UNSIGNED_BYTE
+                    copy_indices<std::uint8_t>(index_data, indices);
+                    break;
+                case 0x1403: // GL_UNSIGNED_SHORT
+                    copy_indices<std::uint16_t>(index_data, indices);
+                    break;
+                case 0x1405: // GL_UNSIGNED_INT
+                    copy_indices<std::uint32_t>(index_data, indices);
+                    break;
+                default:
+                    throw std::runtime_error("Unsupported index type for mesh " + mesh.name);
+            }
+
+            std::size_t const vertex_count = mesh.position.count;
+            report.triangles = indices.size() / 3;
+            report.before = analyze_vertex_cache(indices, vertex_count, cache_size);
+            optimize_vertex_cache(indices, vertex_count);
+            report.after = analyze_vertex_cache(indices, vertex_count, cache_size);
+
+            bool packed = true;
+            for (auto const *accessor: {&mesh.position, &mesh.normal, &mesh.texcoord, &mesh.joints, &mesh.weights})
+                packed = packed && (accessor->count == 0 ||
+                                    (accessor->count == vertex_count && view_users[accessor->view.offset] == 1 &&
+                                     accessor->stride() == accessor->element_size() &&
+                                     accessor->view.size == accessor->count * accessor->element_size()));
+
+            if (packed) {
+                auto remap = optimize_vertex_fetch(indices, vertex_count);
+                for (auto const *accessor: {&mesh.position, &mesh.normal, &mesh.texcoord, &mesh.joints, &mesh.weights})
+                    if (accessor->count != 0)
+                        remap_vertices(model.buffer.data() + accessor->view.offset, vertex_count,
+                                       accessor->element_size(), remap);
+                report.fetch_optimized = true;
+            }
+
+            switch (mesh.indices.type) {
+                case 0x1401:
+                    store_indices<std::uint8_t>(indices, index_data);
+                    break;
+                case 0x1403:
+                    store_indices<std::uint16_t>(indices, index_data);
+                    break;
+                case 0x1405:
+                    store_indices<std::uint32_t>(indices, index_data);
+                    break;
+            }
+        }
+        return result;
+    }
+}
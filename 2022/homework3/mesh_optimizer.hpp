@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "obj_parser.hpp"
+#include "gltf_loader.hpp"
+
+namespace mesh_optimizer {
+    struct vertex_cache_stats {
+        double acmr = 0.0; // average cache miss ratio: transformed vertices per triangle, 0.5 at best
+        double atvr = 0.0; // average transform to vertex ratio: transformed per referenced vertex, 1 at best
+    };
+
+    // Simulates a FIFO post-transform cache of `cache_size` entries over a triangle list.
+    vertex_cache_stats analyze_vertex_cache(std::span<std::uint32_t const> indices, std::size_t vertex_count,
+                                            unsigned cache_size = 16);
+
+    // Reorders the triangles of a triangle list for post-transform cache reuse (Forsyth's linear-speed
+    // greedy algorithm). The set of triangles and their winding stay the same.
+    void optimize_vertex_cache(std::span<std::uint32_t> indices, std::size_t vertex_count);
+
+    // Renumbers vertices in order of first use, so the vertex fetch walks the buffer forwards. Rewrites
+    // `indices` and returns the old -> new vertex index table; unreferenced vertices go last.
+    std::vector<std::uint32_t> optimize_vertex_fetch(std::span<std::uint32_t> indices, std::size_t vertex_count);
+
+    // Moves element i of `count` tightly packed `stride`-byte elements to remap[i].
+    void remap_vertices(void *data, std::size_t count, std::size_t stride, std::vector<std::uint32_t> const &remap);
+
+    struct range_report {
+        std::string name;
+        std::size_t triangles = 0;
+        vertex_cache_stats before;
+        vertex_cache_stats after;
+        bool fetch_optimized = false;
+    };
+
+    // Reorders the triangles of every group (groups keep their index ranges), then the vertices.
+    std::vector<range_report> optimize(obj_parser::obj_data &data, unsigned cache_size = 16);
+
+    // Same for every mesh of a glTF model, in place in model.buffer (a mapped .glb is copied there first).
+    // Vertex reordering is skipped for meshes whose attributes are interleaved or shared with another
+    // mesh. Attributes gltf_model does not load (e.g. TEXCOORD_1) are left as they are.
+    std::vector<range_report> optimize(gltf_model &model, unsigned cache_size = 16);
+}
@@ -0,0 +1,203 @@
+// Mip chain benchmark.
+//
+// Usage: mip_benchmark [max threads] [image...]
+// For every image (the wolf textures and the snow normal map by default, files with "normal" in their name
+// are filtered as normal maps) prints the time to decode it, which is all the CPU does on the old path
+// before glTexImage2D and glGenerateMipmap, the time the streamer took to build its chain with an 8-bit box
+// filter, the time of generate_mip_chain with 1, 2, 4... threads up to `max threads` (the hardware threads
+// by default), and the time to map the whole chain back from the texture cache. The largest error of both
+// filters against a double precision, gamma-correct reference is printed in 8-bit steps, over all levels.
+// glGenerateMipmap itself needs a GL context and is not measured.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "mip_chain.hpp"
+#include "texture_cache.hpp"
+#include "binary_cache.hpp"
+#include "job_scheduler.hpp"
+#include "stb_image.h"
+
+namespace {
+
+    template <typename Function>
+    double average_ms(int iterations, Function &&function) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            function();
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    }
+
+    struct image {
+        std::uint32_t width = 0;
+        std::uint32_t height = 0;
+        std::vector<std::uint8_t> pixels;
+    };
+
+    image decode(std::string const &path) {
+        int width, height, channels;
+        auto pixels = stbi_load(path.data(), &width, &height, &channels, 4);
+        if (!pixels)
+            throw std::runtime_error("Failed to load " + path);
+        image result{std::uint32_t(width), std::uint32_t(height),
+                     std::vector<std::uint8_t>(pixels, pixels + std::size_t(width) * height * 4)};
+        stbi_image_free(pixels);
+        return result;
+    }
+
+    // what texture_streamer did: the 2x2 box of the stored 8-bit values, rounded at every level
+    std::vector<mip_level> box_chain(image const &source) {
+        std::vector<mip_level> levels{{source.width, source.height, source.pixels}};
+        while (levels.back().width > 1 || levels.back().height > 1) {
+            auto const &above = levels.back();
+            mip_level next{std::max(1u, above.width / 2), std::max(1u, above.height / 2), {}};
+            next.pixels.resize(std::size_t(next.width) * next.height * 4);
+            for (std::uint32_t y = 0; y < next.height; ++y) {
+                std::uint32_t const y0 = std::min(2 * y, above.height - 1), y1 = std::min(2 * y + 1, above.height - 1);
+                for (std::uint32_t x = 0; x < next.width; ++x) {
+                    std::uint32_t const x0 = std::min(2 * x, above.width - 1), x1 = std::min(2 * x + 1, above.width - 1);
+                    for (int c = 0; c < 4; ++c) {
+                        unsigned int const sum = above.pixels[(std::size_t(y0) * above.width + x0) * 4 + c]
+                                                 + above.pixels[(std::size_t(y0) * above.width + x1) * 4 + c]
+                                                 + above.pixels[(std::size_t(y1) * above.width + x0) * 4 + c]
+                                                 + above.pixels[(std::size_t(y1) * above.width + x1) * 4 + c];
+                        next.pixels[(std::size_t(y) * next.width + x) * 4 + c] = (sum + 2) / 4;
+                    }
+                }
+            }
+            levels.push_back(std::move(next));
+        }
+        return levels;
+    }
+
+    double to_linear(double value) {
+        return value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4);
+    }
+
+    double to_srgb(double value) {
+        return value <= 0.0031308 ? value * 12.92 : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055;
+    }
+
+    // the levels as generate_mip_chain means them, in double and without rounding in between, 0..255
+    std::vector<std::vector<double>> reference_chain(image const &source, mip_content content) {
+        std::uint32_t width = source.width, height = source.height;
+        std::vector<double> level(source.pixels.size());
+        for (std::size_t i = 0; i < level.size(); ++i) {
+            double const value = source.pixels[i] / 255.0;
+            level[i] = i % 4 == 3 || content == mip_content::linear ? value
+                       : content == mip_content::color ? to_linear(value) : value * 2.0 - 1.0;
+        }
+
+        std::vector<std::vector<double>> result;
+        while (width > 1 || height > 1) {
+            std::uint32_t const next_width = std::max(1u, width / 2), next_height = std::max(1u, height / 2);
+            std::vector<double> next(std::size_t(next_width) * next_height * 4);
+            for (std::uint32_t y = 0; y < next_height; ++y)
+                for (std::uint32_t x = 0; x < next_width; ++x) {
+                    std::uint32_t const ys[2]{std::min(2 * y, height - 1), std::min(2 * y + 1, height - 1)};
+                    std::uint32_t const xs[2]{std::min(2 * x, width - 1), std::min(2 * x + 1, width - 1)};
+                    double *out = next.data() + (std::size_t(y) * next_width + x) * 4;
+                    for (auto sy: ys)
+                        for (auto sx: xs)
+                            for (int c = 0; c < 4; ++c)
+                                out[c] += level[(std::size_t(sy) * width + sx) * 4 + c] / 4.0;
+                    if (content == mip_content::normal_map) {
+                        double const length = std::sqrt(out[0] * out[0] + out[1] * out[1] + out[2] * out[2]);
+                        for (int c = 0; c < 3; ++c)
+                            out[c] = length > 0.0 ? out[c] / length : c == 2;
+                    }
+                }
+            level = std::move(next);
+            width = next_width;
+            height = next_height;
+
+            auto &encoded = result.emplace_back(level.size());
+            for (std::size_t i = 0; i < level.size(); ++i) {
+                double const value = i % 4 == 3 || content == mip_content::linear ? level[i]
+                                     : content == mip_content::color ? to_srgb(level[i]) : level[i] * 0.5 + 0.5;
+                encoded[i] = std::clamp(value, 0.0, 1.0) * 255.0;
+            }
+        }
+        return result;
+    }
+
+    double max_error(std::vector<mip_level> const &levels, std::vector<std::vector<double>> const &reference) {
+        double result = 0.0;
+        for (std::size_t l = 1; l < levels.size(); ++l)
+            for (std::size_t i = 0; i < levels[l].pixels.size(); ++i)
+                result = std::max(result, std::abs(levels[l].pixels[i] - reference[l - 1][i]));
+        return result;
+    }
+
+    bool same_levels(std::vector<mip_level> const &a, std::vector<mip_level> const &b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](mip_level const &x, mip_level const &y) {
+            return x.width == y.width && x.height == y.height && x.pixels == y.pixels;
+        });
+    }
+
+}
+
+int main(int argc, char *argv[]) try {
+    unsigned int const max_threads = argc > 1 ? std::stoi(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<std::string> paths(argv + std::min(argc, 2), argv + argc);
+    if (paths.empty())
+        for (auto name: {"/external/wolf/Material__wolf_col_tga_diffuse.jpg",
+                         "/external/wolf/Fur_Col_20-Fur_Alpha_3_png.png",
+                         "/external/wolf/eyes_diffuse.jpg",
+                         "/external/snow_normal.png"})
+            paths.push_back(std::string(PROJECT_ROOT) + name);
+
+    for (auto const &path: paths) {
+        auto const content = std::filesystem::path(path).filename().string().find("normal") != std::string::npos
+                             ? mip_content::normal_map : mip_content::color;
+
+        image source;
+        double const decode_ms = average_ms(1, [&] { source = decode(path); });
+        int const iterations = std::max<int>(1, (1 << 22) / source.pixels.size());
+
+        std::cout << path << ": " << source.width << "x" << source.height
+                  << (content == mip_content::normal_map ? ", normal map" : ", colour") << std::endl;
+        std::cout << "    decode (old path, then glGenerateMipmap): " << decode_ms << " ms" << std::endl;
+
+        std::vector<mip_level> box;
+        double const box_ms = average_ms(iterations, [&] { box = box_chain(source); });
+
+        std::vector<mip_level> reference_levels;
+        std::cout << "    8-bit box chain:            " << box_ms << " ms" << std::endl;
+        for (unsigned int threads = 1; threads <= max_threads; threads = threads < max_threads ? std::min(threads * 2, max_threads) : threads + 1) {
+            job_scheduler scheduler(threads);
+            std::vector<mip_level> levels;
+            double const ms = average_ms(iterations, [&] {
+                levels = generate_mip_chain(source.pixels.data(), source.width, source.height, content, &scheduler);
+            });
+            if (reference_levels.empty())
+                reference_levels = levels;
+            else if (!same_levels(levels, reference_levels))
+                throw std::runtime_error("Different levels with " + std::to_string(threads) + " threads");
+            std::cout << "    generate_mip_chain, " << threads << " thread" << (threads > 1 ? "s: " : ":  ")
+                      << ms << " ms" << std::endl;
+        }
+
+        auto const reference = reference_chain(source, content);
+        std::cout << "    largest error, 8-bit box:   " << max_error(box, reference) << std::endl;
+        std::cout << "    largest error, generated:   " << max_error(reference_levels, reference) << std::endl;
+
+        write_texture_cache(path, content, reference_levels);
+        cached_texture cached;
+        double const map_ms = average_ms(iterations, [&] { cached = load_texture_cached(path, content); });
+        if (!cached.from_cache)
+            throw std::runtime_error("Texture cache not used for " + path);
+        std::cout << "    map from the texture cache: " << map_ms << " ms, "
+                  << std::filesystem::file_size(binary_cache::cache_path(path)) / 1024 << " KiB, "
+                  << cached.levels.size() << " levels" << std::endl;
+    }
+} catch (std::exception const &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,197 @@
+#include "mip_chain.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIP_CHAIN_SSE2
+#endif
+
+// a level in linear float, 4 per texel
+struct float_level
+{
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::vector<float> texels;
+};
+
+// fine enough that every 8-bit value comes back out where it went in
+static constexpr int encode_table_size = 1 << 14;
+
+struct conversion_tables
+{
+    std::array<std::array<float, 256>, 3> decode;           // 8 bits to the values averaged, per mip_content
+    std::array<std::uint8_t, encode_table_size> encode;     // linear * (encode_table_size - 1) to sRGB 8 bits
+};
+
+static conversion_tables const & tables()
+{
+    static conversion_tables const result = []
+    {
+        conversion_tables tables;
+        for (int i = 0; i < 256; ++i)
+        {
+            float const value = i / 255.f;
+            tables.decode[int(mip_content::color)][i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+            tables.decode[int(mip_content::linear)][i] = value;
+            tables.decode[int(mip_content::normal_map)][i] = value * 2.f - 1.f;
+        }
+        for (int i = 0; i < encode_table_size; ++i)
+        {
+            float const value = float(i) / (encode_table_size - 1);
+            float const encoded = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+            tables.encode[i] = static_cast<std::uint8_t>(std::lround(std::clamp(encoded, 0.f, 1.f) * 255.f));
+        }
+        return tables;
+    }();
+    return result;
+}
+
+static void for_rows(std::uint32_t rows, job_scheduler * scheduler, std::function<void(std::size_t, std::size_t)> const & function)
+{
+    if (scheduler)
+        scheduler->parallel_for(rows, 16, [&](std::size_t begin, std::size_t end, unsigned int) { function(begin, end); });
+    else
+        function(0, rows);
+}
+
+static void encode(float const * texels, std::uint8_t * pixels, std::size_t count, mip_content content)
+{
+    auto const & encode_table = tables().encode;
+    auto const to_byte = [](float value) { return static_cast<std::uint8_t>(std::clamp(value, 0.f, 1.f) * 255.f + 0.5f); };
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        float const * t = texels + 4 * i;
+        std::uint8_t * p = pixels + 4 * i;
+        for (int c = 0; c < 3; ++c)
+        {
+            switch (content)
+            {
+            case mip_content::color:
+                p[c] = encode_table[static_cast<int>(std::clamp(t[c], 0.f, 1.f) * (encode_table_size - 1) + 0.5f)];
+                break;
+            case mip_content::linear:
+                p[c] = to_byte(t[c]);
+                break;
+            case mip_content::normal_map:
+                p[c] = to_byte(t[c] * 0.5f + 0.5f);
+                break;
+            }
+        }
+        p[3] = to_byte(t[3]);
+    }
+}
+
+static void normalize(float * n)
+{
+    float const length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length > 0.f)
+        for (int c = 0; c < 3; ++c)
+            n[c] /= length;
+    else
+    {
+        n[0] = n[1] = 0.f;
+        n[2] = 1.f;
+    }
+}
+
+// rows [begin, end) of the level below the 8-bit `pixels`, decoded on the fly so that the full size level
+// is never held in floats
+static void downsample(std::uint8_t const * pixels, std::uint32_t width, std::uint32_t height, mip_content content,
+    float_level & result, std::size_t begin, std::size_t end)
+{
+    auto const & values = tables().decode[int(content)];
+    auto const & alpha = tables().decode[int(mip_content::linear)];
+    for (std::size_t y = begin; y < end; ++y)
+    {
+        std::uint8_t const * row0 = pixels + std::size_t(std::min<std::uint32_t>(2 * y, height - 1)) * width * 4;
+        std::uint8_t const * row1 = pixels + std::size_t(std::min<std::uint32_t>(2 * y + 1, height - 1)) * width * 4;
+        float * out = result.texels.data() + y * result.width * 4;
+
+        for (std::uint32_t x = 0; x < result.width; ++x)
+        {
+            std::uint8_t const * texels[4]{row0 + std::min<std::uint32_t>(2 * x, width - 1) * 4, row0 + std::min<std::uint32_t>(2 * x + 1, width - 1) * 4,
+                row1 + std::min<std::uint32_t>(2 * x, width - 1) * 4, row1 + std::min<std::uint32_t>(2 * x + 1, width - 1) * 4};
+#ifdef MIP_CHAIN_SSE2
+            __m128 sum = _mm_setzero_ps();
+            for (auto p : texels)
+                sum = _mm_add_ps(sum, _mm_set_ps(alpha[p[3]], values[p[2]], values[p[1]], values[p[0]]));
+            _mm_storeu_ps(out + 4 * x, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+            for (int c = 0; c < 4; ++c)
+            {
+                auto const & table = c == 3 ? alpha : values;
+                out[4 * x + c] = (table[texels[0][c]] + table[texels[1][c]] + table[texels[2][c]] + table[texels[3][c]]) * 0.25f;
+            }
+#endif
+            if (content == mip_content::normal_map)
+                normalize(out + 4 * x);
+        }
+    }
+}
+
+// rows [begin, end) of the level below `source`
+static void downsample(float_level const & source, float_level & result, std::size_t begin, std::size_t end, bool renormalize)
+{
+    std::uint32_t const width = source.width;
+    for (std::size_t y = begin; y < end; ++y)
+    {
+        float const * row0 = source.texels.data() + std::size_t(std::min<std::uint32_t>(2 * y, source.height - 1)) * width * 4;
+        float const * row1 = source.texels.data() + std::size_t(std::min<std::uint32_t>(2 * y + 1, source.height - 1)) * width * 4;
+        float * out = result.texels.data() + y * result.width * 4;
+
+        for (std::uint32_t x = 0; x < result.width; ++x)
+        {
+            std::size_t const x0 = std::min<std::uint32_t>(2 * x, width - 1) * 4;
+            std::size_t const x1 = std::min<std::uint32_t>(2 * x + 1, width - 1) * 4;
+#ifdef MIP_CHAIN_SSE2
+            __m128 const sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)),
+                _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+            _mm_storeu_ps(out + 4 * x, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+            for (int c = 0; c < 4; ++c)
+                out[4 * x + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+#endif
+            if (renormalize)
+                normalize(out + 4 * x);
+        }
+    }
+}
+
+std::vector<mip_level> generate_mip_chain(std::uint8_t const * pixels, std::uint32_t width, std::uint32_t height,
+    mip_content content, job_scheduler * scheduler)
+{
+    std::vector<mip_level> result;
+    result.push_back({width, height, std::vector<std::uint8_t>(pixels, pixels + std::size_t(width) * height * 4)});
+    if (width == 0 || height == 0)
+        return result;
+
+    // only two float levels at a time, the one being read and the one being written, and none at full size
+    float_level current, next;
+    while (result.back().width > 1 || result.back().height > 1)
+    {
+        auto const & above = result.back();
+        next.width = std::max(1u, above.width / 2);
+        next.height = std::max(1u, above.height / 2);
+        next.texels.resize(std::size_t(next.width) * next.height * 4);
+
+        mip_level level{next.width, next.height, std::vector<std::uint8_t>(next.texels.size())};
+        for_rows(next.height, scheduler, [&](std::size_t begin, std::size_t end)
+        {
+            if (result.size() == 1)
+                downsample(pixels, width, height, content, next, begin, end);
+            else
+                downsample(current, next, begin, end, content == mip_content::normal_map);
+            encode(next.texels.data() + begin * next.width * 4, level.pixels.data() + begin * next.width * 4,
+                (end - begin) * next.width, content);
+        });
+
+        result.push_back(std::move(level));
+        std::swap(current, next);
+    }
+
+    return result;
+}
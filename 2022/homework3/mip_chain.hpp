@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "job_scheduler.hpp"
+
+// How the texels of a texture are to be averaged
+enum class mip_content : std::uint32_t
+{
+    color,      // sRGB encoded colour (alpha linear), averaged as linear light
+    linear,     // averaged as they are
+    normal_map, // xyz in [-1, 1] as [0, 255], averaged and renormalized
+};
+
+struct mip_level
+{
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::vector<std::uint8_t> pixels;   // RGBA8
+};
+
+// Every level of an RGBA8 texture, from the full size one (a copy of `pixels`) down to 1x1, each half the
+// size of the one above with its texels the average of a 2x2 box there (the last row or column repeated
+// for odd sizes). The levels are averaged in linear float, 4 channels to an SSE register where available,
+// and rounded to 8 bits once, so errors do not pile up down the chain. Rows are split over the threads of
+// `scheduler` if there is one.
+std::vector<mip_level> generate_mip_chain(std::uint8_t const * pixels, std::uint32_t width, std::uint32_t height,
+    mip_content content, job_scheduler * scheduler = nullptr);
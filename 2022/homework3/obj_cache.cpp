@@ -0,0 +1,144 @@
+#include "obj_cache.hpp"
+#include "binary_cache.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+namespace obj_parser {
+    namespace {
+        constexpr std::array<char, 8> magic{'O', 'B', 'J', 'C', 'A', 'C', 'H', 'E'};
+        // bump whenever obj_data or the record layout below changes
+        constexpr std::uint32_t version = 2;
+
+        struct group_record {
+            std::uint32_t offset;
+            std::uint32_t count;
+            std::array<float, 3> glossiness;
+            float roughness;
+        };
+
+        // only needed when (re)building the cache: the names on the mtllib lines, first word only as
+        // parse_obj reads them, so that the .mtl files are part of the cache key
+        std::vector<std::string> mtllib_names(std::filesystem::path const &path) {
+            mapped_file file(path);
+            std::string_view const text = file.view();
+
+            std::vector<std::string> result;
+            for (std::size_t begin = 0; begin < text.size();) {
+                std::size_t const end = std::min(text.find('\n', begin), text.size());
+                auto line = text.substr(begin, end - begin);
+                begin = end + 1;
+
+                line.remove_prefix(std::min(line.find_first_not_of(" \t\r"), line.size()));
+                if (line.size() <= 6 || line.substr(0, 6) != "mtllib" || (line[6] != ' ' && line[6] != '\t'))
+                    continue;
+                line.remove_prefix(6);
+                line.remove_prefix(std::min(line.find_first_not_of(" \t"), line.size()));
+                auto const name = line.substr(0, line.find_first_of(" \t\r"));
+                if (!name.empty() && std::find(result.begin(), result.end(), name) == result.end())
+                    result.emplace_back(name);
+            }
+            return result;
+        }
+
+        // a missing .mtl has a key too (all zeros): parse_obj goes without its materials, and the cache
+        // is rebuilt once it appears
+        binary_cache::source_key mtl_key(std::filesystem::path const &path, std::string_view name) {
+            std::filesystem::path mtl_path = path.parent_path();
+            mtl_path += "/" + std::string(name);
+            return std::filesystem::exists(mtl_path) ? binary_cache::make_key(mtl_path) : binary_cache::source_key{};
+        }
+
+        void write_cache(std::filesystem::path const &path, binary_cache::source_key const &key,
+                         std::vector<std::string> const &mtllibs, obj_data const &data) {
+            binary_cache::writer writer(magic, version);
+            writer.write(key);
+            writer.write<std::uint32_t>(mtllibs.size());
+            for (auto const &name: mtllibs) {
+                writer.write_string(name);
+                writer.write(mtl_key(path, name));
+            }
+            writer.write<std::uint32_t>(sizeof(obj_data::vertex));
+            writer.write_array(data.vertices);
+            writer.write_array(data.indices);
+
+            writer.write<std::uint64_t>(data.groups.size());
+            for (auto const &group: data.groups) {
+                writer.write(group_record{group.offset, group.count, group.material.glossiness,
+                                          group.material.roughness});
+                writer.write_string(group.material.name);
+                writer.write_string(group.material.albedo);
+                writer.write_string(group.material.transparency);
+            }
+
+            writer.save(binary_cache::cache_path(path));
+        }
+
+        void read_cache(cached_obj &result, std::filesystem::path const &path, binary_cache::source_key const &key) {
+            binary_cache::reader reader(result.file.view(), magic, version);
+            reader.expect_key(key);
+            auto mtllib_count = reader.read<std::uint32_t>();
+            for (std::uint32_t i = 0; i < mtllib_count; ++i) {
+                auto name = reader.read_string();
+                reader.expect_key(mtl_key(path, name));
+            }
+            if (reader.read<std::uint32_t>() != sizeof(obj_data::vertex))
+                throw std::runtime_error("Cache vertex layout mismatch");
+            result.vertices = reader.read_array<obj_data::vertex>();
+            result.indices = reader.read_array<std::uint32_t>();
+
+            result.groups.resize(reader.read<std::uint64_t>());
+            for (auto &group: result.groups) {
+                auto record = reader.read<group_record>();
+                group.offset = record.offset;
+                group.count = record.count;
+                group.material.glossiness = record.glossiness;
+                group.material.roughness = record.roughness;
+                group.material.name = reader.read_string();
+                group.material.albedo = reader.read_string();
+                group.material.transparency = reader.read_string();
+            }
+        }
+    }
+
+    cached_obj load_obj_cached(std::filesystem::path const &path, parse_mode mode) {
+        cached_obj result;
+
+        // a source that cannot be read is an empty scene, as parse_obj has always made of it in stream
+        // mode, and there is nothing to key a cache on
+        if (!std::ifstream(path))
+            return result;
+
+        auto const key = binary_cache::make_key(path);
+        auto const cache = binary_cache::cache_path(path);
+
+        if (std::filesystem::exists(cache)) {
+            try {
+                result.file = mapped_file(cache);
+                read_cache(result, path, key);
+                result.from_cache = true;
+                return result;
+            } catch (std::runtime_error const &) {
+                // stale or damaged cache, rebuild it below
+                result = cached_obj{};
+            }
+        }
+
+        result.parsed = parse_obj(path, mode);
+        result.vertices = result.parsed.vertices;
+        result.indices = result.parsed.indices;
+        result.groups = result.parsed.groups;
+
+        try {
+            write_cache(path, key, mtllib_names(path), result.parsed);
+        } catch (std::runtime_error const &) {
+            // the asset directory may be read-only, the cache is an optimization only
+        }
+
+        return result;
+    }
+
+    void write_obj_cache(std::filesystem::path const &path, obj_data const &data) {
+        write_cache(path, binary_cache::make_key(path), mtllib_names(path), data);
+    }
+}
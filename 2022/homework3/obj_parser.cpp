@@ -1,10 +1,17 @@
 #include "obj_parser.hpp"
+#include "mapped_file.hpp"
 
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <fstream>
+#include <future>
 #include <stdexcept>
 #include <map>
+#include <thread>
 
 namespace
 {
@@ -76,166 +83,642 @@ namespace obj_parser {
         lib[material_name] = material;
     }
 
-    obj_data parse_obj(std::filesystem::path const &path) {
-        std::ifstream is(path);
+    void obj_assembler::reserve(std::size_t positions, std::size_t texcoords, std::size_t normals) {
+        positions_.reserve(positions);
+        texcoords_.reserve(texcoords);
+        normals_.reserve(normals);
 
-        std::vector<std::array<float, 3>> positions;
-        std::vector<std::array<float, 3>> normals;
-        std::vector<std::array<float, 2>> texcoords;
+        // most exporters emit about one unique vertex per largest attribute stream
+        index_map_.reserve(std::max({positions, texcoords, normals}));
+    }
 
-        std::map<std::array<std::uint32_t, 3>, std::uint32_t> index_map;
+    void obj_assembler::position(std::array<float, 3> const &position) {
+        positions_.push_back(position);
+    }
 
-        obj_data result;
+    void obj_assembler::texcoord(std::array<float, 2> const &texcoord) {
+        texcoords_.push_back(texcoord);
+    }
 
-        std::string line;
-        std::size_t line_count = 0;
+    void obj_assembler::normal(std::array<float, 3> const &normal) {
+        normals_.push_back(normal);
+    }
 
-        mtllib mtllib;
-        std::string mtl_name;
+    void obj_assembler::face(std::span<std::array<std::uint32_t, 3> const> corners) {
+        for (auto const &index: corners) {
+            auto [vertex_index, inserted] = index_map_.try_emplace(index, vertex_count_);
+            if (inserted) {
+                obj_data::vertex v;
 
-        std::string group_name;
-        obj_data::group cur_group;
+                v.position = positions_[index[0]];
 
-        auto fail = [&](auto const &... args) {
-            throw std::runtime_error(to_string("Error parsing OBJ data, line ", line_count, ": ", args...));
-        };
+                if (index[1] != -1)
+                    v.texcoord = texcoords_[index[1]];
+                else
+                    v.texcoord = {0.f, 0.f};
 
-        while (std::getline(is >> std::ws, line)) {
-            ++line_count;
+                if (index[2] != -1)
+                    v.normal = normals_[index[2]];
+                else
+                    v.normal = {0.f, 0.f, 0.f};
 
-            if (line.empty()) continue;
+                vertex(vertex_count_++, v);
+            }
 
-            if (line[0] == '#') continue;
+            face_.push_back(vertex_index);
+        }
 
-            std::istringstream ls(std::move(line));
+        for (std::size_t i = 1; i + 1 < face_.size(); ++i) {
+            triangle({face_[0], face_[i], face_[i + 1]});
+            index_count_ += 3;
+        }
+        cur_group_.count += 3 * face_.size();
+        face_.clear();
+    }
 
-            std::string tag;
-            ls >> tag;
+    void obj_assembler::group(std::string_view name) {
+        // groups are now divided by materials used by them
+        group_name_ = name;
+    }
+
+    void obj_assembler::material(mtl const &material) {
+        if (!group_name_.empty()) // TODO: better switch to bool
+            group_done(cur_group_);
+
+        // clearing material
+        cur_group_.material = material;
+        cur_group_.offset = index_count_;
+        cur_group_.count = 0;
+    }
+
+    void obj_assembler::finish() {
+        group_done(cur_group_);
+    }
+
+    namespace {
+        // Shared by all parse modes: resolves and validates face indices and looks materials up,
+        // then forwards everything to the visitor.
+        struct obj_event_source {
+            std::filesystem::path const &path;
+            obj_visitor &visitor;
+            std::size_t line_count = 0;
+
+            // positions, texcoords and normals reported so far
+            std::array<std::size_t, 3> defined{0, 0, 0};
+
+            mtllib materials;
+            std::vector<std::array<std::uint32_t, 3>> face;
+
+            obj_event_source(std::filesystem::path const &path, obj_visitor &visitor) : path(path), visitor(visitor) {}
+
+            template <typename ... Args>
+            [[noreturn]] void fail(Args const & ... args) const {
+                throw std::runtime_error(to_string("Error parsing OBJ data, line ", line_count, ": ", args...));
+            }
+
+            void position(std::array<float, 3> const &p) {
+                ++defined[0];
+                visitor.position(p);
+            }
+
+            void texcoord(std::array<float, 2> const &t) {
+                ++defined[1];
+                visitor.texcoord(t);
+            }
+
+            void normal(std::array<float, 3> const &n) {
+                ++defined[2];
+                visitor.normal(n);
+            }
 
-            if (tag == "mtllib") {
-                std::string name;
-                ls >> name;
+            void use_mtllib(std::string_view name) {
                 std::filesystem::path mtlpath = path.parent_path();
-                mtlpath += "/" + name;
-                parse_mtl(mtlpath, mtllib);
-            } else if (tag == "usemtl") {
-                ls >> mtl_name;
-                if (!group_name.empty()) // TODO: better switch to bool
-                    result.groups.push_back(cur_group);
-
-                // clearing material
-                cur_group.material = mtllib[mtl_name];
-                cur_group.offset = result.indices.size();
-                cur_group.count = 0;
-            } else if (tag == "g") {
-                // groups are now divided by materials used by them
-//                if (!group_name.empty())
-//                    result.groups.push_back(cur_group);
-                ls >> group_name;
-                // clearing material
-//                cur_group.offset = result.indices.size();
-//                cur_group.count = 0;
-            } else if (tag == "v") {
-                auto &p = positions.emplace_back();
-                ls >> p[0] >> p[1] >> p[2];
-            } else if (tag == "vn") {
-                auto &n = normals.emplace_back();
-                ls >> n[0] >> n[1] >> n[2];
-            } else if (tag == "vt") {
-                auto &t = texcoords.emplace_back();
-                ls >> t[0] >> t[1];
-            } else if (tag == "f") {
-                std::vector<std::uint32_t> vertices;
+                mtlpath += "/" + std::string(name);
+                parse_mtl(mtlpath, materials);
+            }
 
-                while (ls) {
-                    std::array<std::int32_t, 3> input_index{0, 0, 0};
+            void use_material(std::string_view name) {
+                visitor.material(materials[std::string(name)]);
+            }
+
+            void use_group(std::string_view name) {
+                visitor.group(name);
+            }
 
-                    ls >> input_index[0];
-                    if (ls.eof()) break;
-                    if (!ls)
-                        fail("expected position index");
+            void add_corner(std::array<std::int32_t, 3> const &input_index) {
+                add_corner(input_index, defined);
+            }
 
-                    if (!std::isspace(ls.peek()) && !ls.eof()) {
-                        if (ls.get() != '/')
-                            fail("expected '/'");
+            // `defined` is the number of positions, texcoords and normals declared before the face;
+            // relative (negative) indices are resolved against it
+            void add_corner(std::array<std::int32_t, 3> const &input_index, std::array<std::size_t, 3> const &defined) {
+                std::array<std::uint32_t, 3> index{0, 0, 0};
+                if (input_index[0] < 0)
+                    index[0] = defined[0] + input_index[0];
+                else
+                    index[0] = input_index[0] - 1;
+                if (input_index[1] < 0)
+                    index[1] = defined[1] + input_index[1];
+                else
+                    index[1] = input_index[1] - 1;
+                if (input_index[2] < 0)
+                    index[2] = defined[2] + input_index[2];
+                else
+                    index[2] = input_index[2] - 1;
+
+                if (index[0] >= defined[0])
+                    fail("bad position index (", index[0], ")");
+
+                if (index[1] != -1 && index[1] >= defined[1])
+                    fail("bad texcoord index (", index[1], ")");
+
+                if (index[2] != -1 && index[2] >= defined[2])
+                    fail("bad normal index (", index[2], ")");
+
+                face.push_back(index);
+            }
 
-                        if (ls.peek() != '/') {
-                            ls >> input_index[1];
-                            if (!ls)
-                                fail("expected texcoord index");
+            void end_face() {
+                visitor.face(face);
+                face.clear();
+            }
+        };
 
-                            if (!std::isspace(ls.peek()) && !ls.eof()) {
-                                if (ls.get() != '/')
-                                    fail("expected '/'");
+        void visit_obj_stream(std::filesystem::path const &path, obj_visitor &visitor) {
+            std::ifstream is(path);
+
+            obj_event_source source(path, visitor);
+
+            std::string line;
+
+            while (std::getline(is >> std::ws, line)) {
+                ++source.line_count;
+
+                if (line.empty()) continue;
+
+                if (line[0] == '#') continue;
+
+                std::istringstream ls(std::move(line));
+
+                std::string tag;
+                ls >> tag;
+
+                if (tag == "mtllib") {
+                    std::string name;
+                    ls >> name;
+                    source.use_mtllib(name);
+                } else if (tag == "usemtl") {
+                    std::string name;
+                    ls >> name;
+                    source.use_material(name);
+                } else if (tag == "g") {
+                    std::string name;
+                    ls >> name;
+                    source.use_group(name);
+                } else if (tag == "v") {
+                    std::array<float, 3> p{0.f, 0.f, 0.f};
+                    ls >> p[0] >> p[1] >> p[2];
+                    source.position(p);
+                } else if (tag == "vn") {
+                    std::array<float, 3> n{0.f, 0.f, 0.f};
+                    ls >> n[0] >> n[1] >> n[2];
+                    source.normal(n);
+                } else if (tag == "vt") {
+                    std::array<float, 2> t{0.f, 0.f};
+                    ls >> t[0] >> t[1];
+                    source.texcoord(t);
+                } else if (tag == "f") {
+                    while (ls) {
+                        std::array<std::int32_t, 3> input_index{0, 0, 0};
+
+                        // the end of the line is looked for before the index, not after it: a last corner
+                        // without slashes, as in `f 2 3 1`, ends exactly at eof and still counts
+                        ls >> std::ws;
+                        if (ls.eof()) break;
+                        ls >> input_index[0];
+                        if (!ls)
+                            source.fail("expected position index");
+
+                        if (!std::isspace(ls.peek()) && !ls.eof()) {
+                            if (ls.get() != '/')
+                                source.fail("expected '/'");
+
+                            if (ls.peek() != '/') {
+                                ls >> input_index[1];
+                                if (!ls)
+                                    source.fail("expected texcoord index");
+
+                                if (!std::isspace(ls.peek()) && !ls.eof()) {
+                                    if (ls.get() != '/')
+                                        source.fail("expected '/'");
+
+                                    ls >> input_index[2];
+                                    if (!ls)
+                                        source.fail("expected normal index");
+                                }
+                            } else {
+                                ls.get();
 
                                 ls >> input_index[2];
                                 if (!ls)
-                                    fail("expected normal index");
+                                    source.fail("expected normal index");
                             }
-                        } else {
-                            ls.get();
+                        }
+
+                        source.add_corner(input_index);
+                    }
+
+                    source.end_face();
+                }
+            }
+        }
+
+        // In-place tokenizer over a memory-mapped file. No allocations happen per line.
+        struct obj_tokenizer {
+            char const *cur;
+            char const *end;
+
+            static bool is_space(char c) {
+                return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+            }
+
+            void skip_spaces() {
+                while (cur != end && is_space(*cur))
+                    ++cur;
+            }
+
+            bool at_line_end() const {
+                return cur == end || *cur == '\n';
+            }
+
+            void skip_line() {
+                while (cur != end && *cur != '\n')
+                    ++cur;
+                if (cur != end)
+                    ++cur;
+            }
+
+            std::string_view word() {
+                skip_spaces();
+                char const *begin = cur;
+                while (cur != end && *cur != '\n' && !is_space(*cur))
+                    ++cur;
+                return {begin, static_cast<std::size_t>(cur - begin)};
+            }
+
+            template <typename T>
+            bool number(T &value) {
+                skip_spaces();
+                if (cur != end && *cur == '+')
+                    ++cur;
+                auto [ptr, ec] = std::from_chars(cur, end, value);
+                if (ec != std::errc())
+                    return false;
+                cur = ptr;
+                return true;
+            }
+
+            // missing components are left zero, matching the behaviour of operator>>
+            template <std::size_t N>
+            void floats(std::array<float, N> &values) {
+                for (auto &value: values)
+                    if (!number(value))
+                        break;
+            }
+
+            // reads one `p`, `p/t`, `p//n` or `p/t/n` face corner; returns false at the end of the line
+            template <typename Fail>
+            bool corner(std::array<std::int32_t, 3> &input_index, Fail const &fail) {
+                skip_spaces();
+                if (at_line_end())
+                    return false;
+
+                input_index = {0, 0, 0};
+
+                if (!number(input_index[0]))
+                    fail("expected position index");
 
-                            ls >> input_index[2];
-                            if (!ls)
+                if (!at_line_end() && !is_space(*cur)) {
+                    if (*cur++ != '/')
+                        fail("expected '/'");
+
+                    if (cur != end && *cur != '/') {
+                        if (!number(input_index[1]))
+                            fail("expected texcoord index");
+
+                        if (!at_line_end() && !is_space(*cur)) {
+                            if (*cur++ != '/')
+                                fail("expected '/'");
+
+                            if (!number(input_index[2]))
                                 fail("expected normal index");
                         }
+                    } else {
+                        // `p/` at the very end of the file has nothing to skip
+                        if (cur == end)
+                            fail("expected normal index");
+                        ++cur;
+
+                        if (!number(input_index[2]))
+                            fail("expected normal index");
                     }
+                }
 
-                    std::array<std::uint32_t, 3> index{0, 0, 0};
-                    if (input_index[0] < 0)
-                        index[0] = positions.size() + input_index[0];
-                    else
-                        index[0] = input_index[0] - 1;
-                    if (input_index[1] < 0)
-                        index[1] = texcoords.size() + input_index[1];
-                    else
-                        index[1] = input_index[1] - 1;
-                    if (input_index[2] < 0)
-                        index[2] = normals.size() + input_index[2];
-                    else
-                        index[2] = input_index[2] - 1;
-
-                    if (index[0] >= positions.size())
-                        fail("bad position index (", index[0], ")");
-
-                    if (index[1] != -1 && index[1] >= texcoords.size())
-                        fail("bad texcoord index (", index[1], ")");
-
-                    if (index[2] != -1 && index[2] >= normals.size())
-                        fail("bad normal index (", index[2], ")");
-
-                    auto it = index_map.find(index);
-                    if (it == index_map.end()) {
-                        it = index_map.insert({index, result.vertices.size()}).first;
-
-                        auto &v = result.vertices.emplace_back();
-
-                        v.position = positions[index[0]];
-
-                        if (index[1] != -1)
-                            v.texcoord = texcoords[index[1]];
-                        else
-                            v.texcoord = {0.f, 0.f};
-
-                        if (index[2] != -1)
-                            v.normal = normals[index[2]];
-                        else
-                            v.normal = {0.f, 0.f, 0.f};
-                    }
+                return true;
+            }
+        };
 
-                    vertices.push_back(it->second);
+        // cheap first pass: counts `v`, `vt` and `vn` lines so that nothing has to grow while parsing
+        std::array<std::size_t, 3> count_elements(std::string_view text) {
+            std::array<std::size_t, 3> counts{0, 0, 0};
+
+            char const *cur = text.data();
+            char const *end = text.data() + text.size();
+            while (cur != end) {
+                while (cur != end && obj_tokenizer::is_space(*cur))
+                    ++cur;
+                if (end - cur > 2 && cur[0] == 'v') {
+                    if (obj_tokenizer::is_space(cur[1]))
+                        ++counts[0];
+                    else if (cur[1] == 't' && obj_tokenizer::is_space(cur[2]))
+                        ++counts[1];
+                    else if (cur[1] == 'n' && obj_tokenizer::is_space(cur[2]))
+                        ++counts[2];
                 }
+                auto next = static_cast<char const *>(std::memchr(cur, '\n', end - cur));
+                cur = next ? next + 1 : end;
+            }
+
+            return counts;
+        }
 
-                for (std::size_t i = 1; i + 1 < vertices.size(); ++i) {
-                    result.indices.push_back(vertices[0]);
-                    result.indices.push_back(vertices[i]);
-                    result.indices.push_back(vertices[i + 1]);
+        void visit_obj_mapped(std::filesystem::path const &path, obj_visitor &visitor) {
+            mapped_file file(path);
+
+            auto counts = count_elements(file.view());
+            visitor.reserve(counts[0], counts[1], counts[2]);
+
+            obj_event_source source(path, visitor);
+            obj_tokenizer tok{file.data(), file.data() + file.size()};
+
+            while (tok.cur != tok.end) {
+                ++source.line_count;
+
+                std::string_view tag = tok.word();
+
+                if (tag.empty() || tag[0] == '#') {
+                    tok.skip_line();
+                    continue;
                 }
-                cur_group.count += 3 * vertices.size();
+
+                if (tag == "v") {
+                    std::array<float, 3> p{0.f, 0.f, 0.f};
+                    tok.floats(p);
+                    source.position(p);
+                } else if (tag == "vn") {
+                    std::array<float, 3> n{0.f, 0.f, 0.f};
+                    tok.floats(n);
+                    source.normal(n);
+                } else if (tag == "vt") {
+                    std::array<float, 2> t{0.f, 0.f};
+                    tok.floats(t);
+                    source.texcoord(t);
+                } else if (tag == "f") {
+                    auto fail = [&](char const *message) { source.fail(message); };
+                    for (std::array<std::int32_t, 3> input_index; tok.corner(input_index, fail);)
+                        source.add_corner(input_index);
+
+                    source.end_face();
+                } else if (tag == "mtllib") {
+                    source.use_mtllib(tok.word());
+                } else if (tag == "usemtl") {
+                    source.use_material(tok.word());
+                } else if (tag == "g") {
+                    source.use_group(tok.word());
+                }
+
+                tok.skip_line();
             }
         }
 
-        result.groups.push_back(cur_group);
-        return result;
+        // Records of one line-aligned slice of the file. Face indices are kept as written, together with
+        // the chunk-local number of declared elements, and are only resolved during the merge.
+        struct obj_chunk {
+            struct face {
+                std::uint32_t first_corner;
+                std::uint32_t corner_count;
+                std::array<std::uint32_t, 3> defined; // positions, texcoords, normals declared before the face
+                std::uint32_t line;
+            };
+
+            struct event {
+                enum { mtllib, usemtl, group } kind;
+                std::string_view name;
+                std::uint32_t face; // number of faces preceding the event
+                std::uint32_t line;
+            };
+
+            std::vector<std::array<float, 3>> positions;
+            std::vector<std::array<float, 3>> normals;
+            std::vector<std::array<float, 2>> texcoords;
+            std::vector<std::array<std::int32_t, 3>> corners;
+            std::vector<face> faces;
+            std::vector<event> events;
+            std::size_t line_count = 0;
+        };
+
+        struct chunk_error : std::runtime_error {
+            std::size_t line;
+
+            chunk_error(std::size_t line, char const *message) : std::runtime_error(message), line(line) {}
+        };
+
+        obj_chunk parse_obj_chunk(std::string_view text) {
+            obj_chunk chunk;
+            obj_tokenizer tok{text.data(), text.data() + text.size()};
+
+            auto fail = [&](char const *message) { throw chunk_error(chunk.line_count, message); };
+
+            auto add_event = [&](auto kind) {
+                chunk.events.push_back({kind, tok.word(), static_cast<std::uint32_t>(chunk.faces.size()),
+                                        static_cast<std::uint32_t>(chunk.line_count)});
+            };
+
+            while (tok.cur != tok.end) {
+                ++chunk.line_count;
+
+                std::string_view tag = tok.word();
+
+                if (tag.empty() || tag[0] == '#') {
+                    tok.skip_line();
+                    continue;
+                }
+
+                if (tag == "v") {
+                    tok.floats(chunk.positions.emplace_back());
+                } else if (tag == "vn") {
+                    tok.floats(chunk.normals.emplace_back());
+                } else if (tag == "vt") {
+                    tok.floats(chunk.texcoords.emplace_back());
+                } else if (tag == "f") {
+                    auto &face = chunk.faces.emplace_back();
+                    face.first_corner = chunk.corners.size();
+                    face.defined = {static_cast<std::uint32_t>(chunk.positions.size()),
+                                    static_cast<std::uint32_t>(chunk.texcoords.size()),
+                                    static_cast<std::uint32_t>(chunk.normals.size())};
+                    face.line = chunk.line_count;
+
+                    for (std::array<std::int32_t, 3> input_index; tok.corner(input_index, fail);)
+                        chunk.corners.push_back(input_index);
+
+                    face.corner_count = chunk.corners.size() - face.first_corner;
+                } else if (tag == "mtllib") {
+                    add_event(obj_chunk::event::mtllib);
+                } else if (tag == "usemtl") {
+                    add_event(obj_chunk::event::usemtl);
+                } else if (tag == "g") {
+                    add_event(obj_chunk::event::group);
+                }
+
+                tok.skip_line();
+            }
+
+            return chunk;
+        }
+
+        void visit_obj_parallel(std::filesystem::path const &path, obj_visitor &visitor, unsigned threads) {
+            mapped_file file(path);
+
+            if (threads == 0)
+                threads = std::max(1u, std::thread::hardware_concurrency());
+
+            // split at line boundaries
+            std::vector<std::future<obj_chunk>> futures;
+            char const *begin = file.data();
+            char const *end = file.data() + file.size();
+            for (unsigned i = 0; i < threads && begin != end; ++i) {
+                char const *split = end;
+                if (i + 1 < threads) {
+                    split = std::max(begin, file.data() + file.size() / threads * (i + 1));
+                    split = std::find(split, end, '\n');
+                    if (split != end)
+                        ++split;
+                }
+                futures.push_back(std::async(std::launch::async, parse_obj_chunk,
+                                             std::string_view(begin, split - begin)));
+                begin = split;
+            }
+
+            std::vector<obj_chunk> chunks;
+            std::size_t line_base = 0;
+            for (auto &future: futures) {
+                try {
+                    chunks.push_back(future.get());
+                } catch (chunk_error const &e) {
+                    throw std::runtime_error(
+                            to_string("Error parsing OBJ data, line ", line_base + e.line, ": ", e.what()));
+                }
+                line_base += chunks.back().line_count;
+            }
+
+            std::array<std::size_t, 3> counts{0, 0, 0};
+            for (auto const &chunk: chunks) {
+                counts[0] += chunk.positions.size();
+                counts[1] += chunk.texcoords.size();
+                counts[2] += chunk.normals.size();
+            }
+            visitor.reserve(counts[0], counts[1], counts[2]);
+
+            // deterministic merge, in file order; a chunk's elements are reported before its faces,
+            // which is enough since faces can only refer to elements declared above them
+            obj_event_source source(path, visitor);
+
+            std::array<std::size_t, 3> base{0, 0, 0};
+            line_base = 0;
+            for (auto const &chunk: chunks) {
+                for (auto const &p: chunk.positions)
+                    visitor.position(p);
+                for (auto const &t: chunk.texcoords)
+                    visitor.texcoord(t);
+                for (auto const &n: chunk.normals)
+                    visitor.normal(n);
+
+                auto event = chunk.events.begin();
+                for (std::size_t f = 0; f <= chunk.faces.size(); ++f) {
+                    for (; event != chunk.events.end() && event->face == f; ++event) {
+                        source.line_count = line_base + event->line;
+                        switch (event->kind) {
+                            case obj_chunk::event::mtllib:
+                                source.use_mtllib(event->name);
+                                break;
+                            case obj_chunk::event::usemtl:
+                                source.use_material(event->name);
+                                break;
+                            case obj_chunk::event::group:
+                                source.use_group(event->name);
+                                break;
+                        }
+                    }
+
+                    if (f == chunk.faces.size())
+                        break;
+
+                    auto const &face = chunk.faces[f];
+                    source.line_count = line_base + face.line;
+
+                    std::array<std::size_t, 3> defined{base[0] + face.defined[0],
+                                                       base[1] + face.defined[1],
+                                                       base[2] + face.defined[2]};
+                    for (std::uint32_t c = 0; c < face.corner_count; ++c)
+                        source.add_corner(chunk.corners[face.first_corner + c], defined);
+                    source.end_face();
+                }
+
+                base[0] += chunk.positions.size();
+                base[1] += chunk.texcoords.size();
+                base[2] += chunk.normals.size();
+                line_base += chunk.line_count;
+            }
+        }
+
+        struct obj_data_assembler : obj_assembler {
+            obj_data result;
+
+            void reserve(std::size_t positions, std::size_t texcoords, std::size_t normals) override {
+                obj_assembler::reserve(positions, texcoords, normals);
+                result.vertices.reserve(std::max({positions, texcoords, normals}));
+            }
+
+            void vertex(std::uint32_t, obj_data::vertex const &vertex) override {
+                result.vertices.push_back(vertex);
+            }
+
+            void triangle(std::array<std::uint32_t, 3> const &indices) override {
+                result.indices.insert(result.indices.end(), indices.begin(), indices.end());
+            }
+
+            void group_done(obj_data::group const &group) override {
+                result.groups.push_back(group);
+            }
+        };
     }
-}
\ No newline at end of file
+
+    void visit_obj(std::filesystem::path const &path, obj_visitor &visitor, parse_mode mode, unsigned threads) {
+        switch (mode) {
+            case parse_mode::stream:
+                return visit_obj_stream(path, visitor);
+            case parse_mode::mapped:
+                return visit_obj_mapped(path, visitor);
+            case parse_mode::parallel:
+                return visit_obj_parallel(path, visitor, threads);
+        }
+        throw std::invalid_argument("Unknown OBJ parse mode");
+    }
+
+    obj_data parse_obj(std::filesystem::path const &path, parse_mode mode, unsigned threads) {
+        obj_data_assembler assembler;
+        visit_obj(path, assembler, mode, threads);
+        assembler.finish();
+        return std::move(assembler.result);
+    }
+}
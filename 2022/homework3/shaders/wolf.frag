@@ -1,9 +1,9 @@
 #version 330 core
 
-uniform sampler2D albedo;
+uniform sampler2DArray albedo;
 uniform float brightness;
 uniform vec4 color;
-uniform int use_texture;
+uniform int layer;
 
 uniform vec3 light_direction;
 
@@ -17,8 +17,8 @@ void main()
 {
     vec4 albedo_color;
 
-    if (use_texture == 1)
-        albedo_color = texture(albedo, texcoord);
+    if (layer >= 0)
+        albedo_color = texture(albedo, vec3(texcoord, layer));
     else
         albedo_color = color;
 
@@ -26,4 +26,4 @@ void main()
     float diffuse = max(0.0, dot(normalize(normal), light_direction));
 
     out_color = vec4(albedo_color.rgb * (ambient + diffuse), albedo_color.a);
-}
\ No newline at end of file
+}
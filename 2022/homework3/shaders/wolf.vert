@@ -4,7 +4,10 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
-uniform mat4x3 bones[64];
+// The palettes of every instance, one after another, each bone a mat4x3 in 3 RGBA32F texels (its 12 floats
+// in column order). No limit on the bones but the size of a buffer texture, and one draw for a whole herd.
+uniform samplerBuffer bones;
+uniform int bone_count;
 
 layout (location = 0) in vec3 in_position;
 layout (location = 1) in vec3 in_normal;
@@ -16,15 +19,24 @@ out vec3 normal;
 out vec2 texcoord;
 out vec4 weights;
 
+mat4x3 bone(int joint)
+{
+    int texel = 3 * (gl_InstanceID * bone_count + joint);
+    vec4 a = texelFetch(bones, texel);
+    vec4 b = texelFetch(bones, texel + 1);
+    vec4 c = texelFetch(bones, texel + 2);
+    return mat4x3(a.xyz, vec3(a.w, b.xy), vec3(b.zw, c.x), c.yzw);
+}
+
 void main()
 {
-    mat4x3 average = bones[in_joints.x] * in_weights.x
-    + bones[in_joints.y] * in_weights.y
-    + bones[in_joints.z] * in_weights.z
-    + bones[in_joints.w] * in_weights.w;
+    mat4x3 average = bone(in_joints.x) * in_weights.x
+    + bone(in_joints.y) * in_weights.y
+    + bone(in_joints.z) * in_weights.z
+    + bone(in_joints.w) * in_weights.w;
 
     gl_Position = projection * view * model * mat4(average) * vec4(in_position, 1.0);
     normal = mat3(model) * mat3(average) * in_normal;
     texcoord = in_texcoord;
     weights = in_weights;
-}
\ No newline at end of file
+}
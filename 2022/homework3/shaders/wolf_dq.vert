@@ -0,0 +1,55 @@
+#version 330 core
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// Like wolf.vert, but each bone a dual quaternion in 2 texels, the real part first: 8 floats a bone
+// instead of the 12 of a mat4x3
+uniform samplerBuffer bones;
+uniform int bone_count;
+
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in vec3 in_normal;
+layout (location = 2) in vec2 in_texcoord;
+layout (location = 3) in ivec4 in_joints;
+layout (location = 4) in vec4 in_weights;
+
+out vec3 normal;
+out vec2 texcoord;
+out vec4 weights;
+
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+mat2x4 bone(int joint)
+{
+    int texel = 2 * (gl_InstanceID * bone_count + joint);
+    return mat2x4(texelFetch(bones, texel), texelFetch(bones, texel + 1));
+}
+
+void main()
+{
+    mat2x4 bone0 = bone(in_joints.x);
+    mat2x4 bone1 = bone(in_joints.y);
+    mat2x4 bone2 = bone(in_joints.z);
+    mat2x4 bone3 = bone(in_joints.w);
+
+    // every bone taken in the hemisphere of the first one, or the blend goes the long way around
+    mat2x4 blended = bone0 * in_weights.x
+    + bone1 * (dot(bone0[0], bone1[0]) < 0.0 ? -in_weights.y : in_weights.y)
+    + bone2 * (dot(bone0[0], bone2[0]) < 0.0 ? -in_weights.z : in_weights.z)
+    + bone3 * (dot(bone0[0], bone3[0]) < 0.0 ? -in_weights.w : in_weights.w);
+    blended /= length(blended[0]);
+
+    vec4 real = blended[0];
+    vec4 dual = blended[1];
+    vec3 translation = 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+
+    gl_Position = projection * view * model * vec4(rotate(real, in_position) + translation, 1.0);
+    normal = mat3(model) * rotate(real, in_normal);
+    texcoord = in_texcoord;
+    weights = in_weights;
+}
@@ -0,0 +1,102 @@
+#include "skeleton_pose.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include <glm/mat3x3.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtx/component_wise.hpp>
+
+static constexpr std::uint32_t no_parent = -1;
+
+// translation * rotation * scale
+static glm::mat4x3 to_matrix(glm::vec3 const & translation, glm::quat const & rotation, glm::vec3 const & scale)
+{
+    glm::mat3 const r = glm::mat3_cast(rotation);
+    return glm::mat4x3(r[0] * scale.x, r[1] * scale.y, r[2] * scale.z, translation);
+}
+
+// a * b of affine transforms
+static glm::mat4x3 compose(glm::mat4x3 const & a, glm::mat4x3 const & b)
+{
+    glm::mat3 const linear(a);
+    return glm::mat4x3(linear * b[0], linear * b[1], linear * b[2], linear * b[3] + a[3]);
+}
+
+skeleton_pose::skeleton_pose(std::size_t bones)
+    : translations(bones, glm::vec3(0.f))
+    , scales(bones, glm::vec3(1.f))
+    , stride((bones + 3) & ~std::size_t(3))
+{
+    rotations.assign(4 * stride, 0.f);
+    std::fill(rotations.begin() + 3 * stride, rotations.end(), 1.f);
+}
+
+void pose_error::add(skeleton_pose const & expected, skeleton_pose const & actual)
+{
+    assert(expected.size() == actual.size());
+
+    for (std::size_t i = 0; i < expected.size(); ++i)
+    {
+        float const cos_half_angle = std::min(1.f, std::abs(glm::dot(glm::normalize(expected.rotation(i)), glm::normalize(actual.rotation(i)))));
+        translation = std::max(translation, glm::distance(expected.translations[i], actual.translations[i]));
+        rotation = std::max(rotation, 2.f * std::acos(cos_half_angle));
+        scale = std::max(scale, glm::compMax(glm::abs(expected.scales[i] - actual.scales[i])));
+    }
+}
+
+bool pose_error::within(pose_error const & tolerance) const
+{
+    return translation <= tolerance.translation && rotation <= tolerance.rotation && scale <= tolerance.scale;
+}
+
+void sample_pose(gltf_model::animation const & animation, float time, std::vector<std::size_t> & cursors, skeleton_pose & pose)
+{
+    assert(pose.size() == animation.bones.size());
+
+    // as gltf_model::animation::sample, but with the rotations going in by component
+    cursors.resize(3 * animation.bones.size(), 0);
+
+    for (std::size_t i = 0; i < animation.bones.size(); ++i)
+    {
+        auto const & bone = animation.bones[i];
+        std::size_t * cursor = cursors.data() + 3 * i;
+
+        pose.translations[i] = bone.translation.values.empty() ? glm::vec3(0.f) : bone.translation(time, cursor[0]);
+        pose.set_rotation(i, bone.rotation.values.empty() ? glm::quat(1.f, 0.f, 0.f, 0.f) : bone.rotation(time, cursor[1]));
+        pose.scales[i] = bone.scale.values.empty() ? glm::vec3(1.f) : bone.scale(time, cursor[2]);
+    }
+}
+
+pose_evaluator::pose_evaluator(std::vector<gltf_model::bone> const & bones)
+    : parents_(bones.size())
+    , inverse_binds_(bones.size())
+    , globals_(bones.size())
+    , palette_(bones.size())
+{
+    for (std::size_t i = 0; i < bones.size(); ++i)
+    {
+        parents_[i] = bones[i].parent;
+        assert(parents_[i] == no_parent || parents_[i] < i);
+        inverse_binds_[i] = glm::mat4x3(bones[i].inverse_bind_matrix);
+    }
+}
+
+std::span<glm::mat4x3 const> pose_evaluator::evaluate(skeleton_pose const & pose)
+{
+    evaluate(pose, palette_);
+    return palette_;
+}
+
+void pose_evaluator::evaluate(skeleton_pose const & pose, std::span<glm::mat4x3> palette, glm::mat4x3 const & root)
+{
+    assert(pose.size() == size() && palette.size() == size());
+
+    for (std::size_t i = 0; i < parents_.size(); ++i)
+    {
+        glm::mat4x3 const local = to_matrix(pose.translations[i], pose.rotation(i), pose.scales[i]);
+        globals_[i] = compose(parents_[i] == no_parent ? root : globals_[parents_[i]], local);
+        palette[i] = compose(globals_[i], inverse_binds_[i]);
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/mat4x3.hpp>
+
+#include "gltf_loader.hpp"
+
+// Local transforms of every bone of a skeleton. Translations and scales are one element per bone.
+// Rotations are stored by component, x, y, z and w of bone i at rotations[component * stride + i], with
+// the bones padded to a multiple of 4 by the identity: SIMD code blends four bones a register without
+// shuffling quaternions in and out (see nlerp in blend_tree.hpp).
+struct skeleton_pose
+{
+    std::vector<glm::vec3> translations;
+    std::vector<float> rotations;
+    std::vector<glm::vec3> scales;
+    std::size_t stride = 0;
+
+    skeleton_pose() = default;
+    explicit skeleton_pose(std::size_t bones);
+
+    std::size_t size() const { return translations.size(); }
+
+    glm::quat rotation(std::size_t bone) const
+    {
+        return glm::quat(rotations[3 * stride + bone], rotations[bone], rotations[stride + bone], rotations[2 * stride + bone]);
+    }
+
+    void set_rotation(std::size_t bone, glm::quat const & rotation)
+    {
+        rotations[bone] = rotation.x;
+        rotations[stride + bone] = rotation.y;
+        rotations[2 * stride + bone] = rotation.z;
+        rotations[3 * stride + bone] = rotation.w;
+    }
+};
+
+// Largest differences between poses: distance, angle in radians, scale component
+struct pose_error
+{
+    float translation = 0.f;
+    float rotation = 0.f;
+    float scale = 0.f;
+
+    // takes the differences of `actual` from `expected` in
+    void add(skeleton_pose const & expected, skeleton_pose const & actual);
+
+    // none of the three over that of `tolerance`
+    bool within(pose_error const & tolerance) const;
+};
+
+// Samples `animation` into `pose`, see gltf_model::animation::sample
+void sample_pose(gltf_model::animation const & animation, float time, std::vector<std::size_t> & cursors, skeleton_pose & pose);
+
+// Turns local poses into the skinning palette. Global transforms are composed in one pass over the bones,
+// parents come before their children in glTF skins as loaded, and multiplied by the inverse bind matrices.
+// All the storage is allocated up front, evaluating a pose does not allocate.
+class pose_evaluator
+{
+public:
+    pose_evaluator() = default;
+    explicit pose_evaluator(std::vector<gltf_model::bone> const & bones);
+
+    std::size_t size() const { return parents_.size(); }
+
+    // returns the palette
+    std::span<glm::mat4x3 const> evaluate(skeleton_pose const & pose);
+    // writes the palette to `palette` instead, e.g. a slice of a buffer shared by many instances, with the
+    // root bones placed by `root` (where the instance stands)
+    void evaluate(skeleton_pose const & pose, std::span<glm::mat4x3> palette, glm::mat4x3 const & root = glm::mat4x3(1.f));
+
+    std::span<glm::mat4x3 const> globals() const { return globals_; }
+    std::span<glm::mat4x3 const> palette() const { return palette_; }
+
+private:
+    std::vector<std::uint32_t> parents_;
+    std::vector<glm::mat4x3> inverse_binds_;
+    std::vector<glm::mat4x3> globals_;
+    std::vector<glm::mat4x3> palette_;
+};
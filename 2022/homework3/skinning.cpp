@@ -0,0 +1,244 @@
+#include "skinning.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SKINNING_SSE2
+#endif
+
+template <typename T>
+static T load(char const * data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// component `c` of element `i`, normalized integers mapped to [0, 1] or [-1, 1] as GL does
+static float read_float(std::span<char const> binary, gltf_model::accessor const & accessor, std::size_t i, unsigned int c)
+{
+    char const * data = binary.data() + accessor.view.offset + i * accessor.stride();
+    switch (accessor.type)
+    {
+    case 0x1400: // GL_BYTE
+    {
+        float const value = load<std::int8_t>(data + c);
+        return accessor.normalized ? std::max(value / 127.f, -1.f) : value;
+    }
+    case 0x1401: // GL_UNSIGNED_BYTE
+    {
+        float const value = load<std::uint8_t>(data + c);
+        return accessor.normalized ? value / 255.f : value;
+    }
+    case 0x1402: // GL_SHORT
+    {
+        float const value = load<std::int16_t>(data + 2 * c);
+        return accessor.normalized ? std::max(value / 32767.f, -1.f) : value;
+    }
+    case 0x1403: // GL_UNSIGNED_SHORT
+    {
+        float const value = load<std::uint16_t>(data + 2 * c);
+        return accessor.normalized ? value / 65535.f : value;
+    }
+    case 0x1405: // GL_UNSIGNED_INT
+        return load<std::uint32_t>(data + 4 * c);
+    default:
+        return load<float>(data + 4 * c);
+    }
+}
+
+static std::uint32_t read_integer(std::span<char const> binary, gltf_model::accessor const & accessor, std::size_t i, unsigned int c)
+{
+    char const * data = binary.data() + accessor.view.offset + i * accessor.stride();
+    switch (accessor.type)
+    {
+    case 0x1401: // GL_UNSIGNED_BYTE
+        return load<std::uint8_t>(data + c);
+    case 0x1403: // GL_UNSIGNED_SHORT
+        return load<std::uint16_t>(data + 2 * c);
+    default:
+        return load<std::uint32_t>(data + 4 * c);
+    }
+}
+
+skin_vertices load_skin_vertices(gltf_model const & model, gltf_model::mesh const & mesh)
+{
+    if (mesh.joints.count == 0 || mesh.weights.count == 0)
+        throw std::runtime_error("Mesh " + mesh.name + " is not skinned");
+
+    auto const binary = model.binary();
+    std::size_t const count = mesh.position.count;
+
+    skin_vertices result;
+    result.positions.resize(count);
+    result.normals.resize(count, glm::vec3(0.f, 0.f, 1.f));
+    result.joints.resize(count);
+    result.weights.resize(count);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        for (unsigned int c = 0; c < 3; ++c)
+        {
+            result.positions[i][c] = read_float(binary, mesh.position, i, c);
+            if (mesh.normal.count != 0)
+                result.normals[i][c] = read_float(binary, mesh.normal, i, c);
+        }
+        for (unsigned int c = 0; c < 4; ++c)
+        {
+            result.joints[i][c] = read_integer(binary, mesh.joints, i, c);
+            result.weights[i][c] = read_float(binary, mesh.weights, i, c);
+        }
+    }
+
+    return result;
+}
+
+#ifdef SKINNING_SSE2
+static void skin_sse2(skin_vertices const & source, std::span<glm::mat4x3 const> palette, std::span<skinned_vertex> result)
+{
+    static_assert(sizeof(glm::mat4x3) == 12 * sizeof(float) && sizeof(skinned_vertex) == 6 * sizeof(float));
+
+    float const * matrices = reinterpret_cast<float const *>(palette.data());
+    __m128 const half = _mm_set1_ps(0.5f);
+    __m128 const three = _mm_set1_ps(3.f);
+
+    for (std::size_t i = 0; i < source.size(); ++i)
+    {
+        glm::u16vec4 const joints = source.joints[i];
+        __m128 const weights = _mm_loadu_ps(&source.weights[i].x);
+        __m128 const weight[4] = {
+            _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(0, 0, 0, 0)),
+            _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(1, 1, 1, 1)),
+            _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(2, 2, 2, 2)),
+            _mm_shuffle_ps(weights, weights, _MM_SHUFFLE(3, 3, 3, 3)),
+        };
+
+        // the twelve floats of the blended matrix, columns one after another
+        __m128 a = _mm_setzero_ps(), b = _mm_setzero_ps(), c = _mm_setzero_ps();
+        for (int k = 0; k < 4; ++k)
+        {
+            assert(joints[k] < palette.size());
+
+            float const * matrix = matrices + 12 * joints[k];
+            a = _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(matrix), weight[k]));
+            b = _mm_add_ps(b, _mm_mul_ps(_mm_loadu_ps(matrix + 4), weight[k]));
+            c = _mm_add_ps(c, _mm_mul_ps(_mm_loadu_ps(matrix + 8), weight[k]));
+        }
+        // [a0 a1 a2 | a3 b0 b1 | b2 b3 c0 | c1 c2 c3], the last lane of each column is garbage
+        __m128 const column0 = a;
+        __m128 const column1 = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 3, 3)), b, _MM_SHUFFLE(2, 1, 2, 0));
+        __m128 const column2 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 3, 2));
+        __m128 const column3 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 2, 1));
+
+        glm::vec3 const & p = source.positions[i];
+        glm::vec3 const & n = source.normals[i];
+        __m128 const position = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(p.x)), _mm_mul_ps(column1, _mm_set1_ps(p.y))),
+            _mm_add_ps(_mm_mul_ps(column2, _mm_set1_ps(p.z)), column3));
+        __m128 const normal = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(n.x)), _mm_mul_ps(column1, _mm_set1_ps(n.y))),
+            _mm_mul_ps(column2, _mm_set1_ps(n.z)));
+
+        __m128 const squares = _mm_mul_ps(normal, normal);
+        __m128 const length = _mm_add_ss(_mm_add_ss(squares, _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(1, 1, 1, 1))),
+            _mm_shuffle_ps(squares, squares, _MM_SHUFFLE(2, 2, 2, 2)));
+        __m128 const estimate = _mm_rsqrt_ss(length);
+        __m128 scale = _mm_mul_ss(_mm_mul_ss(half, estimate), _mm_sub_ss(three, _mm_mul_ss(_mm_mul_ss(length, estimate), estimate)));
+        scale = _mm_shuffle_ps(scale, scale, _MM_SHUFFLE(0, 0, 0, 0));
+        __m128 const unit = _mm_mul_ps(normal, scale);
+
+        // the position's fourth lane lands on normal.x, written right after
+        float * out = &result[i].position.x;
+        _mm_storeu_ps(out, position);
+        _mm_storel_pi(reinterpret_cast<__m64 *>(out + 3), unit);
+        _mm_store_ss(out + 5, _mm_shuffle_ps(unit, unit, _MM_SHUFFLE(2, 2, 2, 2)));
+    }
+}
+#endif
+
+void skin(skin_vertices const & source, std::span<glm::mat4x3 const> palette, std::span<skinned_vertex> result)
+{
+    assert(result.size() == source.size());
+
+#ifdef SKINNING_SSE2
+    skin_sse2(source, palette, result);
+#else
+    for (std::size_t i = 0; i < source.size(); ++i)
+    {
+        glm::u16vec4 const joints = source.joints[i];
+        glm::vec4 const weights = source.weights[i];
+        glm::mat4x3 const matrix = palette[joints.x] * weights.x + palette[joints.y] * weights.y
+            + palette[joints.z] * weights.z + palette[joints.w] * weights.w;
+        result[i].position = matrix * glm::vec4(source.positions[i], 1.f);
+        result[i].normal = glm::normalize(glm::mat3(matrix) * source.normals[i]);
+    }
+#endif
+}
+
+void skin_reference(skin_vertices const & source, std::span<glm::mat4x3 const> palette, std::span<skinned_vertex> result)
+{
+    assert(result.size() == source.size());
+
+    for (std::size_t i = 0; i < source.size(); ++i)
+    {
+        glm::dvec3 position(0.0), normal(0.0);
+        for (int k = 0; k < 4; ++k)
+        {
+            glm::dmat4x3 const matrix(palette[source.joints[i][k]]);
+            double const weight = source.weights[i][k];
+            position += weight * (matrix * glm::dvec4(source.positions[i], 1.0));
+            normal += weight * (glm::dmat3(matrix) * glm::dvec3(source.normals[i]));
+        }
+        result[i].position = position;
+        result[i].normal = glm::normalize(normal);
+    }
+}
+
+void to_dual_quaternions(std::span<glm::mat4x3 const> palette, std::span<dual_quaternion> result)
+{
+    assert(result.size() == palette.size());
+
+    for (std::size_t i = 0; i < palette.size(); ++i)
+    {
+        glm::mat4x3 const & matrix = palette[i];
+        glm::mat3 const rotation(glm::normalize(matrix[0]), glm::normalize(matrix[1]), glm::normalize(matrix[2]));
+        glm::quat const real = glm::normalize(glm::quat_cast(rotation));
+        glm::quat const dual = glm::quat(0.f, matrix[3]) * real * 0.5f;
+        result[i] = {{real.x, real.y, real.z, real.w}, {dual.x, dual.y, dual.z, dual.w}};
+    }
+}
+
+void skin_dual_quaternion(skin_vertices const & source, std::span<dual_quaternion const> bones,
+    std::span<skinned_vertex> result)
+{
+    assert(result.size() == source.size());
+
+    for (std::size_t i = 0; i < source.size(); ++i)
+    {
+        glm::u16vec4 const joints = source.joints[i];
+        glm::vec4 const weights = source.weights[i];
+
+        glm::vec4 const pivot = bones[joints.x].real;
+        glm::vec4 real(0.f), dual(0.f);
+        for (int k = 0; k < 4; ++k)
+        {
+            auto const & bone = bones[joints[k]];
+            float const weight = glm::dot(bone.real, pivot) < 0.f ? -weights[k] : weights[k];
+            real += bone.real * weight;
+            dual += bone.dual * weight;
+        }
+        float const length = glm::length(real);
+        real /= length;
+        dual /= length;
+
+        glm::vec3 const r(real), d(dual);
+        glm::vec3 const & p = source.positions[i];
+        glm::vec3 const & n = source.normals[i];
+        glm::vec3 const translation = 2.f * (real.w * d - dual.w * r + glm::cross(r, d));
+        result[i].position = p + 2.f * glm::cross(r, glm::cross(r, p) + real.w * p) + translation;
+        result[i].normal = glm::normalize(n + 2.f * glm::cross(r, glm::cross(r, n) + real.w * n));
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/mat4x3.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include "gltf_loader.hpp"
+
+// The inputs of linear blend skinning of one mesh, unpacked from its POSITION, NORMAL, JOINTS_0 and
+// WEIGHTS_0 accessors whatever their component types. Weights are taken as they are, like wolf.vert does,
+// not renormalized.
+struct skin_vertices
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::u16vec4> joints;
+    std::vector<glm::vec4> weights;
+
+    std::size_t size() const { return positions.size(); }
+};
+
+// Throws if the mesh has no joints or weights
+skin_vertices load_skin_vertices(gltf_model const & model, gltf_model::mesh const & mesh);
+
+// What a skinned vertex shader would compute before the model matrix, laid out to be uploaded as is: a
+// vertex buffer with the position at location 0 (all the shadow pass needs) and the normal at location 1
+struct skinned_vertex
+{
+    glm::vec3 position;
+    glm::vec3 normal;   // normalized
+};
+
+// Each vertex transformed by the sum of the palette matrices of its joints times their weights, as in
+// wolf.vert. With SSE where available, one vertex at a time: the four matrices are blended as three
+// registers of their packed columns, and the normal is normalized with rsqrt and a Newton step.
+void skin(skin_vertices const & source, std::span<glm::mat4x3 const> palette, std::span<skinned_vertex> result);
+
+// The same in double precision, one matrix at a time, to check skin against
+void skin_reference(skin_vertices const & source, std::span<glm::mat4x3 const> palette, std::span<skinned_vertex> result);
+
+// A rigid transform as a unit dual quaternion real + ε dual, xyzw each: 8 floats, uploaded as a mat2x4 with
+// the real part in the first column. Rotates by `real`, then translates by 2 dual * conjugate(real).
+struct dual_quaternion
+{
+    glm::vec4 real;
+    glm::vec4 dual;
+};
+
+// The rigid part of every palette matrix: the rotation of its 3x3 part with the columns normalized, and its
+// translation. Any scale is dropped, dual quaternions cannot hold it.
+void to_dual_quaternions(std::span<glm::mat4x3 const> palette, std::span<dual_quaternion> result);
+
+// Dual quaternion skinning, as in wolf_dq.vert: the bones of a vertex blended in the hemisphere of its
+// first one and normalized, which keeps the volume where linear blending collapses it (twisted joints).
+// Matches skin for vertices bound to one bone with a rigid palette.
+void skin_dual_quaternion(skin_vertices const & source, std::span<dual_quaternion const> bones,
+    std::span<skinned_vertex> result);
@@ -0,0 +1,195 @@
+// CPU skinning benchmark and accuracy check.
+//
+// Usage: skinning_benchmark [frames] [model.gltf | model.glb]
+// Skins every skinned mesh of the model (the wolf by default) with the palette of every animation, at
+// `frames` frames 60 fps apart (1000 by default), with skin, with a scalar float loop and with the double
+// precision skin_reference, and prints their throughput in vertices per second. Every frame skin is checked
+// against the reference: the largest position difference relative to the size of the mesh, and the
+// largest angle between normals. Fails if either goes over 1e-5.
+// Then the palettes are converted to dual quaternions and skinned with skin_dual_quaternion, printing the
+// time of both, the uniform bytes saved, and how far the result is from linear blending: for every vertex
+// (they differ where bones blend, that is the point) and for vertices bound to one bone, which must agree
+// to within 1e-4 of the mesh size as long as the palette has no scale, how far from it is printed too.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+#include "gltf_loader.hpp"
+#include "skeleton_pose.hpp"
+#include "skinning.hpp"
+
+namespace {
+
+    float const max_position_error = 1e-5f;
+    float const max_normal_error = 1e-5f;
+    float const max_rigid_dual_quaternion_error = 1e-4f;
+
+    template <typename Function>
+    double average_us(int iterations, Function &&function) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < iterations; ++i)
+            function(i);
+        return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+    }
+
+    float frame_time(gltf_model::animation const &animation, int frame) {
+        return animation.max_time > 0.f ? std::fmod(frame / 60.f, animation.max_time) : 0.f;
+    }
+
+    void skin_scalar(skin_vertices const &source, std::span<glm::mat4x3 const> palette, std::span<skinned_vertex> result) {
+        for (std::size_t i = 0; i < source.size(); ++i) {
+            glm::u16vec4 const joints = source.joints[i];
+            glm::vec4 const weights = source.weights[i];
+            glm::mat4x3 const matrix = palette[joints.x] * weights.x + palette[joints.y] * weights.y
+                                       + palette[joints.z] * weights.z + palette[joints.w] * weights.w;
+            result[i].position = matrix * glm::vec4(source.positions[i], 1.f);
+            result[i].normal = glm::normalize(glm::mat3(matrix) * source.normals[i]);
+        }
+    }
+
+    struct skin_mesh {
+        skin_vertices source;
+        std::vector<skinned_vertex> result;
+        std::vector<skinned_vertex> expected;
+        std::vector<skinned_vertex> dual_quaternion;
+        float size = 0.f;
+    };
+
+    bool rigid(glm::vec4 const &weights) {
+        return std::max({weights.x, weights.y, weights.z, weights.w}) >= 0.999f;
+    }
+
+    double mvertices_per_second(std::size_t vertices, double us) {
+        return vertices / us;
+    }
+
+}
+
+int main(int argc, char *argv[]) try {
+    int const frames = argc > 1 ? std::stoi(argv[1]) : 1000;
+    std::string const path = argc > 2 ? argv[2] : std::string(PROJECT_ROOT) + "/external/wolf/Wolf-Blender-2.82a.gltf";
+
+    auto const model = load_gltf(path);
+    std::cout << path << ": " << model.bones.size() << " bones, " << model.animations.size() << " animations" << std::endl;
+
+    std::vector<skin_mesh> meshes;
+    std::size_t vertices = 0;
+    for (auto const &mesh: model.meshes) {
+        if (mesh.joints.count == 0 || mesh.weights.count == 0)
+            continue;
+        auto &result = meshes.emplace_back();
+        result.source = load_skin_vertices(model, mesh);
+        result.result.resize(result.source.size());
+        result.expected.resize(result.source.size());
+        result.dual_quaternion.resize(result.source.size());
+
+        glm::vec3 minimum(INFINITY), maximum(-INFINITY);
+        for (auto const &position: result.source.positions) {
+            minimum = glm::min(minimum, position);
+            maximum = glm::max(maximum, position);
+        }
+        result.size = glm::distance(minimum, maximum);
+        vertices += result.source.size();
+    }
+    std::cout << meshes.size() << " skinned meshes, " << vertices << " vertices" << std::endl;
+    if (meshes.empty())
+        return EXIT_SUCCESS;
+
+    pose_evaluator evaluator(model.bones);
+    skeleton_pose pose(model.bones.size());
+    std::vector<std::size_t> cursors;
+    bool failed = false;
+
+    for (auto const &[name, animation]: model.animations) {
+        // the palettes up front, only skinning is timed
+        std::vector<std::vector<glm::mat4x3>> palettes;
+        cursors.clear();
+        for (int frame = 0; frame < frames; ++frame) {
+            sample_pose(animation, frame_time(animation, frame), cursors, pose);
+            auto const palette = evaluator.evaluate(pose);
+            palettes.emplace_back(palette.begin(), palette.end());
+        }
+
+        float position_error = 0.f, normal_error = 0.f;
+        for (auto const &palette: palettes)
+            for (auto &mesh: meshes) {
+                skin(mesh.source, palette, mesh.result);
+                skin_reference(mesh.source, palette, mesh.expected);
+                for (std::size_t i = 0; i < mesh.result.size(); ++i) {
+                    position_error = std::max(position_error,
+                                              glm::distance(mesh.result[i].position, mesh.expected[i].position) / mesh.size);
+                    // acos of the dot product is no good for tiny angles in floats
+                    glm::vec3 const &a = mesh.result[i].normal, &b = mesh.expected[i].normal;
+                    normal_error = std::max(normal_error, std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)));
+                }
+            }
+
+        auto const time_skinning = [&](auto const &function) {
+            return average_us(frames, [&](int frame) {
+                for (auto &mesh: meshes)
+                    function(mesh.source, palettes[frame], mesh.result);
+            });
+        };
+        double const simd = time_skinning(skin);
+        double const scalar = time_skinning(skin_scalar);
+        double const reference = time_skinning(skin_reference);
+
+        std::cout << "  " << name << ":" << std::endl;
+        std::cout << "    skin " << simd << " us (" << mvertices_per_second(vertices, simd) << " M vertices/s), scalar "
+                  << scalar << " us (" << mvertices_per_second(vertices, scalar) << " M vertices/s, " << scalar / simd
+                  << "x), reference " << reference << " us (" << mvertices_per_second(vertices, reference) << " M vertices/s)"
+                  << std::endl;
+        std::cout << "    max difference to the reference: position " << position_error << " of the mesh size, normal "
+                  << normal_error << " radians" << std::endl;
+
+        if (position_error > max_position_error || normal_error > max_normal_error) {
+            std::cout << "    over the tolerance" << std::endl;
+            failed = true;
+        }
+
+        std::vector<std::vector<dual_quaternion>> dual_quaternions(frames, std::vector<dual_quaternion>(model.bones.size()));
+        double const conversion = average_us(frames, [&](int frame) {
+            to_dual_quaternions(palettes[frame], dual_quaternions[frame]);
+        });
+        double const dual_quaternion_time = average_us(frames, [&](int frame) {
+            for (auto &mesh: meshes)
+                skin_dual_quaternion(mesh.source, dual_quaternions[frame], mesh.dual_quaternion);
+        });
+
+        float scale = 0.f, difference = 0.f, rigid_difference = 0.f;
+        for (int frame = 0; frame < frames; ++frame) {
+            for (auto const &matrix: palettes[frame])
+                for (int c = 0; c < 3; ++c)
+                    scale = std::max(scale, std::abs(glm::length(matrix[c]) - 1.f));
+            for (auto &mesh: meshes) {
+                skin_reference(mesh.source, palettes[frame], mesh.expected);
+                skin_dual_quaternion(mesh.source, dual_quaternions[frame], mesh.dual_quaternion);
+                for (std::size_t i = 0; i < mesh.source.size(); ++i) {
+                    float const distance = glm::distance(mesh.dual_quaternion[i].position, mesh.expected[i].position) / mesh.size;
+                    difference = std::max(difference, distance);
+                    if (rigid(mesh.source.weights[i]))
+                        rigid_difference = std::max(rigid_difference, distance);
+                }
+            }
+        }
+
+        std::cout << "    dual quaternions: conversion " << conversion << " us, skinning " << dual_quaternion_time << " us, "
+                  << model.bones.size() * sizeof(dual_quaternion) << " uniform bytes instead of "
+                  << model.bones.size() * sizeof(glm::mat4x3) << std::endl;
+        std::cout << "    max difference to linear blending " << difference << " of the mesh size, " << rigid_difference
+                  << " for vertices bound to one bone, palette scale off by up to " << scale << std::endl;
+        if (scale < 1e-3f && rigid_difference > max_rigid_dual_quaternion_error) {
+            std::cout << "    over the tolerance" << std::endl;
+            failed = true;
+        }
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+catch (std::exception const &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,77 @@
+#include "texture_array.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// bilinear, texel centres to texel centres, edges clamped
+static void resample(cached_texture::level const & source, std::uint32_t width, std::uint32_t height, std::uint8_t * result)
+{
+    if (source.width == width && source.height == height)
+    {
+        std::memcpy(result, source.pixels.data(), source.pixels.size());
+        return;
+    }
+
+    float const scale_x = float(source.width) / width;
+    float const scale_y = float(source.height) / height;
+    for (std::uint32_t y = 0; y < height; ++y)
+    {
+        float const sy = std::clamp((y + 0.5f) * scale_y - 0.5f, 0.f, float(source.height - 1));
+        std::uint32_t const y0 = sy, y1 = std::min(y0 + 1, source.height - 1);
+        float const fy = sy - y0;
+        for (std::uint32_t x = 0; x < width; ++x)
+        {
+            float const sx = std::clamp((x + 0.5f) * scale_x - 0.5f, 0.f, float(source.width - 1));
+            std::uint32_t const x0 = sx, x1 = std::min(x0 + 1, source.width - 1);
+            float const fx = sx - x0;
+
+            auto const texel = [&](std::uint32_t tx, std::uint32_t ty, int c) -> float
+            {
+                return source.pixels[(std::size_t(ty) * source.width + tx) * 4 + c];
+            };
+            for (int c = 0; c < 4; ++c)
+            {
+                float const top = texel(x0, y0, c) + (texel(x1, y0, c) - texel(x0, y0, c)) * fx;
+                float const bottom = texel(x0, y1, c) + (texel(x1, y1, c) - texel(x0, y1, c)) * fx;
+                result[(std::size_t(y) * width + x) * 4 + c] = static_cast<std::uint8_t>(top + (bottom - top) * fy + 0.5f);
+            }
+        }
+    }
+}
+
+// the smallest level of `texture` at least `width` x `height`, the full size one if none is
+static cached_texture::level const & closest_level(cached_texture const & texture, std::uint32_t width, std::uint32_t height)
+{
+    std::size_t result = 0;
+    while (result + 1 < texture.levels.size() && texture.levels[result + 1].width >= width && texture.levels[result + 1].height >= height)
+        ++result;
+    return texture.levels[result];
+}
+
+std::vector<mip_level> build_texture_array(std::span<cached_texture const> textures)
+{
+    std::uint32_t width = 1, height = 1;
+    for (auto const & texture : textures)
+    {
+        width = std::max(width, texture.levels.front().width);
+        height = std::max(height, texture.levels.front().height);
+    }
+
+    std::vector<mip_level> result;
+    while (true)
+    {
+        auto & level = result.emplace_back();
+        level.width = width;
+        level.height = height;
+        std::size_t const layer_size = std::size_t(width) * height * 4;
+        level.pixels.resize(layer_size * textures.size());
+        for (std::size_t layer = 0; layer < textures.size(); ++layer)
+            resample(closest_level(textures[layer], width, height), width, height, level.pixels.data() + layer * layer_size);
+
+        if (width == 1 && height == 1)
+            break;
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+    }
+    return result;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "mip_chain.hpp"
+#include "texture_cache.hpp"
+
+// The mip chain of a texture array with one layer per texture, for materials to share one binding and pick
+// their layer with a per-draw constant. The layers take the largest width and the largest height of the
+// textures, and each level of a layer is resampled (bilinear, as stored) from the smallest level of its
+// texture that is at least as large, so a texture already at the layer size is copied and one at half the
+// size starts from its own full size level. Every level holds its layers one after the other, the way
+// glTexImage3D takes them.
+std::vector<mip_level> build_texture_array(std::span<cached_texture const> textures);
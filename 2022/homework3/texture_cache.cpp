@@ -0,0 +1,101 @@
+#include "texture_cache.hpp"
+#include "binary_cache.hpp"
+
+#include "stb_image.h"
+
+namespace
+{
+
+    constexpr std::array<char, 8> magic{'T', 'E', 'X', 'C', 'A', 'C', 'H', 'E'};
+    // bump whenever generate_mip_chain or the layout below changes
+    constexpr std::uint32_t version = 1;
+
+    void write_cache(std::filesystem::path const & path, binary_cache::source_key const & key, mip_content content,
+        std::span<mip_level const> levels)
+    {
+        binary_cache::writer writer(magic, version);
+        writer.write(key);
+        writer.write(content);
+
+        writer.write<std::uint32_t>(levels.size());
+        for (auto const & level : levels)
+        {
+            writer.write(level.width);
+            writer.write(level.height);
+            writer.write_array(level.pixels);
+        }
+
+        writer.save(binary_cache::cache_path(path));
+    }
+
+    void read_cache(cached_texture & result, binary_cache::source_key const & key, mip_content content)
+    {
+        binary_cache::reader reader(result.file.view(), magic, version);
+        reader.expect_key(key);
+        if (reader.read<mip_content>() != content)
+            throw std::runtime_error("Texture cache built for another content");
+
+        result.levels.resize(reader.read<std::uint32_t>());
+        for (auto & level : result.levels)
+        {
+            level.width = reader.read<std::uint32_t>();
+            level.height = reader.read<std::uint32_t>();
+            level.pixels = reader.read_array<std::uint8_t>();
+            if (level.pixels.size() != std::size_t(level.width) * level.height * 4)
+                throw std::runtime_error("Damaged texture cache");
+        }
+        if (result.levels.empty())
+            throw std::runtime_error("Damaged texture cache");
+    }
+
+}
+
+cached_texture load_texture_cached(std::filesystem::path const & path, mip_content content, job_scheduler * scheduler)
+{
+    cached_texture result;
+
+    auto const key = binary_cache::make_key(path);
+    auto const cache = binary_cache::cache_path(path);
+
+    if (std::filesystem::exists(cache))
+    {
+        try
+        {
+            result.file = mapped_file(cache);
+            read_cache(result, key, content);
+            result.from_cache = true;
+            return result;
+        }
+        catch (std::runtime_error const &)
+        {
+            // stale or damaged cache, rebuild it below
+            result = cached_texture{};
+        }
+    }
+
+    int width, height, channels;
+    auto pixels = stbi_load(path.string().data(), &width, &height, &channels, 4);
+    if (!pixels)
+        throw std::runtime_error("Failed to load texture " + path.string());
+    result.generated = generate_mip_chain(pixels, width, height, content, scheduler);
+    stbi_image_free(pixels);
+
+    for (auto const & level : result.generated)
+        result.levels.push_back({level.width, level.height, level.pixels});
+
+    try
+    {
+        write_cache(path, key, content, result.generated);
+    }
+    catch (std::runtime_error const &)
+    {
+        // the asset directory may be read-only, the cache is an optimization only
+    }
+
+    return result;
+}
+
+void write_texture_cache(std::filesystem::path const & path, mip_content content, std::span<mip_level const> levels)
+{
+    write_cache(path, binary_cache::make_key(path), content, levels);
+}
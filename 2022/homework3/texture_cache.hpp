@@ -0,0 +1,35 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "mip_chain.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+// The whole mip chain of an RGBA8 texture, either mapped from its binary cache or freshly decoded and
+// generated. The level pixels point into the mapped cache file or into `generated`.
+struct cached_texture
+{
+    struct level
+    {
+        std::uint32_t width = 0;
+        std::uint32_t height = 0;
+        std::span<std::uint8_t const> pixels;
+    };
+
+    std::vector<level> levels;
+
+    bool from_cache = false;
+
+    mapped_file file;
+    std::vector<mip_level> generated;
+};
+
+// Maps "<path>.cache" if it was built from the current image (size, mtime and content hash) for the same
+// `content`, otherwise decodes the image with stb_image, runs generate_mip_chain and (re)writes the cache.
+// Throws if the image cannot be decoded.
+cached_texture load_texture_cached(std::filesystem::path const & path, mip_content content, job_scheduler * scheduler = nullptr);
+
+void write_texture_cache(std::filesystem::path const & path, mip_content content, std::span<mip_level const> levels);
@@ -0,0 +1,244 @@
+#include "texture_streamer.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include "texture_cache.hpp"
+#include "texture_array.hpp"
+
+texture_streamer::texture_streamer(texture_streaming_options const & options)
+    : options_(options)
+{
+    for (unsigned int t = 0; t < std::max(1u, options_.threads); ++t)
+        workers_.emplace_back([this]{ work(); });
+}
+
+texture_streamer::~texture_streamer()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    requested_.notify_all();
+    for (auto & worker : workers_)
+        worker.join();
+}
+
+GLuint texture_streamer::load(std::string const & path, mip_content content, glm::u8vec4 placeholder)
+{
+    return create({path}, GL_TEXTURE_2D, content, placeholder);
+}
+
+GLuint texture_streamer::load_array(std::vector<std::string> const & paths, mip_content content, glm::u8vec4 placeholder)
+{
+    return create(paths, GL_TEXTURE_2D_ARRAY, content, placeholder);
+}
+
+GLuint texture_streamer::create(std::vector<std::string> const & paths, GLenum target, mip_content content, glm::u8vec4 placeholder)
+{
+    GLint active;
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+    glActiveTexture(GL_TEXTURE0);
+
+    entry result;
+    result.target = target;
+    result.layers = paths.size();
+    result.path = paths.front();
+    result.last_use = frame_;
+    glGenTextures(1, &result.texture);
+    glBindTexture(target, result.texture);
+    define(result, 0, 1, 1, std::vector<glm::u8vec4>(result.layers, placeholder).data());
+    glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glActiveTexture(active);
+
+    std::size_t const index = entries_.size();
+    indices_[result.texture] = index;
+    entries_.push_back(std::move(result));
+
+    {
+        std::lock_guard lock(mutex_);
+        requests_.push_back({index, paths, target == GL_TEXTURE_2D_ARRAY, content});
+    }
+    requested_.notify_one();
+
+    return entries_.back().texture;
+}
+
+void texture_streamer::use(GLuint texture)
+{
+    if (auto it = indices_.find(texture); it != indices_.end())
+        entries_[it->second].last_use = frame_;
+}
+
+void texture_streamer::work()
+{
+    while (true)
+    {
+        request next;
+        {
+            std::unique_lock lock(mutex_);
+            requested_.wait(lock, [this]{ return stop_ || !requests_.empty(); });
+            if (stop_)
+                return;
+            next = std::move(requests_.front());
+            requests_.pop_front();
+        }
+
+        decoded result{next.entry, {}};
+        try
+        {
+            // the workers already run in parallel over the textures, so one thread per mip chain
+            if (next.array)
+            {
+                std::vector<cached_texture> layers;
+                for (auto const & path : next.paths)
+                    layers.push_back(load_texture_cached(path, next.content));
+                result.source.generated = build_texture_array(layers);
+                for (auto const & level : result.source.generated)
+                    result.source.levels.push_back({level.width, level.height, level.pixels});
+            }
+            else
+                result.source = load_texture_cached(next.paths.front(), next.content);
+        }
+        catch (std::runtime_error const &)
+        {
+            // reported by update
+        }
+
+        std::lock_guard lock(mutex_);
+        decoded_.push_back(std::move(result));
+    }
+}
+
+// (re)defines a level of the texture bound to its target, all the layers at once for an array
+void texture_streamer::define(entry const & entry, int level, int width, int height, void const * pixels)
+{
+    if (entry.target == GL_TEXTURE_2D_ARRAY)
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, width, height, width ? entry.layers : 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    else
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+}
+
+void texture_streamer::upload(entry & entry, int level)
+{
+    auto const & source = entry.source.levels[level];
+    glBindTexture(entry.target, entry.texture);
+    define(entry, level, source.width, source.height, source.pixels.data());
+    glTexParameteri(entry.target, GL_TEXTURE_BASE_LEVEL, level);
+
+    entry.base = level;
+    statistics_.resident_bytes += source.pixels.size();
+    statistics_.uploaded_bytes += source.pixels.size();
+}
+
+void texture_streamer::evict(entry & entry)
+{
+    // the levels below the base level are left out of completeness, an empty one frees its memory
+    int const level = entry.base;
+    glBindTexture(entry.target, entry.texture);
+    glTexParameteri(entry.target, GL_TEXTURE_BASE_LEVEL, level + 1);
+    define(entry, level, 0, 0, nullptr);
+
+    entry.base = level + 1;
+    statistics_.resident_bytes -= entry.source.levels[level].pixels.size();
+    ++statistics_.evicted_levels;
+}
+
+// Evicts the finest levels of textures used before `priority` until `bytes` more fit in the memory budget,
+// least recently used first. False if they cannot be made to fit.
+bool texture_streamer::make_room(std::size_t bytes, std::uint64_t priority)
+{
+    while (statistics_.resident_bytes + bytes > options_.memory_budget)
+    {
+        entry * victim = nullptr;
+        for (auto & entry : entries_)
+            if (entry.decoded && entry.base < entry.coarse && entry.last_use < priority
+                && (!victim || entry.last_use < victim->last_use || (entry.last_use == victim->last_use && entry.base < victim->base)))
+                victim = &entry;
+        if (!victim)
+            return false;
+        evict(*victim);
+    }
+    return true;
+}
+
+void texture_streamer::update()
+{
+    GLint active;
+    glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+    glActiveTexture(GL_TEXTURE0);
+
+    statistics_.uploaded_bytes = 0;
+
+    std::vector<decoded> decoded;
+    {
+        std::lock_guard lock(mutex_);
+        decoded.swap(decoded_);
+    }
+
+    // the coarse levels right away, whatever the budget says
+    for (auto & result : decoded)
+    {
+        auto & entry = entries_[result.entry];
+        entry.decoded = true;
+        if (result.source.levels.empty())
+        {
+            std::cerr << "Failed to load " << entry.path << std::endl;
+            continue;
+        }
+
+        entry.source = std::move(result.source);
+        auto const & levels = entry.source.levels;
+        int const count = levels.size();
+        entry.coarse = count - 1;
+        while (entry.coarse > 0 && std::max<std::uint32_t>(levels[entry.coarse - 1].width, levels[entry.coarse - 1].height) <= std::uint32_t(options_.resident_size))
+            --entry.coarse;
+
+        glBindTexture(entry.target, entry.texture);
+        glTexParameteri(entry.target, GL_TEXTURE_MAX_LEVEL, count - 1);
+        for (int level = count - 1; level >= entry.coarse; --level)
+            upload(entry, level);
+    }
+
+    // then finer levels, one at a time, to the textures used last, coarser levels first among those
+    while (true)
+    {
+        entry * next = nullptr;
+        for (auto & entry : entries_)
+            if (entry.decoded && !entry.source.levels.empty() && entry.base > 0
+                && (!next || entry.last_use > next->last_use || (entry.last_use == next->last_use && entry.base > next->base)))
+                next = &entry;
+        if (!next)
+            break;
+
+        std::size_t const bytes = next->source.levels[next->base - 1].pixels.size();
+        if (statistics_.uploaded_bytes > 0 && statistics_.uploaded_bytes + bytes > options_.upload_budget)
+            break;
+        if (!make_room(bytes, next->last_use))
+            break;
+        upload(*next, next->base - 1);
+    }
+
+    glActiveTexture(active);
+    ++frame_;
+}
+
+texture_streamer::statistics texture_streamer::stats() const
+{
+    statistics result = statistics_;
+    result.textures = entries_.size();
+    for (auto const & entry : entries_)
+    {
+        result.decoding += !entry.decoded;
+        result.streaming += entry.decoded && entry.base > 0;
+    }
+    return result;
+}
+
+bool texture_streamer::idle() const
+{
+    return std::all_of(entries_.begin(), entries_.end(), [](entry const & entry) { return entry.decoded && entry.base == 0; });
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/gtc/type_precision.hpp>
+
+#include "texture_cache.hpp"
+
+struct texture_streaming_options
+{
+    std::size_t upload_budget = 4 << 20;    // bytes uploaded by one update, at least one level goes through
+    std::size_t memory_budget = 256 << 20;  // of the levels resident in all the textures
+    unsigned int threads = 2;               // decoding
+    int resident_size = 64;                 // levels no larger are uploaded at once and never evicted
+};
+
+// Loads RGBA8 2D textures and texture arrays without stalling the render thread. load returns a texture
+// that can be bound right away: a 1x1 placeholder at first, then, once a worker thread has loaded its mip
+// chain (mapped from the texture cache, or decoded and generated, see texture_cache.hpp), the coarse
+// levels, and then each finer level as update finds room for it in the upload budget. GL_TEXTURE_BASE_LEVEL
+// is the finest level resident, so the texture is always complete. When the levels resident go over the
+// memory budget, the finest levels of the textures used least recently are evicted (redefined empty), never
+// those of a texture used more recently than the one that needs the room. They stream back in when there is
+// room again, from the levels that stay in memory (or mapped).
+//
+// All the GL calls are made by load, load_array and update, on texture unit 0 (the active unit is
+// restored), so textures bound to other units stay put. The textures are left to the GL context.
+class texture_streamer
+{
+public:
+    explicit texture_streamer(texture_streaming_options const & options = {});
+    ~texture_streamer();
+
+    texture_streamer(texture_streamer const &) = delete;
+    texture_streamer & operator=(texture_streamer const &) = delete;
+
+    // `content` says how the mip levels are averaged, `placeholder` is the colour shown until the file is
+    // decoded, e.g. a flat normal for normal maps
+    GLuint load(std::string const & path, mip_content content = mip_content::color, glm::u8vec4 placeholder = {128, 128, 128, 255});
+
+    // as load, but a GL_TEXTURE_2D_ARRAY with one layer per path, see build_texture_array
+    GLuint load_array(std::vector<std::string> const & paths, mip_content content = mip_content::color,
+        glm::u8vec4 placeholder = {128, 128, 128, 255});
+
+    // marks `texture` as used by the current frame: textures used last get their finer levels first and
+    // are evicted last
+    void use(GLuint texture);
+
+    // Takes in what the workers decoded, uploads finer levels within the budgets and starts a new frame.
+    // Call once a frame.
+    void update();
+
+    struct statistics
+    {
+        std::size_t textures = 0;
+        std::size_t decoding = 0;       // not decoded yet
+        std::size_t streaming = 0;      // decoded with levels still to upload
+        std::size_t resident_bytes = 0;
+        std::size_t uploaded_bytes = 0; // by the last update
+        std::size_t evicted_levels = 0; // since the start
+    };
+
+    statistics stats() const;
+
+    // every texture decoded with all its levels resident
+    bool idle() const;
+
+private:
+    struct entry
+    {
+        GLuint texture = 0;
+        GLenum target = GL_TEXTURE_2D;
+        int layers = 1;             // of a GL_TEXTURE_2D_ARRAY
+        std::string path;           // the first layer's for an array
+        cached_texture source;      // no levels until decoded
+        int base = 0;               // finest level resident, source.levels.size() when none is
+        int coarse = 0;             // finest level that is never evicted
+        std::uint64_t last_use = 0;
+        bool decoded = false;
+    };
+
+    struct decoded
+    {
+        std::size_t entry;
+        cached_texture source;      // no levels if the file could not be decoded
+    };
+
+    struct request
+    {
+        std::size_t entry;
+        std::vector<std::string> paths;
+        bool array;
+        mip_content content;
+    };
+
+    GLuint create(std::vector<std::string> const & paths, GLenum target, mip_content content, glm::u8vec4 placeholder);
+    void work();
+    void define(entry const & entry, int level, int width, int height, void const * pixels);
+    void upload(entry & entry, int level);
+    void evict(entry & entry);
+    bool make_room(std::size_t bytes, std::uint64_t priority);
+
+    texture_streaming_options options_;
+    std::vector<entry> entries_;
+    std::unordered_map<GLuint, std::size_t> indices_;
+    std::uint64_t frame_ = 1;
+    statistics statistics_;
+
+    std::mutex mutex_;
+    std::condition_variable requested_;
+    std::deque<request> requests_;
+    std::vector<decoded> decoded_;
+    bool stop_ = false;
+    std::vector<std::thread> workers_;
+};
@@ -31,6 +31,7 @@
 #include <glm/gtx/string_cast.hpp>
 
 #include "gltf_loader.hpp"
+#include "skeleton_pose.hpp"
 #include "stb_image.h"
 
 std::string to_string(std::string_view str) {
@@ -282,6 +283,12 @@ int main() try {
     bool paused = false;
     float interpolation = 0.f;
 
+    auto const &walk_animation = input_model.animations.at("02_walk");
+    auto const &run_animation = input_model.animations.at("01_Run");
+
+    pose_evaluator input_pose(input_model.bones);
+    skeleton_pose walk_pose(input_model.bones.size()), run_pose(input_model.bones.size()), blended_pose(input_model.bones.size());
+
     bool running = true;
     while (running) {
         for (SDL_Event event; SDL_PollEvent(&event);)
@@ -347,7 +354,6 @@ int main() try {
 
         float near = 0.01f;
         float far = 100.f;
-        float scale = 0.75f + cos(time) * 0.25f;
 
         glm::mat4 model(1.f);
 
@@ -363,44 +369,26 @@ int main() try {
 
         glm::vec3 light_direction = glm::normalize(glm::vec3(1.f, 2.f, 3.f));
 
-        std::vector<glm::mat4x3> bones = std::vector<glm::mat4x3>(input_model.bones.size(), glm::mat4x3(scale));
-
-        auto run_animation = input_model.animations.at( "01_Run");
-        auto walk_animation = input_model.animations.at( "02_walk");
-
         float walk_frame = fmod(time * animation_speed, walk_animation.max_time);
         float run_frame = fmod(time * animation_speed, run_animation.max_time);
 
-        for (int i = 0; i < bones.size(); ++i) {
-            glm::mat4 transform = glm::mat4(1.f);
-            int p = i;
-            while (p != -1) {
-                auto walk_bone = walk_animation.bones[p];
-                auto run_bone = run_animation.bones[p];
-
-                auto t = walk_bone.translation(walk_frame) * (1 - interpolation) + run_bone.translation(run_frame) * interpolation;
-                auto r = walk_bone.rotation(walk_frame) * (1 - interpolation) + run_bone.rotation(run_frame) * interpolation;
-                auto s = walk_bone.scale(walk_frame) * (1 - interpolation) + run_bone.scale(run_frame) * interpolation;
+        sample_pose(walk_animation, walk_frame, walk_pose);
+        sample_pose(run_animation, run_frame, run_pose);
 
-                glm::mat4 translation = glm::translate(glm::mat4(1.f), t);
-                glm::mat4 rotation = glm::toMat4(r);
-                glm::mat4 scaling = glm::scale(glm::mat4(1.f), s);
-                transform = translation * rotation * scaling * transform;
-
-                p = input_model.bones[p].parent;
-            }
-            bones[i] = transform;
-        }
-        for (int i = 0; i < bones.size(); ++i) {
-            bones[i] = bones[i] * input_model.bones[i].inverse_bind_matrix;
+        for (std::size_t i = 0; i < blended_pose.size(); ++i) {
+            blended_pose.translations[i] = walk_pose.translations[i] * (1 - interpolation) + run_pose.translations[i] * interpolation;
+            blended_pose.rotations[i] = walk_pose.rotations[i] * (1 - interpolation) + run_pose.rotations[i] * interpolation;
+            blended_pose.scales[i] = walk_pose.scales[i] * (1 - interpolation) + run_pose.scales[i] * interpolation;
         }
 
+        auto const bones = input_pose.evaluate(blended_pose);
+
         glUseProgram(program);
         glUniformMatrix4fv(model_location, 1, GL_FALSE, reinterpret_cast<float *>(&model));
         glUniformMatrix4fv(view_location, 1, GL_FALSE, reinterpret_cast<float *>(&view));
         glUniformMatrix4fv(projection_location, 1, GL_FALSE, reinterpret_cast<float *>(&projection));
         glUniform3fv(light_direction_location, 1, reinterpret_cast<float *>(&light_direction));
-        glUniformMatrix4x3fv(bones_location, bones.size(), GL_FALSE, reinterpret_cast<float *>(bones.data()));
+        glUniformMatrix4x3fv(bones_location, bones.size(), GL_FALSE, reinterpret_cast<float const *>(bones.data()));
 
         auto draw_meshes = [&](bool transparent) {
             for (auto const &mesh: meshes) {
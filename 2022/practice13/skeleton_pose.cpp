@@ -0,0 +1,69 @@
+#include "skeleton_pose.hpp"
+
+#include <cassert>
+
+#include <glm/mat3x3.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+static constexpr std::uint32_t no_parent = -1;
+
+// translation * rotation * scale
+static glm::mat4x3 to_matrix(glm::vec3 const & translation, glm::quat const & rotation, glm::vec3 const & scale)
+{
+    glm::mat3 const r = glm::mat3_cast(rotation);
+    return glm::mat4x3(r[0] * scale.x, r[1] * scale.y, r[2] * scale.z, translation);
+}
+
+// a * b of affine transforms
+static glm::mat4x3 compose(glm::mat4x3 const & a, glm::mat4x3 const & b)
+{
+    glm::mat3 const linear(a);
+    return glm::mat4x3(linear * b[0], linear * b[1], linear * b[2], linear * b[3] + a[3]);
+}
+
+skeleton_pose::skeleton_pose(std::size_t bones)
+    : translations(bones, glm::vec3(0.f))
+    , rotations(bones, glm::quat(1.f, 0.f, 0.f, 0.f))
+    , scales(bones, glm::vec3(1.f))
+{}
+
+void sample_pose(gltf_model::animation const & animation, float time, skeleton_pose & pose)
+{
+    assert(pose.size() == animation.bones.size());
+
+    for (std::size_t i = 0; i < animation.bones.size(); ++i)
+    {
+        auto const & bone = animation.bones[i];
+        pose.translations[i] = bone.translation.values.empty() ? glm::vec3(0.f) : bone.translation(time);
+        pose.rotations[i] = bone.rotation.values.empty() ? glm::quat(1.f, 0.f, 0.f, 0.f) : bone.rotation(time);
+        pose.scales[i] = bone.scale.values.empty() ? glm::vec3(1.f) : bone.scale(time);
+    }
+}
+
+pose_evaluator::pose_evaluator(std::vector<gltf_model::bone> const & bones)
+    : parents_(bones.size())
+    , inverse_binds_(bones.size())
+    , globals_(bones.size())
+    , palette_(bones.size())
+{
+    for (std::size_t i = 0; i < bones.size(); ++i)
+    {
+        parents_[i] = bones[i].parent;
+        assert(parents_[i] == no_parent || parents_[i] < i);
+        inverse_binds_[i] = glm::mat4x3(bones[i].inverse_bind_matrix);
+    }
+}
+
+std::span<glm::mat4x3 const> pose_evaluator::evaluate(skeleton_pose const & pose)
+{
+    assert(pose.size() == size());
+
+    for (std::size_t i = 0; i < parents_.size(); ++i)
+    {
+        glm::mat4x3 const local = to_matrix(pose.translations[i], pose.rotations[i], pose.scales[i]);
+        globals_[i] = parents_[i] == no_parent ? local : compose(globals_[parents_[i]], local);
+        palette_[i] = compose(globals_[i], inverse_binds_[i]);
+    }
+
+    return palette_;
+}
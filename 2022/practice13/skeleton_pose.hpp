@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/mat4x3.hpp>
+
+#include "gltf_loader.hpp"
+
+// Local transforms of every bone of a skeleton, one element per bone
+struct skeleton_pose
+{
+    std::vector<glm::vec3> translations;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+
+    skeleton_pose() = default;
+    explicit skeleton_pose(std::size_t bones);
+
+    std::size_t size() const { return rotations.size(); }
+};
+
+// Samples every channel of `animation` into `pose`, channels without keys give the identity
+void sample_pose(gltf_model::animation const & animation, float time, skeleton_pose & pose);
+
+// Turns local poses into the skinning palette. Global transforms are composed in one pass over the bones,
+// parents come before their children in glTF skins as loaded, and multiplied by the inverse bind matrices.
+// All the storage is allocated up front, evaluating a pose does not allocate.
+class pose_evaluator
+{
+public:
+    pose_evaluator() = default;
+    explicit pose_evaluator(std::vector<gltf_model::bone> const & bones);
+
+    std::size_t size() const { return parents_.size(); }
+
+    // returns the palette
+    std::span<glm::mat4x3 const> evaluate(skeleton_pose const & pose);
+
+    std::span<glm::mat4x3 const> globals() const { return globals_; }
+    std::span<glm::mat4x3 const> palette() const { return palette_; }
+
+private:
+    std::vector<std::uint32_t> parents_;
+    std::vector<glm::mat4x3> inverse_binds_;
+    std::vector<glm::mat4x3> globals_;
+    std::vector<glm::mat4x3> palette_;
+};
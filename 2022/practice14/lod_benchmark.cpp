@@ -0,0 +1,105 @@
+// LOD chain generation benchmark.
+//
+// Usage: lod_benchmark [model.gltf] [levels] [max threads]
+// Builds a `levels`-deep LOD chain for every mesh of the model (bunny/bunny.gltf by default, any
+// single-buffer glTF such as Sponza works) with 1, 2, 4, ... worker threads and prints the chain
+// it got, down to where the last mesh stops simplifying.
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "gltf_loader.hpp"
+#include "simplifier.hpp"
+
+std::vector<std::uint32_t> read_indices(gltf_model const & model, gltf_model::accessor const & accessor)
+{
+    std::vector<std::uint32_t> result(accessor.count);
+    char const * data = model.buffer.data() + accessor.view.offset;
+    for (std::size_t i = 0; i < result.size(); ++i)
+    {
+        if (accessor.type == 0x1405) // GL_UNSIGNED_INT
+            std::memcpy(&result[i], data + 4 * i, 4);
+        else if (accessor.type == 0x1403) // GL_UNSIGNED_SHORT
+        {
+            std::uint16_t index;
+            std::memcpy(&index, data + 2 * i, 2);
+            result[i] = index;
+        }
+        else
+            result[i] = static_cast<unsigned char>(data[i]);
+    }
+    return result;
+}
+
+int main(int argc, char * argv[]) try
+{
+    std::string path = argc > 1 ? argv[1] : std::string(PROJECT_ROOT) + "/bunny/bunny.gltf";
+    lod_options options;
+    if (argc > 2)
+        options.levels = std::stoi(argv[2]);
+    unsigned int max_threads = argc > 3 ? std::stoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+
+    auto const model = load_gltf(path);
+
+    std::vector<std::vector<std::uint32_t>> indices;
+    std::vector<simplify_mesh> meshes;
+    std::size_t triangles = 0;
+    for (auto const & mesh : model.meshes)
+    {
+        indices.push_back(read_indices(model, mesh.indices));
+        triangles += indices.back().size() / 3;
+    }
+    for (std::size_t i = 0; i < model.meshes.size(); ++i)
+    {
+        auto const & position = model.meshes[i].position;
+        meshes.push_back({reinterpret_cast<float const *>(model.buffer.data() + position.view.offset), position.count, 12, indices[i]});
+    }
+
+    std::cout << path << ": " << meshes.size() << " meshes, " << triangles << " triangles" << std::endl;
+
+    lod_chain chain;
+    double single_ms = 0.0;
+    for (unsigned int threads = 1;; threads = std::min(threads * 2, max_threads))
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        chain = build_lod_chain(meshes, options, threads);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        if (threads == 1)
+            single_ms = ms;
+        std::cout << "  " << threads << " threads: " << ms << " ms, x" << single_ms / ms << std::endl;
+        if (threads >= max_threads)
+            break;
+    }
+
+    // meshes that ran out of levels count with their last one
+    for (unsigned int level = 0; level < options.levels; ++level)
+    {
+        std::size_t level_triangles = 0, ended = 0;
+        float error = 0.f;
+        for (auto const & levels : chain.meshes)
+        {
+            if (levels.empty())
+                continue;
+            ended += level >= levels.size();
+            auto const & lod = levels[std::min<std::size_t>(level, levels.size() - 1)];
+            level_triangles += lod.count / 3;
+            error = std::max(error, lod.error);
+        }
+        if (ended == chain.meshes.size())
+            break;
+        std::cout << "  LOD " << level << ": " << level_triangles << " triangles, max error " << error;
+        if (ended > 0)
+            std::cout << " (" << ended << " meshes already at their last level)";
+        std::cout << std::endl;
+    }
+    std::cout << "  shared index buffer: " << chain.indices.size() * sizeof(chain.indices[0]) / 1024 << " KiB" << std::endl;
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
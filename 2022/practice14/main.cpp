@@ -16,6 +16,7 @@
 #include <random>
 #include <map>
 #include <cmath>
+#include <cstring>
 
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
@@ -30,6 +31,7 @@
 #include "aabb.hpp"
 #include "frustum.hpp"
 #include "intersect.hpp"
+#include "simplifier.hpp"
 
 std::string to_string(std::string_view str)
 {
@@ -195,27 +197,50 @@ int main() try
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     glBufferData(GL_ARRAY_BUFFER, input_model.buffer.size(), input_model.buffer.data(), GL_STATIC_DRAW);
 
-    std::vector<GLuint> vaos;
-    for (int i = 0; i < input_model.meshes.size(); ++i)
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    auto setup_attribute = [](int index, gltf_model::accessor const & accessor)
     {
-        GLuint vao;
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
+        glEnableVertexAttribArray(index);
+        glVertexAttribPointer(index, accessor.size, accessor.type, GL_FALSE, 0, reinterpret_cast<void *>(accessor.view.offset));
+    };
+
+    setup_attribute(0, input_model.meshes[0].position);
+    setup_attribute(1, input_model.meshes[0].normal);
+    setup_attribute(2, input_model.meshes[0].texcoord);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo);
+    // LODs are generated from the most detailed mesh and share its vertices, one index buffer holds them all
+    std::vector<lod_level> lods;
+    {
+        auto const & mesh = input_model.meshes[0];
+        assert(mesh.indices.type == GL_UNSIGNED_SHORT);
 
-        auto setup_attribute = [](int index, gltf_model::accessor const & accessor)
+        std::vector<std::uint32_t> indices(mesh.indices.count);
+        for (std::size_t i = 0; i < indices.size(); ++i)
         {
-            glEnableVertexAttribArray(index);
-            glVertexAttribPointer(index, accessor.size, accessor.type, GL_FALSE, 0, reinterpret_cast<void *>(accessor.view.offset));
-        };
+            std::uint16_t index;
+            std::memcpy(&index, input_model.buffer.data() + mesh.indices.view.offset + i * sizeof(index), sizeof(index));
+            indices[i] = index;
+        }
 
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        setup_attribute(0, input_model.meshes[i].position);
-        setup_attribute(1, input_model.meshes[i].normal);
-        setup_attribute(2, input_model.meshes[i].texcoord);
+        simplify_mesh source{reinterpret_cast<float const *>(input_model.buffer.data() + mesh.position.view.offset),
+            mesh.position.count, sizeof(glm::vec3), indices};
 
-        vaos.push_back(vao);
+        auto start = std::chrono::high_resolution_clock::now();
+        auto chain = build_lod_chain({&source, 1}, {6, 0.5f});
+        std::cout << "LODs built in " << std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms:";
+        for (auto const & lod : chain.meshes[0])
+            std::cout << " " << lod.count / 3;
+        std::cout << " triangles" << std::endl;
+
+        lods = chain.meshes[0];
+
+        GLuint ebo;
+        glGenBuffers(1, &ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, chain.indices.size() * sizeof(chain.indices[0]), chain.indices.data(), GL_STATIC_DRAW);
     }
 
     GLuint texture;
@@ -242,13 +267,10 @@ int main() try
     glGenBuffers(1, &instance_vbo);
     glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
 
-    for (auto vao : vaos) {
-        glBindVertexArray(vao);
-
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-        glVertexAttribDivisor(3, 1);
-    }
+    glBindVertexArray(vao);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glVertexAttribDivisor(3, 1);
 
     auto last_frame_start = std::chrono::high_resolution_clock::now();
 
@@ -375,7 +397,8 @@ int main() try
         glm::vec3 light_direction = glm::normalize(glm::vec3(1.f, 2.f, 3.f));
 
 
-        std::vector<glm::vec3> instances[6];
+        // the chain may stop short of 6 levels, further away instances take its last one
+        std::vector<std::vector<glm::vec3>> instances(lods.size());
         frustum frustum(projection * view);
 
             for (int i = 0; i < 32; ++i) {
@@ -384,7 +407,7 @@ int main() try
                     aabb aabb(input_model.meshes[0].min + translation,
                               input_model.meshes[0].max + translation);
                     if (intersect(aabb, frustum)) {
-                        int lod = std::max(0, std::min(5, (int)std::round(glm::distance(translation, camera_position) / lod_const)));
+                        int lod = std::max(0, std::min((int)lods.size() - 1, (int)std::round(glm::distance(translation, camera_position) / lod_const)));
                         instances[lod].push_back(translation);
                     }
                 }
@@ -399,14 +422,13 @@ int main() try
 
         glBindTexture(GL_TEXTURE_2D, texture);
 
-        for (int lod = 0; lod < 6; ++lod)
+        glBindVertexArray(vao);
+        for (std::size_t lod = 0; lod < lods.size(); ++lod)
         {
-            auto const &mesh = input_model.meshes[lod];
-            glBindVertexArray(vaos[lod]);
             glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
             glBufferData(GL_ARRAY_BUFFER, instances[lod].size() * sizeof(glm::vec3), instances[lod].data(), GL_STATIC_DRAW);
-            glDrawElementsInstanced(GL_TRIANGLES, mesh.indices.count, mesh.indices.type,
-                                    reinterpret_cast<void *>(mesh.indices.view.offset), instances[lod].size());
+            glDrawElementsInstanced(GL_TRIANGLES, lods[lod].count, GL_UNSIGNED_INT,
+                                    reinterpret_cast<void *>(lods[lod].first * sizeof(std::uint32_t)), instances[lod].size());
         }
 
         glEndQuery(GL_TIME_ELAPSED);
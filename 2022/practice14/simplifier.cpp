@@ -0,0 +1,340 @@
+#include "simplifier.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+
+    struct quadric
+    {
+        // symmetric 3x3 matrix A, vector b and scalar c of x^T A x + 2 b^T x + c, plus the total weight
+        double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+        double b0 = 0, b1 = 0, b2 = 0;
+        double c = 0;
+        double weight = 0;
+
+        quadric & operator += (quadric const & other)
+        {
+            a00 += other.a00; a11 += other.a11; a22 += other.a22;
+            a01 += other.a01; a02 += other.a02; a12 += other.a12;
+            b0 += other.b0; b1 += other.b1; b2 += other.b2;
+            c += other.c;
+            weight += other.weight;
+            return *this;
+        }
+    };
+
+    // squared distance to the plane n.x + d = 0 (n normalized), times weight
+    quadric plane_quadric(glm::dvec3 const & n, double d, double weight)
+    {
+        quadric q;
+        q.a00 = weight * n.x * n.x; q.a11 = weight * n.y * n.y; q.a22 = weight * n.z * n.z;
+        q.a01 = weight * n.x * n.y; q.a02 = weight * n.x * n.z; q.a12 = weight * n.y * n.z;
+        q.b0 = weight * n.x * d; q.b1 = weight * n.y * d; q.b2 = weight * n.z * d;
+        q.c = weight * d * d;
+        q.weight = weight;
+        return q;
+    }
+
+    // weighted mean squared distance of p to the planes of q
+    double evaluate(quadric const & q, glm::vec3 const & p)
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double result = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+            + 2 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+            + 2 * (q.b0 * x + q.b1 * y + q.b2 * z)
+            + q.c;
+        return q.weight > 0 ? std::abs(result) / q.weight : 0.0;
+    }
+
+    glm::vec3 position(simplify_mesh const & mesh, std::uint32_t index)
+    {
+        glm::vec3 result;
+        std::memcpy(&result, reinterpret_cast<char const *>(mesh.positions) + index * mesh.stride, sizeof(result));
+        return result;
+    }
+
+    struct position_hash
+    {
+        std::size_t operator()(std::array<std::uint32_t, 3> const & key) const
+        {
+            return (key[0] * 73856093u) ^ (key[1] * 19349663u) ^ (key[2] * 83492791u);
+        }
+    };
+
+    std::uint64_t edge_key(std::uint32_t a, std::uint32_t b)
+    {
+        if (a > b)
+            std::swap(a, b);
+        return (std::uint64_t(a) << 32) | b;
+    }
+
+    struct collapse
+    {
+        std::uint32_t from;
+        std::uint32_t to;
+        double cost;
+    };
+
+}
+
+std::vector<std::uint32_t> simplify(simplify_mesh const & mesh, std::size_t target_index_count,
+    float target_error, float * result_error)
+{
+    std::vector<std::uint32_t> result(mesh.indices.begin(), mesh.indices.end());
+    if (result_error)
+        *result_error = 0.f;
+    if (result.size() <= target_index_count || mesh.vertex_count == 0)
+        return result;
+
+    // vertices sharing a position are one vertex for the topology and the quadrics
+    std::vector<std::uint32_t> canonical(mesh.vertex_count);
+    std::vector<std::uint32_t> copies(mesh.vertex_count, 0);
+    {
+        std::unordered_map<std::array<std::uint32_t, 3>, std::uint32_t, position_hash> welded;
+        for (std::uint32_t v = 0; v < mesh.vertex_count; ++v)
+        {
+            std::array<std::uint32_t, 3> key;
+            auto p = position(mesh, v);
+            std::memcpy(key.data(), &p, sizeof(key));
+            canonical[v] = welded.try_emplace(key, v).first->second;
+            ++copies[canonical[v]];
+        }
+    }
+
+    glm::vec3 min = position(mesh, 0), max = min;
+    for (std::uint32_t v = 1; v < mesh.vertex_count; ++v)
+    {
+        min = glm::min(min, position(mesh, v));
+        max = glm::max(max, position(mesh, v));
+    }
+    float const extent = std::max({max.x - min.x, max.y - min.y, max.z - min.z});
+    double const max_cost = double(target_error) * extent * target_error * extent;
+
+    std::vector<quadric> quadrics(mesh.vertex_count);
+    std::unordered_map<std::uint64_t, int> edge_use;
+    for (std::size_t i = 0; i < result.size(); i += 3)
+    {
+        std::uint32_t c[3] = {canonical[result[i]], canonical[result[i + 1]], canonical[result[i + 2]]};
+
+        glm::dvec3 p0 = position(mesh, c[0]), p1 = position(mesh, c[1]), p2 = position(mesh, c[2]);
+        glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(n);
+        if (length > 0)
+        {
+            n /= length;
+            auto q = plane_quadric(n, -glm::dot(n, p0), length * 0.5);
+            for (auto v : c)
+                quadrics[v] += q;
+        }
+
+        for (int k = 0; k < 3; ++k)
+            ++edge_use[edge_key(c[k], c[(k + 1) % 3])];
+    }
+
+    // borders and attribute seams keep their vertices, which keeps holes and texture islands in shape
+    std::vector<bool> locked(mesh.vertex_count, false);
+    for (auto const & [key, count] : edge_use)
+        if (count != 2)
+            locked[key >> 32] = locked[key & 0xFFFFFFFFu] = true;
+    for (std::uint32_t v = 0; v < mesh.vertex_count; ++v)
+        locked[v] = locked[canonical[v]] || copies[canonical[v]] > 1;
+
+    double reached_cost = 0;
+
+    std::vector<std::uint32_t> offsets, adjacency, remap(mesh.vertex_count);
+    std::vector<collapse> candidates;
+    std::vector<bool> touched;
+
+    while (result.size() > target_index_count)
+    {
+        // triangles of every vertex, as CSR
+        offsets.assign(mesh.vertex_count + 1, 0);
+        for (auto v : result)
+            ++offsets[v + 1];
+        for (std::size_t v = 0; v < mesh.vertex_count; ++v)
+            offsets[v + 1] += offsets[v];
+        adjacency.resize(result.size());
+        {
+            std::vector<std::uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (std::size_t i = 0; i < result.size(); ++i)
+                adjacency[fill[result[i]]++] = i / 3;
+        }
+
+        candidates.clear();
+        for (std::size_t i = 0; i < result.size(); i += 3)
+            for (int k = 0; k < 3; ++k)
+            {
+                std::uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+                for (auto [from, to] : {std::pair{a, b}, std::pair{b, a}})
+                {
+                    if (locked[from])
+                        continue;
+                    quadric q = quadrics[canonical[from]];
+                    q += quadrics[canonical[to]];
+                    candidates.push_back({from, to, evaluate(q, position(mesh, to))});
+                }
+            }
+        std::sort(candidates.begin(), candidates.end(), [](auto const & x, auto const & y) { return x.cost < y.cost; });
+
+        // an interior collapse removes two triangles; don't overshoot the target within one pass
+        std::size_t const wanted = (result.size() - target_index_count) / 6 + 1;
+        std::size_t done = 0;
+
+        for (std::uint32_t v = 0; v < mesh.vertex_count; ++v)
+            remap[v] = v;
+        touched.assign(mesh.vertex_count, false);
+
+        for (auto const & candidate : candidates)
+        {
+            if (done == wanted || candidate.cost > max_cost)
+                break;
+            if (touched[candidate.from] || touched[candidate.to])
+                continue;
+
+            // reject collapses that fold a remaining triangle over
+            glm::vec3 const target = position(mesh, candidate.to);
+            bool flips = false;
+            for (std::uint32_t j = offsets[candidate.from]; j < offsets[candidate.from + 1] && !flips; ++j)
+            {
+                std::uint32_t const * t = &result[3 * adjacency[j]];
+                if (t[0] == candidate.to || t[1] == candidate.to || t[2] == candidate.to)
+                    continue;
+
+                glm::vec3 p[3], moved[3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    p[k] = position(mesh, t[k]);
+                    moved[k] = t[k] == candidate.from ? target : p[k];
+                }
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                flips = glm::dot(before, after) <= 0.2f * glm::length(before) * glm::length(after);
+            }
+            if (flips)
+                continue;
+
+            remap[candidate.from] = candidate.to;
+            quadrics[canonical[candidate.to]] += quadrics[canonical[candidate.from]];
+            reached_cost = std::max(reached_cost, candidate.cost);
+            ++done;
+
+            // everything around the collapse has changed, leave it to the next pass
+            for (std::uint32_t j = offsets[candidate.from]; j < offsets[candidate.from + 1]; ++j)
+                for (int k = 0; k < 3; ++k)
+                    touched[result[3 * adjacency[j] + k]] = true;
+        }
+
+        if (done == 0)
+            break;
+
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < result.size(); i += 3)
+        {
+            std::uint32_t t[3] = {remap[result[i]], remap[result[i + 1]], remap[result[i + 2]]};
+            if (canonical[t[0]] == canonical[t[1]] || canonical[t[1]] == canonical[t[2]] || canonical[t[0]] == canonical[t[2]])
+                continue;
+            std::copy(t, t + 3, result.begin() + kept);
+            kept += 3;
+        }
+        result.resize(kept);
+    }
+
+    if (result_error)
+        *result_error = extent > 0.f ? float(std::sqrt(reached_cost) / extent) : 0.f;
+    return result;
+}
+
+lod_chain build_lod_chain(std::span<simplify_mesh const> meshes, lod_options const & options, unsigned int threads)
+{
+    // the levels of one mesh, built in order
+    struct task
+    {
+        std::vector<std::vector<std::uint32_t>> indices;
+        std::vector<float> errors;
+    };
+
+    std::vector<task> tasks(meshes.size());
+
+    auto run = [&](std::size_t m)
+    {
+        auto const & mesh = meshes[m];
+        auto & task = tasks[m];
+        if (options.levels == 0)
+            return;
+
+        task.indices.emplace_back(mesh.indices.begin(), mesh.indices.end());
+        task.errors.push_back(0.f);
+        for (unsigned int level = 1; level < options.levels; ++level)
+        {
+            std::size_t target = std::size_t(mesh.indices.size() / 3 * std::pow(options.ratio, float(level))) * 3;
+            simplify_mesh source = mesh;
+            source.indices = task.indices.back();
+
+            float error = 0.f;
+            auto indices = simplify(source, target, options.max_error - task.errors.back(), &error);
+            if (indices.size() == source.indices.size())
+                break;
+
+            bool const reached = indices.size() <= target;
+            task.indices.push_back(std::move(indices));
+            task.errors.push_back(task.errors.back() + error);
+            if (!reached)
+                break;
+        }
+    };
+
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max<std::size_t>(1, std::min<std::size_t>(threads, meshes.size()));
+
+    // the biggest meshes take longest, start them first
+    std::vector<std::size_t> order(meshes.size());
+    for (std::size_t m = 0; m < order.size(); ++m)
+        order[m] = m;
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return meshes[a].indices.size() > meshes[b].indices.size(); });
+
+    std::atomic<std::size_t> next{0};
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; ++t)
+        workers.emplace_back([&, t]
+        {
+            try
+            {
+                for (std::size_t i; (i = next++) < order.size();)
+                    run(order[i]);
+            }
+            catch (...)
+            {
+                errors[t] = std::current_exception();
+                next = order.size();
+            }
+        });
+    for (auto & worker : workers)
+        worker.join();
+    for (auto const & error : errors)
+        if (error)
+            std::rethrow_exception(error);
+
+    lod_chain result;
+    result.meshes.resize(meshes.size());
+    for (std::size_t m = 0; m < meshes.size(); ++m)
+        for (std::size_t level = 0; level < tasks[m].indices.size(); ++level)
+        {
+            auto const & indices = tasks[m].indices[level];
+            result.meshes[m].push_back({std::uint32_t(result.indices.size()), std::uint32_t(indices.size()), tasks[m].errors[level]});
+            result.indices.insert(result.indices.end(), indices.begin(), indices.end());
+        }
+    return result;
+}
@@ -0,0 +1,105 @@
+// MSDF font metadata loading benchmark.
+//
+// Usage: font_benchmark [iterations] [font.json ...]
+// Loads every font (font/font-msdf.json by default) `iterations` times (1000 by default) with the SAX
+// load_msdf_font and with the previous DOM-over-istream loader kept below as the reference, checks that
+// both give the same glyphs and prints the average times.
+
+#include <rapidjson/document.h>
+#include <rapidjson/istreamwrapper.h>
+
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "msdf_loader.hpp"
+
+msdf_font load_msdf_font_dom(std::string const & path)
+{
+    rapidjson::Document document;
+
+    {
+        std::ifstream input(path, std::ios::binary);
+        rapidjson::IStreamWrapper stream(input);
+        document.ParseStream(stream);
+    }
+
+    msdf_font result;
+    result.texture_path = (std::filesystem::path(path).parent_path() / document["pages"][0].GetString()).string();
+    result.sdf_scale = document["distanceField"]["distanceRange"].GetFloat();
+
+    for (auto const & charInfo : document["chars"].GetArray())
+    {
+        auto & data = result.glyphs[charInfo["id"].GetUint()];
+        data.x = charInfo["x"].GetInt();
+        data.y = charInfo["y"].GetInt();
+        data.width = charInfo["width"].GetInt();
+        data.height = charInfo["height"].GetInt();
+        data.xoffset = charInfo["xoffset"].GetInt();
+        data.yoffset = charInfo["yoffset"].GetInt();
+        data.advance = charInfo["xadvance"].GetInt();
+    }
+
+    return result;
+}
+
+bool same_glyphs(msdf_font const & a, msdf_font const & b)
+{
+    if (a.texture_path != b.texture_path || a.sdf_scale != b.sdf_scale || a.glyphs.size() != b.glyphs.size())
+        return false;
+
+    for (auto const & [id, glyph] : a.glyphs)
+    {
+        auto it = b.glyphs.find(id);
+        if (it == b.glyphs.end())
+            return false;
+        auto const & other = it->second;
+        if (glyph.x != other.x || glyph.y != other.y || glyph.width != other.width || glyph.height != other.height
+            || glyph.xoffset != other.xoffset || glyph.yoffset != other.yoffset || glyph.advance != other.advance)
+            return false;
+    }
+    return true;
+}
+
+template <typename Loader>
+double average_ms(std::string const & path, int iterations, Loader loader)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        loader(path);
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+}
+
+int main(int argc, char * argv[]) try
+{
+    int iterations = 1000;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::isdigit(static_cast<unsigned char>(argv[i][0])))
+            iterations = std::stoi(argv[i]);
+        else
+            paths.emplace_back(argv[i]);
+    }
+    if (paths.empty())
+        paths.push_back(PROJECT_ROOT "/font/font-msdf.json");
+
+    for (auto const & path : paths)
+    {
+        if (!same_glyphs(load_msdf_font(path), load_msdf_font_dom(path)))
+            throw std::runtime_error("SAX and DOM loaders disagree on " + path);
+
+        double dom_ms = average_ms(path, iterations, load_msdf_font_dom);
+        double sax_ms = average_ms(path, iterations, load_msdf_font);
+        std::cout << path << ", " << std::filesystem::file_size(path) / 1024 << " KiB: DOM " << dom_ms << " ms, SAX in situ "
+            << sax_ms << " ms, x" << dom_ms / sax_ms << std::endl;
+    }
+}
+catch (std::exception const & e)
+{
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
@@ -1,50 +1,135 @@
 #include "msdf_loader.hpp"
 
-#include <rapidjson/document.h>
-#include <rapidjson/istreamwrapper.h>
+#include <rapidjson/reader.h>
+#include <rapidjson/error/en.h>
 
 #include <fstream>
 #include <stdexcept>
 #include <filesystem>
+#include <string_view>
+#include <vector>
 
-msdf_font load_msdf_font(std::string const & path)
+namespace
 {
-    rapidjson::Document document;
 
+    // Fills msdf_font right from the reader events, without building a DOM. Parsing is in situ, so the
+    // string views point into the file buffer and stay valid until the end.
+    struct font_handler : rapidjson::BaseReaderHandler<rapidjson::UTF8<>, font_handler>
     {
-        std::ifstream input(path, std::ios::binary);
-        rapidjson::IStreamWrapper stream(input);
-        document.ParseStream(stream);
-    }
+        msdf_font & font;
+        std::filesystem::path directory;
 
-    msdf_font result;
+        int depth = 0;              // of objects and arrays, 1 is the root object
+        std::string_view section;   // key at depth 1
+        std::string_view key;       // latest key deeper down
 
-    {
-        auto pages = document["pages"].GetArray();
-        assert(pages.Size() == 1);
-        result.texture_path = (std::filesystem::path(path).parent_path() / pages[0].GetString()).string();
-    }
+        char32_t id = 0;
+        msdf_font::glyph glyph{};
+        unsigned int pages = 0;
 
-    {
-        auto const & sdf = document["distanceField"];
-        result.sdf_scale = sdf["distanceRange"].GetFloat();
-    }
+        font_handler(msdf_font & font, std::filesystem::path directory)
+            : font(font)
+            , directory(std::move(directory))
+        {}
+
+        bool in_glyph() const { return depth == 3 && section == "chars"; }
+
+        bool Number(double value)
+        {
+            if (in_glyph())
+            {
+                int const i = static_cast<int>(value);
+                if (key == "id") id = static_cast<char32_t>(value);
+                else if (key == "x") glyph.x = i;
+                else if (key == "y") glyph.y = i;
+                else if (key == "width") glyph.width = i;
+                else if (key == "height") glyph.height = i;
+                else if (key == "xoffset") glyph.xoffset = i;
+                else if (key == "yoffset") glyph.yoffset = i;
+                else if (key == "xadvance") glyph.advance = i;
+            }
+            else if (depth == 2 && section == "distanceField" && key == "distanceRange")
+                font.sdf_scale = static_cast<float>(value);
+            return true;
+        }
+
+        bool Int(int value) { return Number(value); }
+        bool Uint(unsigned value) { return Number(value); }
+        bool Int64(std::int64_t value) { return Number(static_cast<double>(value)); }
+        bool Uint64(std::uint64_t value) { return Number(static_cast<double>(value)); }
+        bool Double(double value) { return Number(value); }
+
+        bool String(char const * str, rapidjson::SizeType length, bool)
+        {
+            if (depth == 2 && section == "pages" && pages++ == 0)
+                font.texture_path = (directory / std::string_view(str, length)).string();
+            return true;
+        }
+
+        bool Key(char const * str, rapidjson::SizeType length, bool)
+        {
+            (depth == 1 ? section : key) = std::string_view(str, length);
+            return true;
+        }
 
-    auto chars = document["chars"].GetArray();
+        bool StartObject()
+        {
+            ++depth;
+            if (in_glyph())
+            {
+                id = 0;
+                glyph = {};
+            }
+            return true;
+        }
 
-    for (auto const & charInfo : chars)
+        bool EndObject(rapidjson::SizeType)
+        {
+            if (in_glyph())
+                font.glyphs[id] = glyph;
+            --depth;
+            return true;
+        }
+
+        bool StartArray()
+        {
+            ++depth;
+            return true;
+        }
+
+        bool EndArray(rapidjson::SizeType)
+        {
+            --depth;
+            return true;
+        }
+    };
+
+}
+
+msdf_font load_msdf_font(std::string const & path)
+{
+    // the whole file in one buffer, null-terminated for the in situ stream
+    std::vector<char> json;
     {
-        char32_t id = charInfo["id"].GetUint();
-
-        auto & data = result.glyphs[id];
-        data.x = charInfo["x"].GetInt();
-        data.y = charInfo["y"].GetInt();
-        data.width = charInfo["width"].GetInt();
-        data.height = charInfo["height"].GetInt();
-        data.xoffset = charInfo["xoffset"].GetInt();
-        data.yoffset = charInfo["yoffset"].GetInt();
-        data.advance = charInfo["xadvance"].GetInt();
+        std::ifstream input(path, std::ios::binary);
+        if (!input)
+            throw std::runtime_error("Cannot open font " + path);
+        json.resize(std::filesystem::file_size(path) + 1);
+        input.read(json.data(), json.size() - 1);
+        json.back() = '\0';
     }
 
+    msdf_font result;
+    font_handler handler(result, std::filesystem::path(path).parent_path());
+
+    rapidjson::Reader reader;
+    rapidjson::InsituStringStream stream(json.data());
+    auto const parse_result = reader.Parse<rapidjson::kParseInsituFlag>(stream, handler);
+    if (parse_result.IsError())
+        throw std::runtime_error("Failed to parse font " + path + ": " + rapidjson::GetParseError_En(parse_result.Code())
+            + " at offset " + std::to_string(parse_result.Offset()));
+
+    assert(handler.pages == 1);
+
     return result;
 }
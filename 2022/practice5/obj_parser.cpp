@@ -1,10 +1,10 @@
 #include "obj_parser.hpp"
+#include "vertex_index_map.hpp"
 
 #include <string>
 #include <sstream>
 #include <fstream>
 #include <stdexcept>
-#include <map>
 
 namespace
 {
@@ -27,7 +27,7 @@ obj_data parse_obj(std::filesystem::path const & path)
     std::vector<std::array<float, 3>> normals;
     std::vector<std::array<float, 2>> texcoords;
 
-    std::map<std::array<std::uint32_t, 3>, std::uint32_t> index_map;
+    vertex_index_map index_map;
 
     obj_data result;
 
@@ -123,10 +123,9 @@ obj_data parse_obj(std::filesystem::path const & path)
                 if (index[2] != -1 && index[2] >= normals.size())
                     fail("bad normal index (", index[2], ")");
 
-                auto it = index_map.find(index);
-                if (it == index_map.end())
+                auto [vertex_index, inserted] = index_map.try_emplace(index, result.vertices.size());
+                if (inserted)
                 {
-                    it = index_map.insert({index, result.vertices.size()}).first;
 
                     auto & v = result.vertices.emplace_back();
 
@@ -143,7 +142,7 @@ obj_data parse_obj(std::filesystem::path const & path)
                         v.normal = {0.f, 0.f, 0.f};
                 }
 
-                vertices.push_back(it->second);
+                vertices.push_back(vertex_index);
             }
 
             for (std::size_t i = 1; i + 1 < vertices.size(); ++i)
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Flat open-addressing (linear probing) map from an OBJ (position, texcoord, normal) index triple
+// to the deduplicated vertex index. Replaces std::map<std::array<std::uint32_t, 3>, std::uint32_t>:
+// one contiguous slot array, no per-entry allocation, O(1) expected lookups.
+class vertex_index_map {
+public:
+    using key_type = std::array<std::uint32_t, 3>;
+
+    explicit vertex_index_map(std::size_t expected_size = 0) {
+        reserve(expected_size);
+    }
+
+    // makes room for `count` entries without rehashing
+    void reserve(std::size_t count) {
+        std::size_t capacity = 16;
+        while (capacity * max_load_num < count * max_load_den)
+            capacity *= 2;
+        if (capacity > slots_.size())
+            rehash(capacity);
+    }
+
+    // returns the value stored for `key` and whether it was inserted just now
+    std::pair<std::uint32_t, bool> try_emplace(key_type const &key, std::uint32_t value) {
+        if ((size_ + 1) * max_load_den > slots_.size() * max_load_num)
+            rehash(slots_.size() * 2);
+
+        for (std::size_t i = hash(key) & mask_;; i = (i + 1) & mask_) {
+            auto &slot = slots_[i];
+            if (slot.value == empty) {
+                slot.key = key;
+                slot.value = value;
+                ++size_;
+                return {value, true};
+            }
+            if (slot.key == key)
+                return {slot.value, false};
+        }
+    }
+
+    std::size_t size() const { return size_; }
+
+    std::size_t capacity() const { return slots_.size(); }
+
+    static std::uint64_t hash(key_type const &key) {
+        // components are small, dense and highly correlated (often p == t == n), so each one
+        // is spread by a different odd multiplier before a final avalanche
+        std::uint64_t h = key[0] * 0x9E3779B97F4A7C15ull
+                          ^ key[1] * 0xC2B2AE3D27D4EB4Full
+                          ^ key[2] * 0x165667B19E3779F9ull;
+        h ^= h >> 32;
+        h *= 0xD6E8FEB86659FD93ull;
+        h ^= h >> 32;
+        return h;
+    }
+
+private:
+    // 16 bytes, four slots per cache line
+    struct slot {
+        key_type key;
+        std::uint32_t value;
+    };
+
+    static constexpr std::uint32_t empty = ~0u;
+
+    // maximum load factor 1/2
+    static constexpr std::size_t max_load_num = 1;
+    static constexpr std::size_t max_load_den = 2;
+
+    void rehash(std::size_t capacity) {
+        std::vector<slot> old(capacity, slot{{0, 0, 0}, empty});
+        old.swap(slots_);
+        mask_ = capacity - 1;
+
+        for (auto const &s: old) {
+            if (s.value == empty) continue;
+            std::size_t i = hash(s.key) & mask_;
+            while (slots_[i].value != empty)
+                i = (i + 1) & mask_;
+            slots_[i] = s;
+        }
+    }
+
+    std::vector<slot> slots_;
+    std::size_t mask_ = 0;
+    std::size_t size_ = 0;
+};